@@ -129,6 +129,33 @@ void Communicator::handlePutCAPIRequest(RootObjectPutCAPICall* capiPutMsg)
 	peer_logic->handlePutCAPIRequest(capiPutMsg);
 }
 
+void Communicator::handleModCAPIRequest(RootObjectModCAPICall* capiModMsg)
+{
+	cModule *peer_logicModule = getParentModule()->getSubmodule("peer_logic");
+	//This extra step ensures that the submodules exist and also does any other required error checking
+	Peer_logic *peer_logic = check_and_cast<Peer_logic *>(peer_logicModule);
+
+	peer_logic->handleModCAPIRequest(capiModMsg);
+}
+
+void Communicator::handleBatchGetCAPIRequest(RootObjectBatchGetCAPICall* capiBatchGetMsg)
+{
+	cModule *peer_logicModule = getParentModule()->getSubmodule("peer_logic");
+	//This extra step ensures that the submodules exist and also does any other required error checking
+	Peer_logic *peer_logic = check_and_cast<Peer_logic *>(peer_logicModule);
+
+	peer_logic->handleBatchGetCAPIRequest(capiBatchGetMsg);
+}
+
+void Communicator::handleBatchPutCAPIRequest(RootObjectBatchPutCAPICall* capiBatchPutMsg)
+{
+	cModule *peer_logicModule = getParentModule()->getSubmodule("peer_logic");
+	//This extra step ensures that the submodules exist and also does any other required error checking
+	Peer_logic *peer_logic = check_and_cast<Peer_logic *>(peer_logicModule);
+
+	peer_logic->handleBatchPutCAPIRequest(capiBatchPutMsg);
+}
+
 bool Communicator::handleRpcCall(BaseCallMessage *msg)
 {
 	if (underlayConfigurator->isInInitPhase())
@@ -147,6 +174,9 @@ bool Communicator::handleRpcCall(BaseCallMessage *msg)
 		// internal RPCs
 		RPC_DELEGATE(RootObjectPutCAPI, handlePutCAPIRequest);		//If we received a put request from Tier 2
 		RPC_DELEGATE(RootObjectGetCAPI, handleGetCAPIRequest);		//If we received a get request from Tier 2
+		RPC_DELEGATE(RootObjectModCAPI, handleModCAPIRequest);		//If we received an update request from Tier 2
+		RPC_DELEGATE(RootObjectBatchPutCAPI, handleBatchPutCAPIRequest);	//If we received a batch put request from Tier 2
+		RPC_DELEGATE(RootObjectBatchGetCAPI, handleBatchGetCAPIRequest);	//If we received a batch get request from Tier 2
     // end the switch
     RPC_SWITCH_END();
 
@@ -184,19 +214,27 @@ void Communicator::handleUDPMessage(cMessage* msg)
 	RECORD_STATS(bytesReceived += packet->getByteLength());
 
 	if ((packet->getPayloadType() == WRITE) ||
+			(packet->getPayloadType() == WRITE_REF) ||
+			(packet->getPayloadType() == UPDATE) ||
 			(packet->getPayloadType() == RESPONSE) ||
+			(packet->getPayloadType() == HASH_REQ) ||
+			(packet->getPayloadType() == HASH) ||
 			(packet->getPayloadType() == JOIN_ACCEPT) ||
 			(packet->getPayloadType() == INFORM) ||
 			(packet->getPayloadType() == RETRIEVE_REQ) ||
-			(packet->getPayloadType() == PEER_LEFT) ||
-			(packet->getPayloadType() == PEER_JOIN) ||
+			(packet->getPayloadType() == MEMBERSHIP_DELTA) ||
+			(packet->getPayloadType() == GOSSIP) ||
 			(packet->getPayloadType() == REPLICATION_REQ) ||
 			(packet->getPayloadType() == REPLICATE) ||
-			(packet->getPayloadType() == OBJECT_ADD))
+			(packet->getPayloadType() == OBJECT_ADD) ||
+			(packet->getPayloadType() == OBJECT_ADD_BATCH) ||
+			(packet->getPayloadType() == BATCH))
 	{
 		send(msg, "gs_gate$o");
 	} else if ((packet->getPayloadType() == JOIN_REQ) ||
 			(packet->getPayloadType() == SP_OBJECT_ADD) ||
+			(packet->getPayloadType() == SP_OBJECT_ADD_BATCH) ||
+			(packet->getPayloadType() == SP_MEMBERSHIP_SYNC) ||
 			(packet->getPayloadType() == SP_PEER_LEFT) ||
 			(packet->getPayloadType() == SP_PEER_MIGRATED) ||
 			(packet->getPayloadType() == OVERLAY_WRITE_REQ))
@@ -103,6 +103,21 @@ class Communicator : public BaseApp
 		 */
 		void handlePutCAPIRequest(RootObjectPutCAPICall* capiPutMsg);
 
+		/**
+		 * @see handlePutCapiRequest()
+		 */
+		void handleModCAPIRequest(RootObjectModCAPICall* capiModMsg);
+
+		/**
+		 * @see handleGetCapiRequest()
+		 */
+		void handleBatchGetCAPIRequest(RootObjectBatchGetCAPICall* capiBatchGetMsg);
+
+		/**
+		 * @see handlePutCapiRequest()
+		 */
+		void handleBatchPutCAPIRequest(RootObjectBatchPutCAPICall* capiBatchPutMsg);
+
 		void handleTraceMessage(cMessage* msg);
 
 		void handleRpcResponse(BaseResponseMessage* msg, const RpcState& state, simtime_t rtt);
@@ -155,6 +170,14 @@ class Communicator : public BaseApp
 			return sendInternalRpcCall(destComp, msg, context, timeout, retries, rpcId, rpcListener);
 		}
 
+		void externallySendToUpperTier(cMessage* msg)
+		{
+			Enter_Method_Silent();	//Required for Omnet++ context switching between modules
+			take(msg);
+
+			send(msg, "to_upperTier");
+		}
+
 		void externallySendRpcResponse(BaseCallMessage* call, BaseResponseMessage* response)
 		{
 			Enter_Method_Silent();	//Required for Omnet++ context switching between modules
@@ -0,0 +1,89 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#include "ContentStore.h"
+
+ContentStore::ContentStore() {
+	bytes = 0;
+}
+
+ContentStore::~ContentStore() {
+	clear();
+}
+
+bool ContentStore::addRef(const OverlayKey &hash, int64_t size)
+{
+	BlobMap::iterator it = blobs.find(hash);
+
+	if (it != blobs.end())
+	{
+		if (it->second.size != size)
+			opp_error("[ContentStore]: Two objects with the same payload hash have different sizes.");
+
+		it->second.refs++;
+		return false;
+	}
+
+	ContentBlob blob;
+	blob.size = size;
+	blob.refs = 1;
+
+	blobs.insert(std::make_pair(hash, blob));
+	bytes += size;
+
+	return true;
+}
+
+bool ContentStore::release(const OverlayKey &hash)
+{
+	BlobMap::iterator it = blobs.find(hash);
+
+	if (it == blobs.end())
+		opp_error("[ContentStore]: Releasing a blob that is not stored.");
+
+	it->second.refs--;
+
+	if (it->second.refs > 0)
+		return false;
+
+	bytes -= it->second.size;
+	blobs.erase(it);
+
+	return true;
+}
+
+bool ContentStore::contains(const OverlayKey &hash)
+{
+	return blobs.find(hash) != blobs.end();
+}
+
+unsigned int ContentStore::getRefs(const OverlayKey &hash)
+{
+	BlobMap::iterator it = blobs.find(hash);
+
+	if (it == blobs.end())
+		return 0;
+
+	return it->second.refs;
+}
+
+void ContentStore::clear()
+{
+	blobs.clear();
+	bytes = 0;
+}
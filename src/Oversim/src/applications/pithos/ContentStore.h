@@ -0,0 +1,82 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#ifndef CONTENTSTORE_H_
+#define CONTENTSTORE_H_
+
+#include <omnetpp.h>
+#include <tr1/unordered_map>
+
+#include <OverlayKey.h>
+
+/**
+ * A content addressed blob store with reference counting.
+ * Every stored object refers to the blob holding its data, which is keyed by the object's payload hash. Objects with
+ * identical data share a single blob, so that its bytes are only held once. A blob is freed when the last object that
+ * refers to it is removed.
+ *
+ * @author John Gilmore
+ */
+class ContentStore
+{
+	private:
+		struct ContentBlob
+		{
+			int64_t size;		//The size of the data held by the blob
+			unsigned int refs;	//The number of stored objects that refer to the blob
+		};
+
+		typedef std::tr1::unordered_map<OverlayKey, ContentBlob, OverlayKey::hashFcn> BlobMap;
+
+		BlobMap blobs;
+		int64_t bytes;	/**< The total size of all blobs */
+
+	public:
+		ContentStore();
+		virtual ~ContentStore();
+
+		/**
+		 * Add a reference to the blob with the given payload hash, creating the blob if it does not exist yet.
+		 *
+		 * @param hash The payload hash of the referring object
+		 * @param size The size of the object's data
+		 * @return true if a new blob was created, false if the data was already stored
+		 */
+		bool addRef(const OverlayKey &hash, int64_t size);
+
+		/**
+		 * Remove a reference to the blob with the given payload hash.
+		 *
+		 * @return true if this was the last reference and the blob was freed
+		 */
+		bool release(const OverlayKey &hash);
+
+		bool contains(const OverlayKey &hash);
+
+		/**
+		 * @return the number of objects referring to the blob, or 0 if it is not stored
+		 */
+		unsigned int getRefs(const OverlayKey &hash);
+
+		int64_t getBytes() { return bytes; }
+		unsigned int size() { return blobs.size(); }
+
+		void clear();
+};
+
+#endif /* CONTENTSTORE_H_ */
@@ -39,6 +39,10 @@ void DHTStorage::initialize()
 
 	ttl = par("testTtl");
 
+	nearCache.setCapacity(par("nearCacheBytes").longValue());
+	nearCacheMaxAge = par("nearCacheMaxAge");
+	isNearCaching = nearCache.getCapacity() > 0;
+
 	globalNodeList = GlobalNodeListAccess().get();
 	underlayConfigurator = UnderlayConfiguratorAccess().get();
 	globalStatistics = GlobalStatisticsAccess().get();
@@ -57,6 +61,10 @@ void DHTStorage::initialize()
 	numGetSent = 0;
 	numGetError = 0;
 	numGetSuccess = 0;
+	numCacheHits = 0;
+	numCacheMisses = 0;
+	numCacheStaleHits = 0;
+	cacheBytesSaved = 0;
 
 	//initRpcs();
 	WATCH(numSent);
@@ -66,6 +74,9 @@ void DHTStorage::initialize()
 	WATCH(numGetSent);
 	WATCH(numGetError);
 	WATCH(numGetSuccess);
+	WATCH(numCacheHits);
+	WATCH(numCacheMisses);
+	WATCH(numCacheStaleHits);
 
 	nodeIsLeavingSoon = false;
 }
@@ -133,6 +144,10 @@ void DHTStorage::handleTraceMessage(cMessage* msg)
 
 void DHTStorage::handleGetResponse(DHTgetCAPIResponse* msg, DHTStatsContext* context)
 {
+	//The object is cached whether or not the request is measured, so that the cache is warm when measurement starts
+	if (isNearCaching && msg->getIsSuccess() && msg->getResultArraySize() > 0)
+		cacheObject(context->key, msg->getResult(0).getValue(), msg->getResult(0).getTtl());
+
 	if (context->measurementPhase == false) {
 		// don't count response, if the request was not sent
 		// in the measurement phase
@@ -211,6 +226,29 @@ void DHTStorage::handleGetResponse(DHTgetCAPIResponse* msg, DHTStatsContext* con
 	}
 }
 
+void DHTStorage::cacheObject(const OverlayKey &key, const BinaryValue &value, int ttl)
+{
+	simtime_t expiry = -1;
+
+	if (ttl > 0)
+		expiry = simTime() + ttl;
+
+	if (nearCacheMaxAge > 0 && (expiry < 0 || simTime() + nearCacheMaxAge < expiry))
+		expiry = simTime() + nearCacheMaxAge;
+
+	//Without a TTL or a maximum age there is no telling when the object becomes stale
+	if (expiry < 0)
+	{
+		nearCache.remove(key);
+		return;
+	}
+
+	//The object is charged its simulated size, not the size of its encoding
+	GameObject object(value);
+
+	nearCache.put(key, value, object.getSize(), simTime(), expiry);
+}
+
 void DHTStorage::sendResponse(int responseType, unsigned int rpcid, bool isSuccess, const BinaryValue& value)
 {
 
@@ -244,6 +282,9 @@ void DHTStorage::handlePutResponse(DHTputCAPIResponse* msg, DHTStatsContext* con
 
     if (msg->getIsSuccess())
     {
+    	if (isNearCaching)
+    		cacheObject(context->key, context->object->getBinaryValue(), context->object->getTTL());
+
     	DHTEntry entry = {context->object->getBinaryValue(), simTime() + context->object->getTTL()};
 
         globalDhtTestMap->insertEntry(context->key, entry);
@@ -303,6 +344,32 @@ void DHTStorage::request_retrieve(Packet *pkt)
 
 	unsigned int parent_rpcid = read_pkt->getValue();	//The RPC ID of the original request received from above the Pithos layer
 
+	if (isNearCaching)
+	{
+		BinaryValue value;
+		simtime_t fetched;
+
+		if (nearCache.get(destkey, simTime(), value, fetched))
+		{
+			GameObject object(value);
+
+			RECORD_STATS(numCacheHits++; numGetSuccess++; cacheBytesSaved += object.getSize());
+			RECORD_STATS(globalStatistics->recordOutVector("DHTStorage: Near cache hit age (s)", SIMTIME_DBL(simTime() - fetched)));
+
+			//The test map knows what the overlay currently stores, which tells whether the cached object has gone stale
+			const DHTEntry* entry = globalDhtTestMap->findEntry(destkey);
+			if (entry == NULL || simTime() > entry->endtime || entry->value != value)
+			{
+				RECORD_STATS(numCacheStaleHits++);
+			}
+
+			sendResponse(OVERLAY_GET, parent_rpcid, true, value);
+			return;
+		}
+
+		RECORD_STATS(numCacheMisses++);
+	}
+
 	DHTgetCAPICall* dhtGetMsg = new DHTgetCAPICall();
     dhtGetMsg->setKey(destkey);
     dhtGetMsg->setByteLength(8+8+8); 	//Source address, dest address, key
@@ -327,6 +394,10 @@ void DHTStorage::send_forstore(Packet *pkt)
 
 	unsigned int parent_rpcid = write_pkt->getValue();	//The RPC ID of the original request received from above the Pithos layer
 
+	//The cached copy is outdated as soon as the object is overwritten. The new object is cached once the PUT succeeds.
+	if (isNearCaching)
+		nearCache.remove(destkey);
+
 	//go->setType(OVERLAY);		//Having an explicit overlay type screws with the hashes requested by the higher layer
 
 	//TODO: Update the lower layer so that it retrieves the required information directly from the GameObject
@@ -384,6 +455,20 @@ void DHTStorage::finish()
         if ((numPutSuccess + numPutError) > 0) {
 			globalStatistics->addStdDev("DHTStorage: PUT Success Ratio", (double) numPutSuccess / (double) (numPutSuccess + numPutError));
 		}
+
+		if (isNearCaching)
+		{
+			globalStatistics->addStdDev("DHTStorage: Near cache hits/s", numCacheHits / time);
+			globalStatistics->addStdDev("DHTStorage: Near cache bytes saved/s", (double) cacheBytesSaved / time);
+
+			if ((numCacheHits + numCacheMisses) > 0) {
+				globalStatistics->addStdDev("DHTStorage: Near cache hit ratio", (double) numCacheHits / (double) (numCacheHits + numCacheMisses));
+			}
+
+			if (numCacheHits > 0) {
+				globalStatistics->addStdDev("DHTStorage: Near cache stale hit ratio", (double) numCacheStaleHits / (double) numCacheHits);
+			}
+		}
     }
 
 }
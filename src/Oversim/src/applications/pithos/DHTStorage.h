@@ -33,6 +33,7 @@
 
 #include "PithosMessages_m.h"
 #include "GameObject.h"
+#include "NearCache.h"
 
 class Peer_logic;
 class Communicator;
@@ -88,6 +89,10 @@ class DHTStorage : public cSimpleModule
 		bool debugOutput; /**< debug output yes/no?*/
 		int ttl; /**< ttl for stored DHT records */
 		bool activeNetwInitPhase; //!< is app active in network init phase?
+		simtime_t nearCacheMaxAge; /**< the longest time a cached object is returned, regardless of its TTL. 0 leaves only the TTL. */
+
+		NearCache nearCache; /**< recently fetched overlay objects, answered locally until they expire */
+		bool isNearCaching; /**< true if the near cache has a capacity */
 
 		// statistics
 		int numSent; /**< number of sent packets*/
@@ -97,6 +102,10 @@ class DHTStorage : public cSimpleModule
 		int numGetSuccess; /**< number of success in put responses*/
 		int numPutError; /**< number of error in put responses*/
 		int numPutSuccess; /**< number of success in put responses*/
+		int numCacheHits; /**< number of GET requests answered from the near cache*/
+		int numCacheMisses; /**< number of GET requests that had to be sent into the overlay*/
+		int numCacheStaleHits; /**< number of near cache hits that no longer matched the object stored in the overlay*/
+		int64_t cacheBytesSaved; /**< total size of the objects answered from the near cache*/
 
 		bool nodeIsLeavingSoon; //!< true if the node is going to be killed shortly
 
@@ -104,6 +113,15 @@ class DHTStorage : public cSimpleModule
 
 		void send_forstore(Packet *pkt);
 
+		/**
+		 * Store a fetched or written object in the near cache, until the earlier of its TTL and the maximum cache age.
+		 *
+		 * @param key The key of the object
+		 * @param value The object, as stored in the overlay
+		 * @param ttl The remaining time to live of the object in seconds, or a non-positive value if it is not known
+		 */
+		void cacheObject(const OverlayKey &key, const BinaryValue &value, int ttl);
+
 		void sendResponse(int responseType, unsigned int rpcid, bool isSuccess, const BinaryValue& value = BinaryValue::UNSPECIFIED_VALUE);
 
 	protected:
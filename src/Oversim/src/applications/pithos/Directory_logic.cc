@@ -39,8 +39,20 @@ void Directory_logic::initializeApp(int stage)
 
     superPeerNumSignal = registerSignal("SuperPeerNum");
     noSuperPeersSignal = registerSignal("noSuperPeers");
+    candidatesExaminedSignal = registerSignal("candidatesExamined");
+    assignedGroupSizeSignal = registerSignal("assignedGroupSize");
 
-    sp_adr_list.reserve(20);	//The amount of memory to initially reserve for this vector
+    maxDistance = par("maxDistance");
+    worldSize = par("worldSize");
+    sp_index.setGrid(worldSize, par("gridCellSize"));
+
+    joinCandidates = par("joinCandidates");
+    distanceWeight = par("distanceWeight");
+    storedBytesWeight = par("storedBytesWeight");
+    objectAddRateWeight = par("objectAddRateWeight");
+
+    if (joinCandidates < 1)
+    	error("At least one join candidate is required.");
 
     bindToPort(2000);
 }
@@ -66,39 +78,66 @@ void Directory_logic::deliver(OverlayKey& key, cMessage* msg)
 
 bool Directory_logic::superPeersExist()
 {
-	if (sp_adr_list.size() > 0) return true;
+	if (sp_index.size() > 0) return true;
 	else return false;
 }
 
 TransportAddress Directory_logic::findAddress(const double &lati, const double &longi)
 {
-	unsigned int i;
-	double nearest_dist = 10000;	//TODO: Use a parameter that specifies the maximum distance in a given virtual world
-	int place = -1;
+	std::vector<SP_element*> candidates;
+	SP_element *chosen;
 
-	double list_lat;
-	double list_long;
-	double dist;
+	//Only the grid cells around the joining peer are searched
+	sp_index.findNearest(lati, longi, joinCandidates, maxDistance, candidates);
 
-	for (i = 0 ; i < sp_adr_list.size() ; i++)
+	emit(candidatesExaminedSignal, (long)sp_index.getLastExamined());
+
+	if (candidates.empty())
+		error("No super peers present. Check first next time");
+
+	if (candidates.size() == 1)
 	{
-		list_lat = ((SP_element)sp_adr_list.at(i)).getLatitude();
-		list_long = ((SP_element)sp_adr_list.at(i)).getLongitude();
+		chosen = candidates[0];
+	} else {
+		//Power of two choices: compare two distinct random candidates and choose the cheaper one
+		int first = intuniform(0, candidates.size()-1);
+		int second = intuniform(0, candidates.size()-2);
+		if (second >= first)
+			second++;
+
+		if (joinCost(candidates[second], candidates[first], lati, longi) < joinCost(candidates[first], candidates[second], lati, longi))
+			chosen = candidates[second];
+		else chosen = candidates[first];
+	}
 
-		dist = sqrt( pow(list_lat - lati, 2) + pow(list_long - longi, 2));
+	emit(assignedGroupSizeSignal, (long)chosen->getGroupSize());
 
-		if (dist < nearest_dist)
-		{
-			nearest_dist = dist;
-			place = i;
-		}
+	//Count the peer against the group until the super peer reports its load again, so that a join storm is spread over the candidates
+	chosen->addAssignedPeer();
 
-	}
+	return chosen->getAddress();
+}
 
-	if (place == -1)
-		error("No super peers present. Check first next time");
+/**
+ * The share of a load that falls on one of two super peers. Equal loads, including none at all, are shared evenly.
+ */
+static double loadShare(double load, double other_load)
+{
+	if (load + other_load <= 0)
+		return 0.5;
 
-	return ((SP_element)sp_adr_list.at(place)).getAddress();
+	return load / (load + other_load);
+}
+
+double Directory_logic::joinCost(SP_element *super_peer, SP_element *other, const double &lati, const double &longi)
+{
+	double dist = sqrt( pow(super_peer->getLatitude() - lati, 2) + pow(super_peer->getLongitude() - longi, 2));
+
+	double load = loadShare(super_peer->getGroupSize() + 1, other->getGroupSize() + 1)
+			+ storedBytesWeight * loadShare(super_peer->getStoredBytes(), other->getStoredBytes())
+			+ objectAddRateWeight * loadShare(super_peer->getObjectAddRate(), other->getObjectAddRate());
+
+	return load * (1 + distanceWeight * dist / worldSize);
 }
 
 void Directory_logic::handleJoinReq(bootstrapPkt *boot_req)
@@ -125,33 +164,56 @@ void Directory_logic::handleSuperPeerAdd(bootstrapPkt *boot_req)
 {
 	SP_element super_peer;
 
+	//Assigned peers are only ever added to a super peer's group size, until the super peer reports its actual load
+	if (joinCandidates > 1 && boot_req->getLoadReportInterval() <= 0)
+		error("Super peers have to report their load (loadReportInterval > 0) when the directory chooses among several join candidates.");
+
 	super_peer.setAddress(boot_req->getSourceAddress());
 	super_peer.setPosition(boot_req->getLatitude(), boot_req->getLongitude());
 
-	sp_adr_list.push_back(super_peer);
+	//A super peer that registers again is moved to its new position, and is not counted again
+	if (!sp_index.contains(boot_req->getSourceAddress()))
+		emit(superPeerNumSignal, 1);
 
-	emit(superPeerNumSignal, 1);
+	sp_index.insert(super_peer);
 
 	EV << "Received super peer information from Node: " << boot_req->getSourceAddress() << endl;
 
 	//The original message is deleted in the calling function.
 }
 
+void Directory_logic::handleSuperPeerLoad(SuperPeerLoadPkt *load_p)
+{
+	SP_element *super_peer = sp_index.find(load_p->getSourceAddress());
+
+	//The load report may arrive before the super peer has been added
+	if (super_peer == NULL)
+		return;
+
+	super_peer->setLoad(load_p->getGroupSize(), load_p->getStoredBytes(), load_p->getObjectAddRate());
+
+	//The original message is deleted in the calling function.
+}
+
 // handleUDPMessage() is called when we receive a message from UDP.
 // Unknown packets can be safely deleted here.
 void Directory_logic::handleUDPMessage(cMessage* msg)
 {
-	bootstrapPkt *boot_req = check_and_cast<bootstrapPkt *>(msg);
+	Packet *packet = check_and_cast<Packet *>(msg);
 
-	if (boot_req->getPayloadType() == JOIN_REQ)
+	if (packet->getPayloadType() == JOIN_REQ)
 	{
 		if (superPeersExist())
-			handleJoinReq(boot_req);
+			handleJoinReq(check_and_cast<bootstrapPkt *>(packet));
 		else emit(noSuperPeersSignal, 1);
 	}
-	else if (boot_req->getPayloadType() == SUPER_PEER_ADD)
+	else if (packet->getPayloadType() == SUPER_PEER_ADD)
+	{
+		handleSuperPeerAdd(check_and_cast<bootstrapPkt *>(packet));
+	}
+	else if (packet->getPayloadType() == SUPER_PEER_LOAD)
 	{
-		handleSuperPeerAdd(boot_req);
+		handleSuperPeerLoad(check_and_cast<SuperPeerLoadPkt *>(packet));
 	}
 	else EV << "The directory server received an unknown message type, ignoring\n";
 
@@ -28,6 +28,7 @@
 #include "PithosMessages_m.h"
 
 #include "SP_element.h"
+#include "SuperPeerIndex.h"
 
 /**
  * The Directory logic class, which is used by the Directory Server
@@ -43,12 +44,35 @@ class Directory_logic : public BaseApp
 {
 	private:
 
-		std::vector<SP_element> sp_adr_list; /**< The list that holds the combination of Super Peer IPs and their positions in the world */
+		SuperPeerIndex sp_index; /**< The spatial index that holds the combination of Super Peer IPs and their positions in the world */
+
+		double maxDistance; /**< The maximum distance between a joining peer and its super peer */
+
+		double worldSize; /**< The range of latitudes and longitudes in the virtual world */
+
+		unsigned int joinCandidates; /**< The number of nearest super peers from which a joining peer's super peer is chosen */
+
+		double distanceWeight; /**< How strongly distance counts against a candidate super peer, relative to its group load */
+
+		double storedBytesWeight; /**< How strongly the bytes stored in a group count, relative to its group size */
+
+		double objectAddRateWeight; /**< How strongly the rate of object additions in a group counts, relative to its group size */
 
 		simsignal_t superPeerNumSignal; /**< Signal for collecting statistics on the number of Super Peers in the directory. */
 
 		simsignal_t noSuperPeersSignal; /**< Signal for collecting statistics on how many times a node requested to join the network when there were no Super Peers to reply with. */
 
+		simsignal_t candidatesExaminedSignal; /**< Signal for collecting statistics on the number of Super Peers examined to answer a join request. */
+
+		simsignal_t assignedGroupSizeSignal; /**< Signal for collecting statistics on the group size of the Super Peers that joining peers are sent to. */
+
+		/**
+		 * The load-aware cost of sending a joining peer to a super peer, rather than to the other candidate.
+		 * The group size, stored bytes and object addition rate of the super peer are each taken as its share of the two
+		 * candidates' totals, so that they can be weighed against each other. More loaded and more distant super peers cost more.
+		 */
+		double joinCost(SP_element *super_peer, SP_element *other, const double &lati, const double &longi);
+
 	protected:
 
 		/**
@@ -93,7 +117,9 @@ class Directory_logic : public BaseApp
 		void handleJoinReq(bootstrapPkt *boot_req);
 
 		/**
-		 * Function that calculates the nearest super peer to the joining peer.
+		 * Function that selects the super peer for the joining peer. If joinCandidates is larger than one,
+		 * two of the nearest super peers are chosen at random and the one with the lowest join cost is returned.
+		 * Otherwise, the nearest super peer is returned.
 		 *
 		 * @param lati Latitude of the joining peer.
 		 * @param longi Longitude of the joining peer.
@@ -109,6 +135,13 @@ class Directory_logic : public BaseApp
 		 */
 		void handleSuperPeerAdd(bootstrapPkt *boot_req);
 
+		/**
+		 * Handles a periodic load report from a super peer.
+		 *
+		 * @param load_p The group size, stored bytes and request rate of the super peer's group.
+		 */
+		void handleSuperPeerLoad(SuperPeerLoadPkt *load_p);
+
 		/**
 		 * Checks whether any super seers have been added to the Directory Server
 		 *
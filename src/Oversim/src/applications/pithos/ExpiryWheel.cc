@@ -0,0 +1,226 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#include "ExpiryWheel.h"
+
+ExpiryWheel::ExpiryWheel() {
+	resolution = 1;
+	next_tick = 0;
+	wakeup_valid = false;
+	scan_tick = 0;
+	wakeup_tick = 0;
+}
+
+ExpiryWheel::~ExpiryWheel() {
+	clear();
+}
+
+void ExpiryWheel::setResolution(simtime_t resolution)
+{
+	if (resolution <= 0)
+		opp_error("[ExpiryWheel]: The resolution of the expiry wheel should be positive.");
+
+	if (!deadlines.empty())
+		opp_error("[ExpiryWheel]: The resolution cannot be changed while keys are scheduled.");
+
+	this->resolution = resolution;
+}
+
+void ExpiryWheel::insert(const WheelEntry& entry)
+{
+	uint64_t tick = entry.tick;
+
+	//Entries that are already due are processed with the next tick
+	if (tick < next_tick)
+		tick = next_tick;
+
+	uint64_t delta = tick - next_tick;
+
+	//Find the lowest level that spans the entry's tick. Every level spans SLOTS times more ticks than the level below it.
+	for (unsigned int level = 0 ; level < LEVELS ; level++)
+	{
+		if (delta < ((uint64_t)1 << (SLOT_BITS*(level+1))))
+		{
+			wheel[level][(tick >> (SLOT_BITS*level)) & SLOT_MASK].push_back(entry);
+			return;
+		}
+	}
+
+	//Entries beyond the range of the wheel are parked in the furthest slot. They are cascaded again until they are within range.
+	tick = next_tick + ((uint64_t)1 << (SLOT_BITS*LEVELS)) - 1;
+	wheel[LEVELS-1][(tick >> (SLOT_BITS*(LEVELS-1))) & SLOT_MASK].push_back(entry);
+}
+
+void ExpiryWheel::cascade(unsigned int level, unsigned int index)
+{
+	WheelSlot slot;
+
+	//Take the entries out of the slot before reinserting them, since they may land in the same slot again
+	slot.swap(wheel[level][index]);
+
+	for (unsigned int i = 0 ; i < slot.size() ; i++)
+		insert(slot[i]);
+}
+
+void ExpiryWheel::processTick(std::vector<OverlayKey> &expired)
+{
+	unsigned int index = next_tick & SLOT_MASK;
+
+	//When the lowest level wraps around, move the entries of the next slot of the higher levels down
+	if (index == 0)
+	{
+		for (unsigned int level = 1 ; level < LEVELS ; level++)
+		{
+			unsigned int level_index = (next_tick >> (SLOT_BITS*level)) & SLOT_MASK;
+			cascade(level, level_index);
+
+			if (level_index != 0)
+				break;
+		}
+	}
+
+	WheelSlot &slot = wheel[0][index];
+
+	for (unsigned int i = 0 ; i < slot.size() ; i++)
+	{
+		DeadlineMap::iterator deadline_it = deadlines.find(slot[i].key);
+
+		//Keys that were cancelled or rescheduled to another tick are left out
+		if (deadline_it != deadlines.end() && deadline_it->second == slot[i].tick)
+		{
+			//The owning module is not woken up before the last wakeup, so a key due before it expires late
+			if (wakeup_valid && slot[i].tick >= scan_tick && slot[i].tick < wakeup_tick)
+				opp_error("[ExpiryWheel]: A key expired after the wakeup that should have covered it.");
+
+			expired.push_back(slot[i].key);
+			deadlines.erase(deadline_it);
+		}
+	}
+	slot.clear();
+
+	next_tick++;
+}
+
+void ExpiryWheel::schedule(const OverlayKey &key, simtime_t expiry_time)
+{
+	WheelEntry entry;
+
+	entry.key = key;
+	entry.tick = (uint64_t)ceil(expiry_time / resolution);
+
+	DeadlineMap::iterator deadline_it = deadlines.find(key);
+
+	//The key may be due before the last wakeup, until the owning module asks for the next wakeup again
+	wakeup_valid = false;
+
+	if (deadline_it != deadlines.end())
+	{
+		//The key is already scheduled for this tick
+		if (deadline_it->second == entry.tick)
+			return;
+
+		//The entry of the earlier deadline stays in the wheel, but will be ignored when its tick is processed
+		deadline_it->second = entry.tick;
+	} else {
+		//If nothing is scheduled, the wheel may have fallen behind the current time
+		if (deadlines.empty())
+		{
+			uint64_t now_tick = (uint64_t)floor(simTime() / resolution);
+
+			if (next_tick < now_tick)
+				next_tick = now_tick;
+		}
+
+		deadlines.insert(std::make_pair(key, entry.tick));
+	}
+
+	insert(entry);
+}
+
+void ExpiryWheel::cancel(const OverlayKey &key)
+{
+	deadlines.erase(key);
+}
+
+bool ExpiryWheel::isScheduled(const OverlayKey &key)
+{
+	return deadlines.find(key) != deadlines.end();
+}
+
+void ExpiryWheel::advance(simtime_t now, std::vector<OverlayKey> &expired)
+{
+	uint64_t now_tick = (uint64_t)floor(now / resolution);
+
+	while (next_tick <= now_tick && !deadlines.empty())
+		processTick(expired);
+
+	//Nothing is left to expire, so there is no need to step through the remaining empty ticks
+	if (deadlines.empty() && next_tick <= now_tick)
+		next_tick = now_tick + 1;
+}
+
+simtime_t ExpiryWheel::getNextWakeup()
+{
+	if (deadlines.empty())
+		return -1;
+
+	uint64_t tick = next_tick;
+
+	//The higher levels are only cascaded when the lowest level wraps around, so until then keys due in this range
+	//of the lowest level may still be waiting in a higher level
+	if ((tick & SLOT_MASK) != 0)
+	{
+		//Look for the next non-empty slot before the lowest level wraps around
+		while (((tick & SLOT_MASK) != 0) && wheel[0][tick & SLOT_MASK].empty())
+			tick++;
+	}
+
+	wakeup_valid = true;
+	scan_tick = next_tick;
+	wakeup_tick = tick;
+
+	//Either the next non-empty slot, or the next time the higher levels have to be cascaded
+	return resolution * (double)tick;
+}
+
+simtime_t ExpiryWheel::getTimerWakeup(const cMessage *timer)
+{
+	simtime_t wakeup = getNextWakeup();
+
+	if (wakeup < 0)
+		return -1;
+
+	if (wakeup < simTime())
+		wakeup = simTime();
+
+	//Only reschedule the timer if the wheel has to be advanced earlier than planned
+	if (timer->isScheduled() && timer->getArrivalTime() <= wakeup)
+		return -1;
+
+	return wakeup;
+}
+
+void ExpiryWheel::clear()
+{
+	for (unsigned int level = 0 ; level < LEVELS ; level++)
+		for (unsigned int index = 0 ; index < SLOTS ; index++)
+			wheel[level][index].clear();
+
+	deadlines.clear();
+	wakeup_valid = false;
+}
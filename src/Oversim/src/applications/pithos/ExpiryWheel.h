@@ -0,0 +1,122 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#ifndef EXPIRYWHEEL_H_
+#define EXPIRYWHEEL_H_
+
+#include <omnetpp.h>
+#include <vector>
+#include <tr1/unordered_map>
+
+#include <OverlayKey.h>
+
+/**
+ * A hierarchical timing wheel that keeps track of when object keys expire.
+ *
+ * Instead of scheduling a self-message per object, a module schedules all expiry times in the wheel and uses a single
+ * self-message to wake up at getNextWakeup(). Expiry times are rounded up to the wheel's resolution, so that objects
+ * that expire close to each other are expired in the same batch, and an object is never expired early.
+ *
+ * Every key is scheduled at most once. Scheduling a key again with the same expiry time does nothing, and scheduling
+ * it with a different expiry time replaces the earlier one.
+ *
+ * @author John Gilmore
+ */
+class ExpiryWheel
+{
+	private:
+		static const unsigned int LEVELS = 4;
+		static const unsigned int SLOT_BITS = 6;
+		static const unsigned int SLOTS = 1 << SLOT_BITS;
+		static const uint64_t SLOT_MASK = SLOTS - 1;
+
+		struct WheelEntry
+		{
+			OverlayKey key;
+			uint64_t tick;
+		};
+
+		typedef std::vector<WheelEntry> WheelSlot;
+		typedef std::tr1::unordered_map<OverlayKey, uint64_t, OverlayKey::hashFcn> DeadlineMap;
+
+		WheelSlot wheel[LEVELS][SLOTS];
+
+		DeadlineMap deadlines;	/**< The tick at which every scheduled key expires */
+
+		simtime_t resolution;	/**< The length of a single tick */
+		uint64_t next_tick;		/**< The next tick that has to be processed */
+
+		//The ticks between which getNextWakeup() last found nothing to expire, to check that no key is woken up late
+		bool wakeup_valid;
+		uint64_t scan_tick;		/**< The tick from which the last wakeup was searched */
+		uint64_t wakeup_tick;	/**< The tick of the last wakeup */
+
+		void insert(const WheelEntry& entry);
+		void cascade(unsigned int level, unsigned int index);
+		void processTick(std::vector<OverlayKey> &expired);
+
+	public:
+		ExpiryWheel();
+		virtual ~ExpiryWheel();
+
+		/**
+		 * Sets the length of a single tick. This should be done before any keys are scheduled.
+		 */
+		void setResolution(simtime_t resolution);
+
+		/**
+		 * Schedule a key to expire at the given time.
+		 *
+		 * @param key The key of the object that expires
+		 * @param expiry_time The time at which the object expires
+		 */
+		void schedule(const OverlayKey &key, simtime_t expiry_time);
+
+		/**
+		 * Remove a key from the wheel, so that it will not be reported as expired.
+		 */
+		void cancel(const OverlayKey &key);
+
+		bool isScheduled(const OverlayKey &key);
+
+		/**
+		 * Collect all keys that have expired up to and including the given time.
+		 *
+		 * @param now The current simulation time
+		 * @param expired The expired keys are appended to this list
+		 */
+		void advance(simtime_t now, std::vector<OverlayKey> &expired);
+
+		/**
+		 * @return the time at which the owning module should call advance() again, or -1 if no keys are scheduled.
+		 */
+		simtime_t getNextWakeup();
+
+		/**
+		 * @param timer The self-message the owning module uses to call advance()
+		 * @return the time at which the timer should be (re)scheduled, or -1 if it should be left as it is, because
+		 * no keys are scheduled or the timer already arrives early enough
+		 */
+		simtime_t getTimerWakeup(const cMessage *timer);
+
+		unsigned int size() { return deadlines.size(); }
+
+		void clear();
+};
+
+#endif /* EXPIRYWHEEL_H_ */
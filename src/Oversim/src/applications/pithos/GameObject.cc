@@ -18,6 +18,9 @@
 
 #include "GameObject.h"
 
+unsigned long GameObject::hashComputations = 0;
+unsigned long GameObject::hashCacheHits = 0;
+
 // predefined GameObject
 const GameObject GameObject::UNSPECIFIED_OBJECT;
 
@@ -32,6 +35,12 @@ GameObject::GameObject(const std::string o_name, int64_t o_size, simtime_t o_cre
 	size = o_size;
 	creationTime = o_creationTime;
 	ttl = o_ttl;
+	version = 0;
+	fragmentIndex = -1;
+
+	nameHashValid = false;
+	contentHashValid = false;
+	payloadHashValid = false;
 }
 
 GameObject::GameObject(const GameObject& other) : cOwnedObject(other.getName())
@@ -51,6 +60,17 @@ GameObject& GameObject::operator=(const GameObject& other)
 	creationTime = other.creationTime;
 	group_address = other.group_address;
 	value = other.value;
+	version = other.version;
+	fragmentIndex = other.fragmentIndex;
+	fragmentData = other.fragmentData;
+	objectHash = other.objectHash;
+
+	nameHash = other.nameHash;
+	contentHash = other.contentHash;
+	payloadHash = other.payloadHash;
+	nameHashValid = other.nameHashValid;
+	contentHashValid = other.contentHashValid;
+	payloadHashValid = other.payloadHashValid;
 
 	return *this;
 }
@@ -66,6 +86,9 @@ bool operator==(const GameObject& object1, const GameObject& object2)
 	if (object1.value != object2.value)
 		return false;
 
+	if (object1.version != object2.version)
+		return false;
+
 	if (object1.objectName != object2.objectName)
 		return false;
 
@@ -95,6 +118,9 @@ GameObject::GameObject(const BinaryValue& binval) : cOwnedObject("GameObject")
 
 GameObject& GameObject::operator=(const BinaryValue& binval)
 {
+	invalidateHashes(true);
+	clearFragment();	//Fragments are not stored in the DHT
+
 	//If an unspecified BinaryValue was received, return an unspecified GameObject
 	if (binval == BinaryValue::UNSPECIFIED_VALUE)
 	{
@@ -103,6 +129,7 @@ GameObject& GameObject::operator=(const BinaryValue& binval)
 		creationTime = SIMTIME_ZERO;
 		ttl = 0;
 		value = 0;
+		version = 0;
 
 		return *this;
 	}
@@ -116,6 +143,7 @@ GameObject& GameObject::operator=(const BinaryValue& binval)
 		creationTime = SIMTIME_ZERO;
 		ttl = 0;
 		value = intuniform(0, 100000);
+		version = 0;
 
 		return *this;
 	}
@@ -136,6 +164,7 @@ GameObject& GameObject::operator=(const BinaryValue& binval)
 	creationTime = atof((tokens[2]).c_str());
 	ttl = atoi((tokens[3]).c_str());
 	value = atoi((tokens[4]).c_str());
+	version = (tokens.size() > 5) ? strtoul((tokens[5]).c_str(), NULL, 10) : 0;
 
 	return *this;
 }
@@ -155,14 +184,14 @@ std::string GameObject::info()
 	 */
 
 	std::stringstream out;
-	out << objectName << " " << size << " " << creationTime << " " << ttl << " " <<value;
+	out << objectName << " " << size << " " << creationTime << " " << ttl << " " <<value << " " << version;
 	return out.str();
 }
 
 std::string GameObject::info() const
 {
 	std::stringstream out;
-	out << objectName << " " << size << " " << creationTime << " " << ttl << " " <<value;
+	out << objectName << " " << size << " " << creationTime << " " << ttl << " " <<value << " " << version;
 	return out.str();
 }
 
@@ -172,7 +201,8 @@ std::ostream& operator<<(std::ostream& stream, const GameObject go)
     return stream << /*This will state the node number and object number: */ go.objectName
 					<< " Size: " << go.size
                   << " CreationTime: " << go.creationTime
-                  << " TTL: " << go.ttl;
+                  << " TTL: " << go.ttl
+                  << " Version: " << go.version;
 }
 
 BinaryValue GameObject::getBinaryValue()
@@ -187,24 +217,74 @@ BinaryValue GameObject::getBinaryValue() const
 	return binval;
 }
 
+void GameObject::invalidateHashes(bool nameChanged)
+{
+	contentHashValid = false;
+	payloadHashValid = false;
+
+	if (nameChanged)
+		nameHashValid = false;
+}
+
 OverlayKey GameObject::getContentHash()
 {
-	return OverlayKey::sha1(getBinaryValue());
+	return ((const GameObject *)this)->getContentHash();
 }
 
 OverlayKey GameObject::getContentHash() const
 {
-	return OverlayKey::sha1(getBinaryValue());
+	if (contentHashValid)
+	{
+		hashCacheHits++;
+		return contentHash;
+	}
+
+	contentHash = OverlayKey::sha1(getBinaryValue());
+	contentHashValid = true;
+	hashComputations++;
+
+	return contentHash;
+}
+
+OverlayKey GameObject::getPayloadHash() const
+{
+	if (payloadHashValid)
+	{
+		hashCacheHits++;
+		return payloadHash;
+	}
+
+	std::ostringstream payload;
+	payload << size << " " << value;
+
+	if (fragmentIndex >= 0)
+		payload << " " << fragmentIndex << " " << std::string(fragmentData.begin(), fragmentData.end());
+
+	payloadHash = OverlayKey::sha1(BinaryValue(payload.str()));
+	payloadHashValid = true;
+	hashComputations++;
+
+	return payloadHash;
 }
 
 OverlayKey GameObject::getNameHash()
 {
-	return OverlayKey::sha1(BinaryValue(objectName));
+	return ((const GameObject *)this)->getNameHash();
 }
 
 OverlayKey GameObject::getNameHash() const
 {
-	return OverlayKey::sha1(BinaryValue(objectName));
+	if (nameHashValid)
+	{
+		hashCacheHits++;
+		return nameHash;
+	}
+
+	nameHash = OverlayKey::sha1(BinaryValue(objectName));
+	nameHashValid = true;
+	hashComputations++;
+
+	return nameHash;
 }
 
 GameObject *GameObject::dup() const
@@ -226,6 +306,7 @@ int64_t GameObject::getSize() const
 void GameObject::setSize(const int64_t &o_size)
 {
 	size = o_size;
+	invalidateHashes(false);
 }
 
 int GameObject::getTTL()
@@ -251,17 +332,31 @@ int GameObject::getValue() const
 void GameObject::setValue(const int &val)
 {
 	value = val;
+	invalidateHashes(false);
 }
 
 
+unsigned int GameObject::getVersion() const
+{
+	return version;
+}
+
+void GameObject::setVersion(const unsigned int &ver)
+{
+	version = ver;
+	invalidateHashes(false);
+}
+
 void GameObject::setTTL(const int &o_ttl)
 {
 	ttl = o_ttl;
+	invalidateHashes(false);
 }
 
 void GameObject::setObjectName(const std::string& o_Name)
 {
 	objectName = o_Name;
+	invalidateHashes(true);
 }
 
 std::string GameObject::getObjectName()
@@ -277,6 +372,7 @@ std::string GameObject::getObjectName() const
 void GameObject::setCreationTime(const simtime_t &time)
 {
 	creationTime = time;
+	invalidateHashes(false);
 }
 
 simtime_t GameObject::getCreationTime()
@@ -308,3 +404,19 @@ bool GameObject::isUnspecified()
 {
 	return (*this == GameObject::UNSPECIFIED_OBJECT);
 }
+
+void GameObject::setFragment(int index, const std::vector<uint8_t> &data, const OverlayKey &object_hash)
+{
+	fragmentIndex = index;
+	fragmentData = data;
+	objectHash = object_hash;
+	payloadHashValid = false;
+}
+
+void GameObject::clearFragment()
+{
+	fragmentIndex = -1;
+	fragmentData.clear();
+	objectHash = OverlayKey::UNSPECIFIED_KEY;
+	payloadHashValid = false;
+}
@@ -20,6 +20,7 @@
 #define GO_H_
 
 #include <omnetpp.h>
+#include <vector>
 #include <SHA1.h>
 #include <TransportAddress.h>
 
@@ -48,11 +49,37 @@ class GameObject : public cOwnedObject
 
 		int value;	//This variable represents the data contained in the game object
 
+		unsigned int version;	/**< The number of times the object has been updated. Concurrent updates are resolved in favour of the higher version. */
+
+		//An erasure coded fragment of the object. The attributes above are those of the whole object, except for the size.
+		int fragmentIndex;						/**< The index of the fragment, or -1 if this is the whole object */
+		std::vector<uint8_t> fragmentData;		/**< The coded bytes of the fragment */
+		OverlayKey objectHash;					/**< The content hash of the whole object, against which the decoded object is checked */
+
+		//The hashes are computed when first requested and cached until one of the attributes they depend on changes.
+		mutable OverlayKey nameHash;
+		mutable OverlayKey contentHash;
+		mutable OverlayKey payloadHash;
+		mutable bool nameHashValid;
+		mutable bool contentHashValid;
+		mutable bool payloadHashValid;
+
+		/**
+		 * Invalidate the cached hashes. The content hash depends on all attributes returned by info(),
+		 * while the name hash only depends on the object name. The payload hash is invalidated with the content hash.
+		 *
+		 * @param nameChanged true if the object name was changed
+		 */
+		void invalidateHashes(bool nameChanged);
+
 		friend std::ostream& operator<<(std::ostream& Stream, const GameObject entry);
 
 	public:
 		static const GameObject UNSPECIFIED_OBJECT;
 
+		static unsigned long hashComputations;	/**< The number of SHA-1 hashes computed for all game objects */
+		static unsigned long hashCacheHits;		/**< The number of hash requests for all game objects that were answered from the cache */
+
 		//If no ttl is given and the object is stored, it will not be able to exist in storage
 		//creationTime is initialised to an empty simtime_t object. Values such as zero do not work, since the scale exponent for simtime_t might not have been defined.
 		GameObject(const std::string objectName = "GameObject", int64_t o_size=0, simtime_t o_creationTime=SIMTIME_ZERO, int o_ttl=0);
@@ -77,6 +104,9 @@ class GameObject : public cOwnedObject
 		OverlayKey getContentHash();
 		OverlayKey getContentHash() const;
 
+		//The payload hash only covers the data of the object (its size and value, or its fragment), so objects with different names can share it.
+		OverlayKey getPayloadHash() const;
+
 		/** @returns Duplicate of the game object */
 		virtual GameObject *dup() const;
 
@@ -95,6 +125,9 @@ class GameObject : public cOwnedObject
 		int getValue() const;
 		void setValue(const int &val);
 
+		unsigned int getVersion() const;
+		void setVersion(const unsigned int &ver);
+
 		void setObjectName(const std::string& o_Name);
 
 		std::string getObjectName();
@@ -113,6 +146,26 @@ class GameObject : public cOwnedObject
 		void setGroupAddress(const TransportAddress &gr_adr);
 
 		bool isUnspecified();
+
+		/**
+		 * Turn the object into an erasure coded fragment of itself. Fragments do not affect the name and content hashes.
+		 *
+		 * @param index The index of the fragment in the code
+		 * @param data The coded bytes of the fragment
+		 * @param object_hash The content hash of the whole object
+		 */
+		void setFragment(int index, const std::vector<uint8_t> &data, const OverlayKey &object_hash);
+
+		bool isFragment() const { return fragmentIndex >= 0; }
+		int getFragmentIndex() const { return fragmentIndex; }
+		const std::vector<uint8_t> &getFragmentData() const { return fragmentData; }
+		std::vector<uint8_t> &getFragmentData() { return fragmentData; }
+		const OverlayKey &getObjectHash() const { return objectHash; }
+
+		/**
+		 * Turn a fragment back into the whole object.
+		 */
+		void clearFragment();
 };
 
 #endif /* GO_H_ */
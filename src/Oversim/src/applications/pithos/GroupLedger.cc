@@ -20,14 +20,18 @@ Define_Module(GroupLedger);
 GroupLedger::GroupLedger()
 {
 	periodicTimer = NULL;
+	expiryTimer = NULL;
 }
 
 GroupLedger::~GroupLedger()
 {
 	cancelAndDelete(periodicTimer);
+	cancelAndDelete(expiryTimer);
 
 	object_map.clear();
 	peer_list.clear();
+	peer_index.clear();
+	arena.clear();
 	group_size.clear();		//This will only have data if this is a super peer.
 }
 
@@ -52,6 +56,19 @@ void GroupLedger::initialize()
 
 	periodicTimer = new cMessage("GroupLedgerTimer");
 	scheduleAt(simTime(), periodicTimer);
+
+	expiryTimer = new cMessage("GroupLedgerExpiryTimer");
+	expiry_wheel.setResolution(par("expiryResolution").doubleValue());
+
+	//An erasure coded object is lost once fewer peers than its data fragments store it. The coding is set on the node's
+	//group storage. A pure super peer has none and stores no objects, so its ledger treats objects as replicated.
+	cModule *group_storage = getParentModule()->getSubmodule("group_storage");
+
+	if (group_storage != NULL && strcmp(group_storage->par("redundancy"), "erasure") == 0)
+		recoveryThreshold = group_storage->par("dataFragments");
+	else recoveryThreshold = 1;
+
+	minReputation = par("minReputation");
 }
 
 void GroupLedger::recordAndClear()
@@ -76,15 +93,68 @@ void GroupLedger::recordAndClear()
 
 	object_map.clear();
 	peer_list.clear();
+	peer_index.clear();
+	arena.clear();
+
+	expiry_wheel.clear();
+	cancelEvent(expiryTimer);
 }
 
-void GroupLedger::recordObjectNumbers()
+void GroupLedger::scheduleExpiryTimer()
+{
+	simtime_t wakeup = expiry_wheel.getTimerWakeup(expiryTimer);
+
+	if (wakeup < 0)
+		return;
+
+	cancelEvent(expiryTimer);
+	scheduleAt(wakeup, expiryTimer);
+}
+
+LedgerHandle GroupLedger::findPeer(PeerData peer_data)
+{
+	PeerIndexMap::iterator index_it = peer_index.find(peer_data.getAddress());
+
+	if (index_it == peer_index.end())
+		return LedgerArena::NULL_HANDLE;
+
+	return index_it->second;
+}
+
+LedgerHandle GroupLedger::insertPeer(PeerData peer_data)
+{
+	LedgerHandle peer = arena.addPeer(peer_data);
+
+	arena.peer(peer).slot = peer_list.size();
+	peer_list.push_back(peer);
+	peer_index[peer_data.getAddress()] = peer;
+
+	return peer;
+}
+
+void GroupLedger::erasePeer(LedgerHandle peer)
 {
-	PeerLedgerList::iterator peer_ledger_it;
+	uint32_t slot = arena.peer(peer).slot;
+	LedgerHandle last = peer_list.back();
+
+	peer_index.erase(arena.peer(peer).peerData.getAddress());
 
-	for (peer_ledger_it = peer_list.begin() ; peer_ledger_it != peer_list.end() ; peer_ledger_it++)
+	//Move the last peer into the vacated slot, so that no other peer has to be shifted
+	peer_list.at(slot) = last;
+	arena.peer(last).slot = slot;
+	peer_list.pop_back();
+
+	arena.removePeer(peer);
+}
+
+void GroupLedger::recordObjectNumbers()
+{
+	for (unsigned int i = 0 ; i < peer_list.size() ; i++)
 	{
-		peer_ledger_it->recordObjectNum();
+		PeerEntry &peer_entry = arena.peer(peer_list[i]);
+
+		peer_entry.object_total += peer_entry.links.size();
+		peer_entry.times_recorded++;
 	}
 }
 
@@ -99,7 +169,7 @@ int GroupLedger::countTotalObjects()
 
 	for (unsigned int i = 0 ; i < peer_list.size() ; i++)
 	{
-		count += peer_list.at(i).getObjectListSize();
+		count += arena.peer(peer_list.at(i)).links.size();
 	}
 
 	return count;
@@ -107,8 +177,6 @@ int GroupLedger::countTotalObjects()
 
 void GroupLedger::handleMessage(cMessage* msg)
 {
-    ObjectTTLTimer *ttlTimer = NULL;
-
     if (msg == periodicTimer)
     {
     	scheduleAt(simTime() + TEST_MAP_INTERVAL, msg);
@@ -155,11 +223,17 @@ void GroupLedger::handleMessage(cMessage* msg)
 			RECORD_STATS(globalStatistics->recordOutVector((group_name.str() + std::string("Number of known group peers")).c_str(), peer_list.size()));
 		}
     }
-    else if ((ttlTimer = dynamic_cast<ObjectTTLTimer*>(msg)) != NULL)
+    else if (msg == expiryTimer)
 	{
-		//If the object's TTL has expired, remove the object from the ledger.
-		removeObject(ttlTimer->getKey());
-		delete msg;
+		std::vector<OverlayKey> expired;
+
+		expiry_wheel.advance(simTime(), expired);
+
+		//If the objects' TTLs have expired, remove the objects from the ledger.
+		for (unsigned int i = 0 ; i < expired.size() ; i++)
+			removeObject(expired[i]);
+
+		scheduleExpiryTimer();
 	}
     else {
         throw cRuntimeError("[GroupLedger::handleMessage()]: Unknown message type!");
@@ -168,35 +242,25 @@ void GroupLedger::handleMessage(cMessage* msg)
 
 ObjectData GroupLedger::getObjectFromPeer(PeerData peer_data, const int &i)
 {
-	PeerLedgerList::iterator peer_ledger_it;
+	LedgerHandle peer = findPeer(peer_data);
 
-	for (peer_ledger_it = peer_list.begin() ; peer_ledger_it != peer_list.end() ; peer_ledger_it++)
+	if (peer == LedgerArena::NULL_HANDLE)
 	{
-		if (*(peer_ledger_it->peerDataPtr) == peer_data)
-		{
-			return *(peer_ledger_it->getObjectRef(i));
-		}
+		error("Peer not found in group ledger,");
+		return ObjectData();
 	}
 
-	error("Peer not found in group ledger,");
-	return ObjectData();
+	return arena.object(arena.peer(peer).links.at(i).handle).objectData;
 }
 
 int GroupLedger::getObjectLedgerSize(PeerData peer_data)
 {
-	PeerLedgerList::iterator peer_ledger_it;
-
-	//std::cout << "\nPeer data to match for size: " << peer_data.getAddress() << endl;
+	LedgerHandle peer = findPeer(peer_data);
 
-	for (peer_ledger_it = peer_list.begin() ; peer_ledger_it != peer_list.end() ; peer_ledger_it++)
-	{
-		//std::cout << "Currently comparing peer: " << peer_ledger_it->peerDataPtr->getAddress() << endl;
+	if (peer == LedgerArena::NULL_HANDLE)
+		return -1;
 
-		if (*(peer_ledger_it->peerDataPtr) == peer_data)
-			return peer_ledger_it->getObjectListSize();
-	}
-
-	return -1;
+	return arena.peer(peer).links.size();
 }
 
 int GroupLedger::getPeerLedgerSize(ObjectData object_data)
@@ -275,15 +339,7 @@ bool GroupLedger::isObjectInGroup(OverlayKey key)
 
 bool GroupLedger::isPeerInGroup(PeerData peerData)
 {
-	PeerLedgerList::iterator peer_ledger_it;
-
-	for (peer_ledger_it = peer_list.begin() ; peer_ledger_it != peer_list.end() ; peer_ledger_it++)
-	{
-		if (*(peer_ledger_it->peerDataPtr) == peerData)
-			return true;
-	}
-
-	return false;
+	return findPeer(peerData) != LedgerArena::NULL_HANDLE;
 }
 
 //****Careful, this is a very expensive function and should only be used for debugging purposes****
@@ -291,11 +347,7 @@ bool GroupLedger::verifyObjectOnPeer(ObjectData object_data, PeerData peer_data)
 {
 	unsigned int i;
 	ObjectLedgerMap::iterator object_map_it;
-	ObjectLedger object_ledger_entry;
-	PeerDataPtr peer_ptr;
-
-	PeerLedger peer_ledger_entry;
-	ObjectDataPtr object_ptr;
+	LedgerHandle object, peer;
 	bool found = true;
 
 	//Firstly check whether the peer is listed in the object's peer list.
@@ -303,41 +355,38 @@ bool GroupLedger::verifyObjectOnPeer(ObjectData object_data, PeerData peer_data)
 	if (object_map_it == object_map.end())
 		error("Object could not be found in group.");
 
-	object_ledger_entry = object_map_it->second;
+	object = object_map_it->second.getHandle();
+	LedgerLinkList &object_links = arena.object(object).links;
 
-	for (i = 0; i < object_ledger_entry.getPeerListSize() ; i++)
+	for (i = 0; i < object_links.size() ; i++)
 	{
-		peer_ptr = object_ledger_entry.getPeerRef(i);
-
-		if (*peer_ptr == peer_data)
+		if (arena.peer(object_links[i].handle).peerData == peer_data)
 			break;
 	}
 
-	if (i == object_ledger_entry.getPeerListSize())
+	if (i == object_links.size())
+		found = false;
+	//Every link should point back to itself through its mirror
+	else if (arena.peer(object_links[i].handle).links.at(object_links[i].back).handle != object)
 		found = false;
 
-	//Secondly, check whether the object is listed in the peer's object map
-	for (i = 0 ; i < peer_list.size() ; i++)
-	{
-		peer_ledger_entry = peer_list.at(i);
-
-		if (*(peer_ledger_entry.peerDataPtr) == peer_data)
-			break;
-	}
-
-	if (i == peer_list.size())
+	//Secondly, check whether the object is listed in the peer's object list
+	peer = findPeer(peer_data);
+	if (peer == LedgerArena::NULL_HANDLE)
 		error("Peer data not found in peer list.");
 
-	for (i = 0; i < peer_ledger_entry.getObjectListSize() ; i++)
-	{
-		object_ptr = peer_ledger_entry.getObjectRef(i);
+	LedgerLinkList &peer_links = arena.peer(peer).links;
 
-		if (*object_ptr == object_data)
+	for (i = 0; i < peer_links.size() ; i++)
+	{
+		if (arena.object(peer_links[i].handle).objectData == object_data)
 			break;
 	}
 
-	if (i == peer_ledger_entry.getObjectListSize())
-			found = false;
+	if (i == peer_links.size())
+		found = false;
+	else if (arena.object(peer_links[i].handle).links.at(peer_links[i].back).handle != peer)
+		found = false;
 
 	return found;
 }
@@ -352,6 +401,32 @@ bool GroupLedger::isObjectOnPeer(ObjectData object_data, PeerData peer_data)
 	return object_map_it->second.isPeerPresent(peer_data);
 }
 
+bool GroupLedger::isObjectDataNewer(ObjectData object_data)
+{
+	ObjectLedgerMap::iterator object_map_it = object_map.find(object_data.getKey());
+	if (object_map_it == object_map.end())
+		return false;
+
+	return object_data.supersedes(arena.object(object_map_it->second.getHandle()).objectData);
+}
+
+bool GroupLedger::isContentOnPeer(OverlayKey payload_hash, PeerData peer_data)
+{
+	LedgerHandle peer = findPeer(peer_data);
+	if (peer == LedgerArena::NULL_HANDLE)
+		return false;
+
+	LedgerLinkList &links = arena.peer(peer).links;
+
+	for (unsigned int i = 0 ; i < links.size() ; i++)
+	{
+		if (arena.object(links[i].handle).objectData.getPayloadHash() == payload_hash)
+			return true;
+	}
+
+	return false;
+}
+
 int GroupLedger::getReplicaNum(ObjectData object_data)
 {
 	ObjectLedgerMap::iterator object_map_it = object_map.find(object_data.getKey());
@@ -364,18 +439,229 @@ int GroupLedger::getReplicaNum(ObjectData object_data)
 PeerData GroupLedger::getRandomPeer(OverlayKey key)
 {
 	ObjectLedgerMap::iterator object_map_it;
-	ObjectLedger object_ledger_entry;
-	PeerDataPtr peer_ptr;
 
 	object_map_it = object_map.find(key);
 	if (object_map_it == object_map.end())
 		error("Object could not be found in group.");
 
-	object_ledger_entry = object_map_it->second;
+	return *(object_map_it->second.getRandPeerRef());
+}
+
+void GroupLedger::getObjectHolders(OverlayKey key, std::vector<PeerData> &holders)
+{
+	ObjectLedgerMap::iterator object_map_it = object_map.find(key);
+	if (object_map_it == object_map.end())
+		return;
 
-	peer_ptr = object_ledger_entry.getRandPeerRef();
+	for (unsigned int i = 0 ; i < object_map_it->second.getPeerListSize() ; i++)
+		holders.push_back(*(object_map_it->second.getPeerRef(i)));
+}
 
-	return *peer_ptr;
+/**
+ * Orders holders by their round trip time only, so that the shuffled order of holders with equal estimates is kept.
+ */
+static bool compareRtt(const std::pair<double, LedgerHandle> &a, const std::pair<double, LedgerHandle> &b)
+{
+	return a.first < b.first;
+}
+
+bool GroupLedger::getNearPeer(OverlayKey key, const std::set<TransportAddress> &exclude, unsigned int candidates, PeerData *peer_data)
+{
+	std::vector<std::pair<double, LedgerHandle> > holders;
+	ObjectLedgerMap::iterator object_map_it;
+
+	object_map_it = object_map.find(key);
+	if (object_map_it == object_map.end())
+		error("Object could not be found in group.");
+
+	LedgerLinkList &links = arena.object(object_map_it->second.getHandle()).links;
+
+	for (unsigned int i = 0 ; i < links.size() ; i++)
+	{
+		PeerEntry &peer = arena.peer(links[i].handle);
+
+		if (exclude.find(peer.peerData.getAddress()) != exclude.end())
+			continue;
+
+		//Unmeasured holders have an estimate of zero, so they are tried first and receive an estimate
+		holders.push_back(std::make_pair(peer.rtt.getSrtt(), links[i].handle));
+	}
+
+	if (holders.empty())
+		return false;
+
+	//Holders with a low reputation are only considered if no trusted holder is left
+	if (isReputationTracked())
+	{
+		std::vector<std::pair<double, LedgerHandle> > trusted;
+
+		for (unsigned int i = 0 ; i < holders.size() ; i++)
+		{
+			if (isTrusted(holders[i].second))
+				trusted.push_back(holders[i]);
+		}
+
+		if (!trusted.empty())
+			holders.swap(trusted);
+	}
+
+	//Shuffle the holders, so that ties are not always broken in the same way
+	for (unsigned int i = holders.size() - 1 ; i > 0 ; i--)
+		std::swap(holders[i], holders[intuniform(0, i)]);
+
+	if (candidates < 1)
+		candidates = 1;
+	if (candidates > holders.size())
+		candidates = holders.size();
+
+	std::partial_sort(holders.begin(), holders.begin() + candidates, holders.end(), compareRtt);
+
+	*peer_data = arena.peer(holders[intuniform(0, candidates-1)].second).peerData;
+
+	return true;
+}
+
+bool GroupLedger::getTrustedPeer(OverlayKey key, const std::set<TransportAddress> &exclude, PeerData *peer_data)
+{
+	std::vector<LedgerHandle> trusted;
+	std::vector<LedgerHandle> distrusted;
+	ObjectLedgerMap::iterator object_map_it;
+
+	object_map_it = object_map.find(key);
+	if (object_map_it == object_map.end())
+		error("Object could not be found in group.");
+
+	LedgerLinkList &links = arena.object(object_map_it->second.getHandle()).links;
+
+	for (unsigned int i = 0 ; i < links.size() ; i++)
+	{
+		if (exclude.find(arena.peer(links[i].handle).peerData.getAddress()) != exclude.end())
+			continue;
+
+		if (isTrusted(links[i].handle))
+			trusted.push_back(links[i].handle);
+		else distrusted.push_back(links[i].handle);
+	}
+
+	if (trusted.empty())
+		trusted.swap(distrusted);
+
+	if (trusted.empty())
+		return false;
+
+	*peer_data = arena.peer(trusted[intuniform(0, trusted.size()-1)]).peerData;
+
+	return true;
+}
+
+void GroupLedger::recordAgreement(PeerData peer_data, bool agreed)
+{
+	LedgerHandle peer = findPeer(peer_data);
+
+	if (peer == LedgerArena::NULL_HANDLE)
+		return;
+
+	if (agreed)
+		arena.peer(peer).agreements++;
+	else arena.peer(peer).disagreements++;
+}
+
+double GroupLedger::getReputation(LedgerHandle peer)
+{
+	PeerEntry &entry = arena.peer(peer);
+
+	return (entry.agreements + 1.0) / (entry.agreements + entry.disagreements + 2.0);
+}
+
+double GroupLedger::getReputation(PeerData peer_data)
+{
+	LedgerHandle peer = findPeer(peer_data);
+
+	if (peer == LedgerArena::NULL_HANDLE)
+		return 0.5;
+
+	return getReputation(peer);
+}
+
+bool GroupLedger::isTrusted(LedgerHandle peer)
+{
+	return getReputation(peer) >= minReputation;
+}
+
+void GroupLedger::recordRtt(PeerData peer_data, simtime_t rtt)
+{
+	LedgerHandle peer = findPeer(peer_data);
+
+	if (peer == LedgerArena::NULL_HANDLE)
+		return;
+
+	arena.peer(peer).rtt.addSample(SIMTIME_DBL(rtt));
+}
+
+RttEstimator *GroupLedger::getRttEstimator(PeerData peer_data)
+{
+	LedgerHandle peer = findPeer(peer_data);
+
+	if (peer == LedgerArena::NULL_HANDLE)
+		return NULL;
+
+	return &(arena.peer(peer).rtt);
+}
+
+int64_t GroupLedger::getPeerLoad(LedgerHandle peer, PlacementLoad load)
+{
+	if (load == PLACEMENT_BYTES)
+		return arena.peer(peer).bytes_stored;
+
+	return arena.peer(peer).links.size();
+}
+
+void GroupLedger::getStoragePeers(unsigned int count, TransportAddress exclude, PlacementLoad load, std::vector<PeerData> &chosen)
+{
+	//The positions of the peer list that have been swapped by the shuffle. All other positions hold their own index.
+	std::tr1::unordered_map<uint32_t, uint32_t> swapped;
+	std::tr1::unordered_map<uint32_t, uint32_t>::iterator swapped_it;
+	uint32_t n = peer_list.size();
+	uint32_t a, b, j;
+	unsigned int found = 0;
+
+	for (uint32_t i = 0 ; i < n && found < count ; i++)
+	{
+		//Draw a candidate from the positions that have not been used yet, and move it to position i
+		j = intuniform(i, n-1);
+		swapped_it = swapped.find(j);
+		a = (swapped_it == swapped.end()) ? j : swapped_it->second;
+		swapped_it = swapped.find(i);
+		swapped[j] = (swapped_it == swapped.end()) ? i : swapped_it->second;
+
+		//Draw a second candidate, and keep it at position i+1 so that it can still be drawn for the following replicas
+		if ((load != PLACEMENT_RANDOM || isReputationTracked()) && i+1 < n)
+		{
+			j = intuniform(i+1, n-1);
+			swapped_it = swapped.find(j);
+			b = (swapped_it == swapped.end()) ? j : swapped_it->second;
+			swapped_it = swapped.find(i+1);
+			swapped[j] = (swapped_it == swapped.end()) ? i+1 : swapped_it->second;
+
+			//A trusted candidate is preferred over one with a low reputation, and otherwise the less loaded one
+			if (isTrusted(peer_list[a]) != isTrusted(peer_list[b]))
+			{
+				if (isTrusted(peer_list[b]))
+					std::swap(a, b);
+			}
+			else if (load != PLACEMENT_RANDOM && getPeerLoad(peer_list[b], load) < getPeerLoad(peer_list[a], load))
+				std::swap(a, b);
+			swapped[i+1] = b;
+		}
+
+		PeerData &peer_data = arena.peer(peer_list[a]).peerData;
+
+		if (peer_data.getAddress() == exclude)
+			continue;
+
+		chosen.push_back(peer_data);
+		found++;
+	}
 }
 
 PeerData GroupLedger::getRandomPeer()
@@ -383,7 +669,7 @@ PeerData GroupLedger::getRandomPeer()
     if (peer_list.size() == 0)
         error("No peers in group.");
 
-    return *((peer_list.at(intuniform(0, peer_list.size()-1))).peerDataPtr);
+    return arena.peer(peer_list.at(intuniform(0, peer_list.size()-1))).peerData;
 }
 
 void GroupLedger::addPeer(PeerData peer_dat)
@@ -395,9 +681,7 @@ void GroupLedger::addPeer(PeerData peer_dat)
 	//If the peer is not known, add it to the peer list
 	if (!isPeerInGroup(peer_dat))
 	{
-		PeerLedger peer_ledger;
-		peer_ledger.peerDataPtr = PeerDataPtr(new PeerData(peer_dat));
-		peer_list.push_back(peer_ledger);
+		insertPeer(peer_dat);
 
 		if (isSuperPeerLedger())
 		{
@@ -499,8 +783,7 @@ void GroupLedger::recordStarvationStats(ObjectLedger object_ledger)
 
 void GroupLedger::removePeer(PeerData peer_dat)
 {
-	PeerLedgerList::iterator peer_ledger_it;
-	ObjectDataPtr object_data_ptr;
+	LedgerHandle peer, object;
 	ObjectLedgerMap::iterator object_ledger_it;
 	unsigned int objectListSize, peerListSize;
 
@@ -512,19 +795,13 @@ void GroupLedger::removePeer(PeerData peer_dat)
 	else std::cout << "[" << simTime() << ":peer " << thisAdr << "]: Peer slated for removal: " << peer_dat.getAddress() << endl;*/
 
 	//Find the peer in the peer list
-	for (peer_ledger_it = peer_list.begin() ; peer_ledger_it != peer_list.end() ; peer_ledger_it++)
-	{
-		if (*(peer_ledger_it->peerDataPtr) == peer_dat)
-		{
-			break;
-		}
-	}
+	peer = findPeer(peer_dat);
 
 	//std::ostringstream msg;
 	//msg << "[" << thisAdr << "]: Peer remove error\n";
 
 	//Record success or failure
-	if (peer_ledger_it == peer_list.end())
+	if (peer == LedgerArena::NULL_HANDLE)
 	{
 		//std::cout << "Peer (" << peer_dat.getAddress() << ") slated for removal not found.\n";
 		RECORD_STATS(numPeerRemoveFail++);
@@ -539,18 +816,19 @@ void GroupLedger::removePeer(PeerData peer_dat)
 	if (isSuperPeerLedger())
 	{
 		//Record the average number of objects that were stored on the peer being removed, during its lifetime
-		RECORD_STATS(globalStatistics->recordOutVector("Average group objects per peer", peer_ledger_it->getObjectAverage()));
+		PeerEntry &peer_entry = arena.peer(peer);
+		RECORD_STATS(globalStatistics->recordOutVector("Average group objects per peer", ((double)peer_entry.object_total)/peer_entry.times_recorded));
 	}
 
-	objectListSize = peer_ledger_it->getObjectListSize();
+	objectListSize = arena.peer(peer).links.size();
 
-	//Iterate through all object references listed for the peer
-	for (unsigned int i = 0 ; i < objectListSize ; i++)
+	//Iterate through all object references listed for the peer. Unlinking from the back means no links have to be moved.
+	for (unsigned int i = objectListSize ; i > 0 ; i--)
 	{
-		object_data_ptr = peer_ledger_it->getObjectRef(i);
+		object = arena.peer(peer).links[i-1].handle;
 
 		//Retrieve the object ledger for the listed object reference
-		object_ledger_it = object_map.find(object_data_ptr->getKey());
+		object_ledger_it = object_map.find(arena.object(object).objectData.getKey());
 		if (object_ledger_it == object_map.end())
 		{
 			RECORD_STATS(numObjectGetFail++);
@@ -558,33 +836,32 @@ void GroupLedger::removePeer(PeerData peer_dat)
 		} else RECORD_STATS(numObjectGetSuccess++);
 
 		//Remove the specific peer reference from the object ledger
-		object_ledger_it->second.erasePeerRef(peer_ledger_it->peerDataPtr);
+		arena.unlinkPeerAt(peer, i-1);
 
-		data_size -= object_ledger_it->second.objectDataPtr->getSize();
+		data_size -= arena.object(object).objectData.getSize();
 		objects_total--;
 
-		peerListSize = object_ledger_it->second.getPeerListSize();
+		peerListSize = arena.object(object).links.size();
 
-		/*std::cout << "There are now " << peerListSize << " copies of object " << object_ledger_it->second.objectDataPtr->getObjectName() << " available.\n";
-
-		if (peerListSize == 1)
-			std::cout << "The last copy is stored on " << object_ledger_it->second.getPeerRef(0)->getAddress() << endl;*/
-
-		//If the peer is removed and there are now no peers on which the object is stored, remove the object ledger entry
-		if (peerListSize == 0)
+		//If the object can no longer be recovered from the peers that store it, it has starved
+		if (peerListSize + 1 == recoveryThreshold)
 		{
-			std::ostringstream group_name;
-
 			//A peer has starved, record some lifetime stats for the group here
 			if (isSuperPeerLedger())
 			{
 				recordStarvationStats(object_ledger_it->second);
 			}
-			object_map.erase(object_ledger_it);
 			objects_starved++;
 		}
+
+		//If the peer is removed and there are now no peers on which the object is stored, remove the object ledger entry
+		if (peerListSize == 0)
+		{
+			object_map.erase(object_ledger_it);
+			arena.removeObject(object);
+		}
 	}
-	peer_list.erase(peer_ledger_it);
+	erasePeer(peer);
 
 	if (isSuperPeerLedger())
 	{
@@ -597,8 +874,7 @@ void GroupLedger::removePeer(PeerData peer_dat)
 void GroupLedger::removeObject(OverlayKey key)
 {
 	ObjectLedgerMap::iterator object_ledger_it;
-	PeerDataPtr peer_data_ptr;
-	PeerLedgerList::iterator peer_ledger_it;
+	LedgerHandle object;
 
 	object_ledger_it = object_map.find(key);
 	if (object_ledger_it == object_map.end())
@@ -607,28 +883,16 @@ void GroupLedger::removeObject(OverlayKey key)
 		return;
 	} else { RECORD_STATS(numObjectRemoveSuccess++); }
 
-	//Iterate through all peer references listed for the object
-	for (unsigned int i = 0 ; i < object_ledger_it->second.getPeerListSize() ; i++)
-	{
-		peer_data_ptr = object_ledger_it->second.getPeerRef(i);
-
-		//Find the peer in the peer list
-		for (peer_ledger_it = peer_list.begin() ; peer_ledger_it != peer_list.end() ; peer_ledger_it++)
-		{
-			if (peer_ledger_it->peerDataPtr == peer_data_ptr)
-			{
-				break;
-			}
-		}
-
-		if (peer_ledger_it == peer_list.end())
-			error("Peer not found when removing object.");
+	object = object_ledger_it->second.getHandle();
 
+	//Iterate through all peer references listed for the object. The back-pointer of every link locates the object reference in the peer's list.
+	while (!arena.object(object).links.empty())
+	{
 		//Remove the specific peer reference from the object ledger
-		peer_ledger_it->eraseObjectRef(object_ledger_it->second.objectDataPtr);
+		arena.unlinkObjectAt(object, arena.object(object).links.size()-1);
 
 		//Records the total size in object bytes that's stored in this ledger.
-		data_size -= object_ledger_it->second.objectDataPtr->getSize();
+		data_size -= arena.object(object).objectData.getSize();
 		objects_total--;
 
 		//Peers do not have to house objects to exist. A peer can exist, even if it stores no objects.
@@ -636,6 +900,7 @@ void GroupLedger::removeObject(OverlayKey key)
 
 	//TODO: Uncommenting this says that objects may exist, without being stored on any peer. This helps to tracks objects that have starved.
 	object_map.erase(object_ledger_it);
+	arena.removeObject(object);
 }
 
 /**
@@ -643,10 +908,9 @@ void GroupLedger::removeObject(OverlayKey key)
  */
 void GroupLedger::addObject(ObjectData objectData, PeerData peer_data_recv)
 {
-	PeerLedgerList::iterator peer_ledger_it;
+	LedgerHandle peer, object;
 	ObjectLedgerMap::iterator object_map_it;
-	ObjectLedger *object_ledger;
-	std::pair<ObjectLedgerMap::iterator,bool> ret;
+	bool refreshed = false;
 
 	Enter_Method_Silent();
 
@@ -660,33 +924,34 @@ void GroupLedger::addObject(ObjectData objectData, PeerData peer_data_recv)
 	//Check whether the received object information is already stored in the super peer
 	object_map_it = object_map.find(objectData.getKey());
 
-	//If the object is not already known, have the iterator point to a new object instead.
+	//If the object is not already known, create a new entry for it in the arena.
 	if (object_map_it == object_map.end())
 	{
-		//TODO: The fact that a duplicate key was received should be logged
-		object_ledger = new ObjectLedger();
-
 		//Log the file name and what peers it is stored on
-		object_ledger->objectDataPtr.reset(new ObjectData(objectData));
+		object = arena.addObject(objectData);
+		object_map.insert(std::make_pair(objectData.getKey(), ObjectLedger(&arena, object)));
 
-	} else object_ledger = &(object_map_it->second);
+	} else {
+		object = object_map_it->second.getHandle();
+		ObjectData &known = arena.object(object).objectData;
 
-	for (peer_ledger_it = peer_list.begin() ; peer_ledger_it != peer_list.end() ; peer_ledger_it++)
-	{
-		if (*(peer_ledger_it->peerDataPtr) == peer_data_recv)
-			break;
+		//An object that was updated or stored again is announced with its new size and payload hash, which are recorded for all of its peers
+		if (objectData.supersedes(known))
+		{
+			objectData.setInitGroupSize(known.getInitGroupSize());
+			data_size += (objectData.getSize() - known.getSize()) * (int)arena.object(object).links.size();
+			arena.setObjectData(object, objectData);
+			refreshed = true;
+		}
 	}
 
+	peer = findPeer(peer_data_recv);
+
 	//If an object is stored on an unknown peer, first add that peer to the peer list
-	if (peer_ledger_it == peer_list.end())
+	if (peer == LedgerArena::NULL_HANDLE)
 	{
 		//TODO: Log this exception
-		PeerLedger peer_ledger;
-		peer_ledger.peerDataPtr.reset(new PeerData(peer_data_recv));
-
-		//std::cout << "[" << thisAdr << "]: ";
-		peer_ledger.addObjectRef(object_ledger->objectDataPtr);
-		peer_list.push_back(peer_ledger);
+		peer = insertPeer(peer_data_recv);
 
 		if (isSuperPeerLedger())
 		{
@@ -695,35 +960,26 @@ void GroupLedger::addObject(ObjectData objectData, PeerData peer_data_recv)
 		}
 
 		/*if (isSuperPeerLedger())
-			std::cout << "[" << simTime() << ":super peer" << thisAdr << "]: Added peer because of unknown object: " << peer_ledger.peerDataPtr->getAddress() << endl;
-		else std::cout << "[" << simTime() << ":peer " << thisAdr << "]: Added peer because of unknown object: " << peer_ledger.peerDataPtr->getAddress() << endl;*/
-
-		object_ledger->addPeerRef(peer_ledger.peerDataPtr);	//Add a peer to the ObjectInfo object's peer vector
-
-	} else {
-
-		//std::cout << "[" << thisAdr << "]: ";
-		peer_ledger_it->addObjectRef(object_ledger->objectDataPtr);
-		object_ledger->addPeerRef(peer_ledger_it->peerDataPtr);	//Add a peer to the ObjectInfo object's peer vector
+			std::cout << "[" << simTime() << ":super peer" << thisAdr << "]: Added peer because of unknown object: " << peer_data_recv.getAddress() << endl;
+		else std::cout << "[" << simTime() << ":peer " << thisAdr << "]: Added peer because of unknown object: " << peer_data_recv.getAddress() << endl;*/
 	}
 
-	if (object_map_it == object_map.end())
-	{
-		ret = object_map.insert(std::make_pair(objectData.getKey(), *object_ledger));
-		//Ensure that a duplicate key wasn't inserted
-		if (ret.second == false)
-			error("[GroupLedger::addObject]: Duplicate key inserted into storage.");
+	//Record how many times an object was replicated. A peer announcing its update of a recorded replica did not store another one.
+	if (!refreshed || !arena.isLinked(peer, object))
+		arena.object(object).replications++;
 
-		delete(object_ledger);
+	//A peer that was already linked to this object is not linked again, and is not counted twice in the totals.
+	if (arena.link(peer, object))
+	{
+		data_size += objectData.getSize();
+		objects_total++;
 	}
 
-	data_size += objectData.getSize();
-	objects_total++;
-
-	//Schedule the object to be removed when its TTL expires.
-	ObjectTTLTimer* timer = new ObjectTTLTimer();
-	timer->setKey(objectData.getKey());
-	scheduleAt(objectData.getCreationTime() + objectData.getTTL(), timer);
+	//Schedule the object to be removed when its TTL expires. Further links to the same object do not add another entry.
+	//The recorded data is used, since an announcement of an older version of the object may arrive late.
+	ObjectData &recorded = arena.object(object).objectData;
+	expiry_wheel.schedule(recorded.getKey(), recorded.getCreationTime() + recorded.getTTL());
+	scheduleExpiryTimer();
 }
 
 unsigned int GroupLedger::getGroupSize()
@@ -736,9 +992,9 @@ unsigned int GroupLedger::getNumGroupObjects()
 	return object_map.size();
 }
 
-PeerDataPtr GroupLedger::getPeerPtr(const int &i)
+PeerData *GroupLedger::getPeerPtr(const int &i)
 {
-	return (peer_list.at(i)).peerDataPtr;
+	return &(arena.peer(peer_list.at(i)).peerData);
 }
 
 ObjectLedgerMap::iterator GroupLedger::getObjectMapBegin()
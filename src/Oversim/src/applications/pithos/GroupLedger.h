@@ -16,20 +16,32 @@
 #ifndef GROUPLEDGER_H_
 #define GROUPLEDGER_H_
 
+#include <set>
+#include <algorithm>
+#include <tr1/unordered_map>
+
 #include <GlobalStatistics.h>
 #include <GlobalStatisticsAccess.h>
 #include <DHTTestAppMessages_m.h>
 
 #include "ObjectLedger.h"
+#include "LedgerArena.h"
+#include "ExpiryWheel.h"
 #include "Communicator.h"
 #include "GroupStorage.h"
-#include "PeerLedger.h"
-
-class PeerLedger;
 
-typedef std::vector<PeerLedger> PeerLedgerList;
+/**
+ * A dense list of the arena handles of all known peers.
+ * When a peer is removed, the last peer is moved into its slot.
+ */
+typedef std::vector<LedgerHandle> PeerHandleList;
 typedef std::map<OverlayKey, ObjectLedger> ObjectLedgerMap;
 
+/**
+ * Maps the transport address of every known peer to its handle in the ledger arena.
+ */
+typedef std::tr1::unordered_map<TransportAddress, LedgerHandle, TransportAddress::hashFcn> PeerIndexMap;
+
 class GroupLedger : public cSimpleModule
 {
 	private:
@@ -41,8 +53,55 @@ class GroupLedger : public cSimpleModule
 	    void recordStarvationStats(ObjectLedger object_ledger);
 	    void recordObjectNumbers();
 
-		/**< A map that records all peers that belong to this peer's group */
-		PeerLedgerList peer_list;
+	    /**
+	     * (Re)schedule the expiry timer for the next time the expiry wheel has to be advanced.
+	     */
+	    void scheduleExpiryTimer();
+
+	    /**
+	     * Looks up a peer in O(1).
+	     *
+	     * @param peer_data The peer data containing the peer's transport address
+	     * @return the handle of the peer in the arena, or LedgerArena::NULL_HANDLE if the peer is unknown
+	     */
+	    LedgerHandle findPeer(PeerData peer_data);
+
+	    /**
+	     * Adds a peer to the arena, appends it to the peer list and records it in the peer index.
+	     *
+	     * @return the handle of the new peer in the arena
+	     */
+	    LedgerHandle insertPeer(PeerData peer_data);
+
+	    /**
+	     * Removes a peer by moving the last peer in the peer list into its slot, so that removal is O(1).
+	     * The order of the peer list is therefore not preserved. The peer should not store any objects anymore.
+	     */
+	    void erasePeer(LedgerHandle peer);
+
+	    /**
+	     * @return the load of a peer, as used to compare peers when replicas are placed
+	     */
+	    int64_t getPeerLoad(LedgerHandle peer, PlacementLoad load);
+
+	    /**
+	     * @return the reputation of a peer in the arena, see getReputation()
+	     */
+	    double getReputation(LedgerHandle peer);
+
+	    /**
+	     * @return true if the reputation of a peer is at least minReputation
+	     */
+	    bool isTrusted(LedgerHandle peer);
+
+	    /**< Stores all peer and object entries, and the links between them */
+	    LedgerArena arena;
+
+		/**< A list that records all peers that belong to this peer's group */
+		PeerHandleList peer_list;
+
+		/**< Transport address index into the arena, so that peers can be found without scanning the peer list */
+		PeerIndexMap peer_index;
 
 		/**< A map that records all objects information stored in this super peer's group */
 		ObjectLedgerMap object_map;
@@ -53,8 +112,13 @@ class GroupLedger : public cSimpleModule
 
 		cMessage *periodicTimer; /**< timer self-message for writing periodic statistical information */
 
+		ExpiryWheel expiry_wheel;	/**< Keeps track of when the objects in the ledger expire. Every object is scheduled once, regardless of how many peers store it. */
+		cMessage *expiryTimer;		/**< timer self-message that triggers the removal of expired objects */
+
 		int objects_total;		//The number of objects including replicas
 		int objects_starved;	//The number of objects that have been lost due to peers leaving
+		unsigned int recoveryThreshold;	//The number of peers that have to store an object for it to be recoverable
+		double minReputation;	//Peers with a lower reputation are avoided for GETs and PUTs
 		double object_lifetime;
 		int data_size;			//The total size in bytes stored in the ledger
 
@@ -89,6 +153,22 @@ class GroupLedger : public cSimpleModule
 		 */
 		bool isObjectOnPeer(ObjectData object_data, PeerData peer_data);
 
+		/**
+		 * Checks whether the given object data was updated or stored again since the ledger recorded the object.
+		 *
+		 * @return true if the object is known and object_data supersedes its recorded data
+		 */
+		bool isObjectDataNewer(ObjectData object_data);
+
+		/**
+		 * Checks whether a peer stores any object with the given payload hash, in which case it already holds the data of
+		 * every object with that hash.
+		 *
+		 * @param payload_hash The hash of the object's data
+		 * @param peer_data The peer data of the peer in question
+		 */
+		bool isContentOnPeer(OverlayKey payload_hash, PeerData peer_data);
+
 		/**
 		 * Checks whether a given peer exists in the ledger.
 		 *
@@ -122,6 +202,87 @@ class GroupLedger : public cSimpleModule
 		 */
 		PeerData getRandomPeer(OverlayKey key);
 
+		/**
+		 * Lists all peers that store the specified object.
+		 *
+		 * @param key A key hash of the object
+		 * @param holders The peers storing the object are appended to this list. It stays empty if the object is not in the group.
+		 */
+		void getObjectHolders(OverlayKey key, std::vector<PeerData> &holders);
+
+		/**
+		 * Choose a peer that hosts the specified object and is expected to respond quickly. The holders are ranked by their
+		 * smoothed round trip time, and one of the best ranked holders is chosen at random, so that requesters that measure
+		 * similar round trip times do not all pick the same holder. Holders that have not been measured yet are ranked first.
+		 *
+		 * @param key A key hash of the object that the peer should contain
+		 * @param exclude The addresses of peers that should not be chosen
+		 * @param candidates The number of best ranked holders from which the peer is chosen
+		 * @param peer_data Receives the data of the chosen peer
+		 *
+		 * @return false if every holder of the object is excluded
+		 */
+		bool getNearPeer(OverlayKey key, const std::set<TransportAddress> &exclude, unsigned int candidates, PeerData *peer_data);
+
+		/**
+		 * Choose a random peer that hosts the specified object, preferring peers that are trusted. A peer whose reputation
+		 * is below minReputation is only chosen if no trusted holder is left.
+		 *
+		 * @param key A key hash of the object that the peer should contain
+		 * @param exclude The addresses of peers that should not be chosen
+		 * @param peer_data Receives the data of the chosen peer
+		 *
+		 * @return false if every holder of the object is excluded
+		 */
+		bool getTrustedPeer(OverlayKey key, const std::set<TransportAddress> &exclude, PeerData *peer_data);
+
+		/**
+		 * Record whether a peer's response agreed with the object the other holders returned.
+		 * Responses of peers that are not in the ledger are ignored.
+		 *
+		 * @param peer_data The peer that responded
+		 * @param agreed false if the peer returned a different object than the majority
+		 */
+		void recordAgreement(PeerData peer_data, bool agreed);
+
+		/**
+		 * The reputation of a peer is the estimated probability that it returns the correct object,
+		 * (agreements + 1) / (agreements + disagreements + 2), so that an unknown peer starts at 0.5.
+		 *
+		 * @return the reputation of a peer, or 0.5 if the peer is not in the ledger
+		 */
+		double getReputation(PeerData peer_data);
+
+		/**
+		 * @return true if peers are chosen by their reputation
+		 */
+		bool isReputationTracked() { return minReputation > 0; }
+
+		/**
+		 * Record a measured round trip time to a peer. Measurements of peers that are not in the ledger are ignored.
+		 */
+		void recordRtt(PeerData peer_data, simtime_t rtt);
+
+		/**
+		 * @return the round trip time estimate of a peer, or NULL if the peer is not in the ledger
+		 */
+		RttEstimator *getRttEstimator(PeerData peer_data);
+
+		/**
+		 * Choose distinct peers to store the replicas of an object.
+		 * The peer list is sampled without replacement by a partial Fisher-Yates shuffle, which only records the positions
+		 * it has swapped, so that choosing r peers takes O(r) time regardless of the group size. Unless the load is
+		 * PLACEMENT_RANDOM, two candidates are drawn for every replica and the less loaded one is chosen. The other
+		 * candidate remains available for the following replicas. If reputation is tracked, two candidates are always
+		 * drawn, and a trusted candidate is chosen over one with a low reputation regardless of their load.
+		 *
+		 * @param count The number of peers to choose
+		 * @param exclude The address of a peer that should not be chosen
+		 * @param load The load by which candidates are compared
+		 * @param chosen The chosen peers are appended to this list. Fewer than count peers are chosen if the group is too small.
+		 */
+		void getStoragePeers(unsigned int count, TransportAddress exclude, PlacementLoad load, std::vector<PeerData> &chosen);
+
 		/**
 		 * Add a peer to the ledger
 		 *
@@ -149,13 +310,18 @@ class GroupLedger : public cSimpleModule
 		 */
 		unsigned int getNumGroupObjects();
 
+		/**
+		 * @return the number of bytes stored in the group, including replicas
+		 */
+		int getDataSize() { return data_size; }
+
 		/**
 		 * Retrieve the information of a peer at a specific location in the peer list
 		 *
 		 * @param i The index where the peer should be retrieved.
-		 * @return A smart pointer to the peer at the specified index.
+		 * @return A pointer to the peer at the specified index. It remains valid until the peer is removed.
 		 */
-		PeerDataPtr getPeerPtr(const int &i);
+		PeerData *getPeerPtr(const int &i);
 
 		ObjectData getObjectFromPeer(PeerData peer_data, const int &i);
 		int getObjectLedgerSize(PeerData peer_data);
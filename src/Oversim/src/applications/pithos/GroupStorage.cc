@@ -20,6 +20,9 @@ Define_Module(GroupStorage);
 
 GroupStorage::GroupStorage() {
 	event = NULL;
+	expiryTimer = NULL;
+	objectAddTimer = NULL;
+	gossipTimer = NULL;
 }
 
 GroupStorage::~GroupStorage()
@@ -28,6 +31,9 @@ GroupStorage::~GroupStorage()
 	std::vector<ResponseTimeoutEvent *>::iterator timeout_it;
 
 	cancelAndDelete(event);
+	cancelAndDelete(expiryTimer);
+	cancelAndDelete(objectAddTimer);
+	cancelAndDelete(gossipTimer);
 
 	for (requests_it = pendingRequests.begin(); requests_it != pendingRequests.end(); requests_it++)
 	{
@@ -36,11 +42,18 @@ GroupStorage::~GroupStorage()
 			cancelAndDelete(*timeout_it);
 		}
 		requests_it->second.timeouts.clear();
+
+		clearHedge(requests_it->second);
+
+		if (requests_it->second.retrieveRequest != NULL)
+			delete(requests_it->second.retrieveRequest);
 	}
 
 	pendingRequests.clear();
 
 	storage_map.clear();
+	totals.clear();
+	content_store.clear();
 }
 
 void GroupStorage::initialize()
@@ -50,6 +63,8 @@ void GroupStorage::initialize()
 	directory_port = par("directory_port");
 
 	requestTimeout = par("requestTimeout");
+	adaptiveTimeouts = par("adaptiveTimeouts");
+	minRequestTimeout = par("minRequestTimeout");
 
 	gracefulMigration = par("gracefulMigration");
 
@@ -88,9 +103,109 @@ void GroupStorage::initialize()
 	pingTime = par("pingTime");
 	scheduleAt(simTime()+pingTime, pingTimer);
 
+	expiryTimer = new cMessage("expiryTimer");	//The timer that removes expired objects from the storage map
+	expiry_wheel.setResolution(par("expiryResolution").doubleValue());
+
+	totals.setBucketSize((int)par("ttlBucketSize").doubleValue());
+	storageBytesSignal = registerSignal("storageBytes");
+	storageObjectsSignal = registerSignal("storageObjects");
+	storageContentBytesSignal = registerSignal("storageContentBytes");
+	emitStorageTotals();
+
+	objectAddWindow = par("objectAddWindow");
+	objectAddBatchSize = par("objectAddBatchSize");
+	objectAddTimer = new cMessage("objectAddTimer");	//The timer that sends batched OBJECT_ADD notifications
+
+	membership_log.setCapacity(par("membershipLogSize"));
+
+	if (strcmp(par("groupMode"), "partial") == 0)
+	{
+		partialGroup = true;
+	}
+	else if (strcmp(par("groupMode"), "full") == 0)
+	{
+		partialGroup = false;
+	}else error("Invalid group mode specified. It should be \"full\", or \"partial\"");
+
+	viewSize = par("viewSize");
+	view.setCapacity(viewSize);
+	gossipInterval = par("gossipInterval");
+	rumorRounds = par("rumorRounds");
+	maxHops = par("maxHops");
+	if ((int)par("hopFailureTimeouts") < 1)
+		error("At least one timeout is required before a first hop is reported as failed.");
+	hopFailureTimeouts = par("hopFailureTimeouts");
+
+	if (strcmp(par("replicaSelection"), "latency") == 0)
+	{
+		nearReplicas = true;
+	}
+	else if (strcmp(par("replicaSelection"), "random") == 0)
+	{
+		nearReplicas = false;
+	}else error("Invalid replica selection specified. It should be \"random\", or \"latency\"");
+	latencyCandidates = par("latencyCandidates");
+
+	if (strcmp(par("placementLoad"), "random") == 0)
+	{
+		placementLoad = PLACEMENT_RANDOM;
+	}
+	else if (strcmp(par("placementLoad"), "objects") == 0)
+	{
+		placementLoad = PLACEMENT_OBJECTS;
+	}
+	else if (strcmp(par("placementLoad"), "bytes") == 0)
+	{
+		placementLoad = PLACEMENT_BYTES;
+	}else error("Invalid placement load specified. It should be \"random\", \"objects\", or \"bytes\"");
+
+	if (strcmp(par("redundancy"), "replication") == 0)
+	{
+		erasureCoding = false;
+	}
+	else if (strcmp(par("redundancy"), "erasure") == 0)
+	{
+		erasureCoding = true;
+	}else error("Invalid redundancy specified. It should be \"replication\", or \"erasure\"");
+
+	dataFragments = par("dataFragments");
+
+	if (erasureCoding)
+	{
+		unsigned int fragments = par("replicas");
+
+		if (dataFragments < 1 || dataFragments > fragments)
+			error("[GroupStorage]: The number of data fragments should be between one and the number of replicas.");
+
+		//Object repair and partially connected groups copy whole objects, which would duplicate fragments
+		if (objectRepair || strcmp(par("groupMode"), "full") != 0 || par("hedgedGets").boolValue())
+			error("[GroupStorage]: Erasure coding cannot be combined with object repair, partially connected groups or hedged GET requests.");
+
+		erasure_code.init(dataFragments, fragments - dataFragments);
+	}
+
+	deduplication = par("deduplication");
+
+	hedgedGets = par("hedgedGets");
+	hedgePercentile = par("hedgePercentile");
+	if (hedgePercentile < 0 || hedgePercentile > 1)
+		error("[GroupStorage]: The hedge percentile should be between 0 and 1.");
+	hedgeDelay = par("hedgeDelay");
+	minHedgeSamples = par("minHedgeSamples");
+	getLatencies.setCapacity(par("latencyWindowSize"));
+
+	hashVoting = par("hashVoting");
+	if (hashVoting && (hedgedGets || erasureCoding || partialGroup))
+		error("[GroupStorage]: Hash voting cannot be combined with hedged GET requests, erasure coding or partially connected groups.");
+
+	gossipTimer = new cMessage("gossipTimer");	//The timer that starts gossip exchanges in partially connected groups
+	if (partialGroup)
+		scheduleAt(simTime()+uniform(0, gossipInterval), gossipTimer);	//Peers should not all gossip at the same time
+
 	globalStatistics = GlobalStatisticsAccess().get();
 	globalNodeList = GlobalNodeListAccess().get();
 	isMalicious = false;	//This is correctly set the first time we receive a join request from the higher layer
+	isBatching = false;
 
 	// statistics
 	numSent = 0;
@@ -104,12 +219,36 @@ void GroupStorage::initialize()
 	numGetSecondBad = 0;
 	numGetReponses = 0;
 	numPutReponses = 0;
+	numObjectAddBatches = 0;
+	objectAddBytesSaved = 0;
+	numRequestBatches = 0;
+	numBatchedRequests = 0;
+	numGossipSent = 0;
+	gossipBytesSent = 0;
+	numGetHedged = 0;
+	numLateResponses = 0;
+	numObjectsDecoded = 0;
+	numDecodeErrors = 0;
+	numDecodeCorrupt = 0;
+	numGetHedgeWon = 0;
+	numVoteBodiesRejected = 0;
+	voteBytesSaved = 0;
+	numModSent = 0;
+	numModSuccess = 0;
+	numModError = 0;
+	numModStale = 0;
+	updateBytesSaved = 0;
+	numPutsDeduplicated = 0;
+	numStoreOverwrites = 0;
+	dedupBytesSaved = 0;
+	numContentMissing = 0;
 
 	//Get error reasons
 	getErrMissingObjectOtherPeer = 0;
 	getErrMissingObjectSamePeer = 0;
 	getErrRequestOOG = 0;
 	putErrStoreOOG = 0;
+	getErrMaxHops = 0;
 
 	//initRpcs();
 	WATCH(numSent);
@@ -129,8 +268,22 @@ void GroupStorage::initialize()
 
 	WATCH(numGetReponses);
 	WATCH(numPutReponses);
+	WATCH(numObjectAddBatches);
+	WATCH(numRequestBatches);
+	WATCH(objectAddBytesSaved);
+	WATCH(numGossipSent);
+	WATCH(numGetHedged);
+	WATCH(numLateResponses);
+	WATCH(numObjectsDecoded);
+	WATCH(numVoteBodiesRejected);
+	WATCH(numModSent);
+	WATCH(numModStale);
+	WATCH(numPutsDeduplicated);
+	WATCH(numStoreOverwrites);
+	WATCH(dedupBytesSaved);
 
 	WATCH_MAP(storage_map);
+	WATCH_MAP(totals.getBuckets());
 }
 
 void GroupStorage::finish()
@@ -160,6 +313,55 @@ void GroupStorage::finish()
 		globalStatistics->addStdDev("GroupStorage: PUT responses received/s", numPutReponses / time);
 		globalStatistics->addStdDev("GroupStorage: GET responses received/s", numGetReponses / time);
 
+		globalStatistics->addStdDev("GroupStorage: OBJECT_ADD batches sent/s", numObjectAddBatches / time);
+		globalStatistics->addStdDev("GroupStorage: OBJECT_ADD bytes saved by batching/s", objectAddBytesSaved / time);
+
+		globalStatistics->addStdDev("GroupStorage: Request batches sent/s", numRequestBatches / time);
+		if (numRequestBatches > 0)
+			globalStatistics->addStdDev("GroupStorage: Requests per batch", (double)numBatchedRequests / numRequestBatches);
+
+		globalStatistics->addStdDev("GroupStorage: Responses received after timeout/s", numLateResponses / time);
+
+		if (erasureCoding)
+		{
+			globalStatistics->addStdDev("GroupStorage: Objects decoded from fragments/s", numObjectsDecoded / time);
+			globalStatistics->addStdDev("GroupStorage: Fragment decoding errors/s", numDecodeErrors / time);
+			globalStatistics->addStdDev("GroupStorage: Corrupt decoded objects/s", numDecodeCorrupt / time);
+		}
+
+		globalStatistics->addStdDev("GroupStorage: Sent MOD Messages/s", numModSent / time);
+		globalStatistics->addStdDev("GroupStorage: Failed MOD Requests/s", numModError / time);
+		globalStatistics->addStdDev("GroupStorage: Successful MOD Requests/s", numModSuccess / time);
+		globalStatistics->addStdDev("GroupStorage: MOD rejected as stale/s", numModStale / time);
+		globalStatistics->addStdDev("GroupStorage: MOD bytes saved by delta transfer/s", updateBytesSaved / time);
+		globalStatistics->addStdDev("GroupStorage: Stored objects overwritten by a PUT/s", numStoreOverwrites / time);
+
+		if (deduplication)
+		{
+			globalStatistics->addStdDev("GroupStorage: PUT objects sent by payload hash/s", numPutsDeduplicated / time);
+			globalStatistics->addStdDev("GroupStorage: PUT bytes saved by deduplication/s", dedupBytesSaved / time);
+			globalStatistics->addStdDev("GroupStorage: PUT payloads resent in full/s", numContentMissing / time);
+		}
+
+		if (hashVoting)
+		{
+			globalStatistics->addStdDev("GroupStorage: GET objects rejected after hash vote/s", numVoteBodiesRejected / time);
+			globalStatistics->addStdDev("GroupStorage: GET bytes saved by hash voting/s", voteBytesSaved / time);
+		}
+
+		if (hedgedGets)
+		{
+			globalStatistics->addStdDev("GroupStorage: Hedged GET requests sent/s", numGetHedged / time);
+			globalStatistics->addStdDev("GroupStorage: GET won by hedged request/s", numGetHedgeWon / time);
+		}
+
+		if (partialGroup)
+		{
+			globalStatistics->addStdDev("GroupStorage: Sent gossip messages/s", numGossipSent / time);
+			globalStatistics->addStdDev("GroupStorage: Sent gossip bytes/s", gossipBytesSent / time);
+			globalStatistics->addStdDev("GroupStorage: GET error: Object not reached within hop limit/s", getErrMaxHops / time);
+		}
+
 		if (isMalicious)
 			globalStatistics->addStdDev("GroupStorage: Was malicious", 1);
 		else globalStatistics->addStdDev("GroupStorage: Was malicious", 0);
@@ -184,9 +386,11 @@ TransportAddress GroupStorage::getSuperPeerAddress()
 	return super_peer_address;
 }
 
-int GroupStorage::getStorageFiles()
+void GroupStorage::emitStorageTotals()
 {
-	return storage_map.size();
+	emit(storageBytesSignal, (long)totals.getBytes());
+	emit(storageObjectsSignal, (long)totals.getObjects());
+	emit(storageContentBytesSignal, (long)content_store.getBytes());
 }
 
 void GroupStorage::createResponseMsg(ResponsePkt **response, int responseType, simtime_t request_time, unsigned int rpcid, bool isSuccess, const GameObject& object)
@@ -208,6 +412,10 @@ void GroupStorage::createResponseMsg(ResponsePkt **response, int responseType, s
 		if (isMalicious)
 		{
 			object_ptr->setValue(intuniform(0, 100000));
+
+			//The value of a fragment is not used, so its coded data is corrupted instead
+			if (object_ptr->isFragment() && !object_ptr->getFragmentData().empty())
+				object_ptr->getFragmentData()[0] ^= intuniform(1, 255);
 			globalStatistics->addStdDev("GroupStorage: Packets corrupted", 1);
 		} else {
 			globalStatistics->addStdDev("GroupStorage: Packets corrupted", 0);
@@ -243,20 +451,78 @@ void GroupStorage::sendUpperResponse(int responseType, simtime_t request_time, u
 	send(response, "read");
 }
 
-void GroupStorage::forwardRequest(OverlayKeyPkt *retrieve_req)
+bool GroupStorage::sendGroupRetrieve(OverlayKeyPkt *retrieve_req, PendingRequestsEntry &entry)
 {
-	std::set<TransportAddress> chosen_peers;
-	std::set<TransportAddress>::iterator chosen_peers_it;
-	int choose_tries;
-	int group_size = group_ledger->getGroupSize();
-	OverlayKeyPkt *retrieve_dup;
-
+	int choose_tries = 0;
+	int group_size;
 	PeerData container_peer;
+
+	//A peer in a partially connected group may not have heard of the object yet. The request is then routed through its view.
+	bool isObjectKnown = group_ledger->isObjectInGroup(retrieve_req->getKey());
+
+	if (isObjectKnown)
+		group_size = group_ledger->getGroupSize();
+	else if (partialGroup)
+		group_size = view.size();
+	else return false;
+
+	if (isObjectKnown && nearReplicas)
+	{
+		//Holders with a low round trip time are preferred
+		if (!group_ledger->getNearPeer(retrieve_req->getKey(), entry.contacted, latencyCandidates, &container_peer))
+			return false;
+
+		entry.contacted.insert(container_peer.getAddress());
+	}
+	else if (isObjectKnown && group_ledger->isReputationTracked())
+	{
+		//Holders that have returned corrupted objects before are only asked if no other holder is left
+		if (!group_ledger->getTrustedPeer(retrieve_req->getKey(), entry.contacted, &container_peer))
+			return false;
+
+		entry.contacted.insert(container_peer.getAddress());
+	} else {
+		while(choose_tries < 2*group_size)
+		{
+			if (isObjectKnown)
+				container_peer = group_ledger->getRandomPeer(retrieve_req->getKey());
+			else container_peer = view.getRandomPeer();
+
+			if (entry.contacted.find(container_peer.getAddress()) == entry.contacted.end())
+			{
+				entry.contacted.insert(container_peer.getAddress());
+				break;
+			}
+			else choose_tries++;
+		}
+		if (choose_tries >= 2*group_size)
+			return false;
+	}
+
+	//Send a retrieve request to the group peer storing the object
+	OverlayKeyPkt *retrieve_dup = retrieve_req->dup();
+	retrieve_dup->setDestinationAddress(container_peer.getAddress());
+	retrieve_dup->setGroupAddress(super_peer_address);
+
+	retrieve_dup->setHops(retrieve_req->getHops()+1);
+	retrieve_dup->setRoutedVia(container_peer.getAddress());
+
+	sendToPeer(retrieve_dup);
+	entry.numGetSent++;
+	RECORD_STATS(numSent++; numGetSent++);
+
+	//Create and schedule request timeout timer, and insert it into list of pending requests
+	entry.timeouts.push_back(scheduleRequestTimeout(retrieve_req->getValue(), container_peer));
+
+	return true;
+}
+
+void GroupStorage::forwardRequest(OverlayKeyPkt *retrieve_req)
+{
 	PendingRequestsEntry entry;
 	int rpcid = retrieve_req->getValue();
 
-	//TODO: This check can later be removed if a partially connected group is required with recursive routing within the group.
-	//Such a grouping could have nodes connected to a certain percentage of other nodes, reducing group bandwidth usage and only slightly increasing latency.
+	//Requests are only routed further than the first hop in partially connected groups (see routeRequest)
 	if (retrieve_req->getHops() > 0)
 		error("[GroupStorage]: Object not found on destination node in group.");
 
@@ -264,49 +530,515 @@ void GroupStorage::forwardRequest(OverlayKeyPkt *retrieve_req)
 	entry.numGetSent = 0;
 	entry.request_time = retrieve_req->getTimestamp();
 
+	if (erasureCoding)
+	{
+		//The fragment stored on this peer, if any, counts towards the fragments required
+		StorageMap::iterator storage_map_it = storage_map.find(retrieve_req->getKey());
+		if (storage_map_it != storage_map.end() && storage_map_it->second.isFragment())
+			entry.fragments.push_back(storage_map_it->second);
+
+		entry.contacted.insert(this_address);
+		entry.retrieveRequest = retrieve_req;
+
+		PendingRequests::iterator it = pendingRequests.insert(std::make_pair(rpcid, entry)).first;
+
+		if (it->second.fragments.size() >= dataFragments || !requestMissingFragments(it))
+			finishFragmentRequest(it);
+		return;
+	}
+
+	if (hedgedGets)
+	{
+		//Only one request is sent. A second replica holder is only asked if no response arrived within the usual GET latency.
+		if (sendGroupRetrieve(retrieve_req, entry))
+		{
+			entry.hedgeRequest = retrieve_req;
+
+			entry.hedgeTimer = new ResponseTimeoutEvent("hedge");
+			entry.hedgeTimer->setRpcid(rpcid);
+			scheduleAt(simTime()+getHedgeDelay(), entry.hedgeTimer);
+
+			pendingRequests.insert(std::make_pair(rpcid, entry));
+		} else {
+			//No response would ever arrive, so the failure is reported immediately
+			sendUpperResponse(GROUP_GET, entry.request_time, rpcid, false);
+			RECORD_STATS(numGetError++);
+			delete(retrieve_req);
+		}
+		return;
+	}
+
+	if (hashVoting)
+	{
+		//Only content hashes are requested. The object itself is fetched once a majority of the holders agree on its hash.
+		OverlayKeyPkt *hash_req = retrieve_req->dup();
+		hash_req->setPayloadType(HASH_REQ);
+
+		for (int i = 0 ; i < numGetRequests ; i++)
+			sendGroupRetrieve(hash_req, entry);
+		delete(hash_req);
+
+		entry.retrieveRequest = retrieve_req;
+		PendingRequests::iterator it = pendingRequests.insert(std::make_pair(rpcid, entry)).first;
+
+		//Too few holders could be asked to ever reach a majority
+		if (entry.numGetSent < numGetRequests/2 + 1)
+			finishVote(it, false);
+		return;
+	}
+
 	for (int i = 0 ; i < numGetRequests ; i++)
+		sendGroupRetrieve(retrieve_req, entry);
+
+	pendingRequests.insert(std::make_pair(rpcid, entry));
+	delete(retrieve_req);
+}
+
+simtime_t GroupStorage::getHedgeDelay()
+{
+	//Until enough latencies have been observed, the configured delay is used
+	if (getLatencies.size() < minHedgeSamples)
+		return hedgeDelay;
+
+	simtime_t delay = getLatencies.getPercentile(hedgePercentile);
+
+	if (delay > requestTimeout)
+		delay = requestTimeout;
+
+	return delay;
+}
+
+void GroupStorage::sendHedge(PendingRequests::iterator it)
+{
+	PendingRequestsEntry &entry = it->second;
+
+	if (entry.hedgeRequest == NULL)
+		return;
+
+	if (entry.hedgeTimer != NULL)
 	{
-		retrieve_dup = retrieve_req->dup();
-		choose_tries = 0;
-		while(choose_tries < 2*group_size)
+		cancelAndDelete(entry.hedgeTimer);
+		entry.hedgeTimer = NULL;
+	}
+
+	if (sendGroupRetrieve(entry.hedgeRequest, entry))
+	{
+		entry.hedgePeer = entry.timeouts.back()->getPeerData().getAddress();
+		RECORD_STATS(numGetHedged++);
+	}
+
+	delete(entry.hedgeRequest);
+	entry.hedgeRequest = NULL;
+}
+
+void GroupStorage::clearHedge(PendingRequestsEntry &entry)
+{
+	if (entry.hedgeTimer != NULL)
+	{
+		cancelAndDelete(entry.hedgeTimer);
+		entry.hedgeTimer = NULL;
+	}
+
+	if (entry.hedgeRequest != NULL)
+	{
+		delete(entry.hedgeRequest);
+		entry.hedgeRequest = NULL;
+	}
+}
+
+bool GroupStorage::handleHedgedResponse(PendingRequests::iterator it, ResponsePkt *response)
+{
+	PendingRequestsEntry &entry = it->second;
+
+	if (response->getIsSuccess())
+	{
+		RECORD_STATS(numGetSuccess++);
+
+		if (response->getSourceAddress() == entry.hedgePeer)
+			RECORD_STATS(numGetHedgeWon++);
+
+		//The first successful response wins. The requests still outstanding are abandoned and their responses will be dropped.
+		for (unsigned int i = 0 ; i < entry.timeouts.size() ; i++)
+			cancelAndDelete(entry.timeouts[i]);
+		entry.timeouts.clear();
+
+		clearHedge(entry);
+		pendingRequests.erase(it);
+
+		return true;
+	}
+
+	//If the hedge has not been sent yet, there is no reason to wait for it any longer
+	sendHedge(it);
+
+	if (!entry.timeouts.empty())
+		return false;
+
+	//All requests failed, so a single failure is reported
+	RECORD_STATS(numGetError++);
+	pendingRequests.erase(it);
+
+	return true;
+}
+
+void GroupStorage::handleHashRequest(OverlayKeyPkt *hash_req)
+{
+	HashPkt *hash = new HashPkt("hash");
+	hash->setPayloadType(HASH);
+	hash->setResponseType(GROUP_GET);
+	hash->setRpcid(hash_req->getValue());
+	hash->setTimestamp(hash_req->getTimestamp());
+	hash->setGroupAddress(super_peer_address);
+	hash->setIsCorrupted(isMalicious);
+	hash->setSourceAddress(hash_req->getRoutedVia());
+	hash->setDestinationAddress(hash_req->getSourceAddress());
+	hash->setByteLength(HASH_PKT_SIZE);
+
+	StorageMap::iterator storage_it = storage_map.find(hash_req->getKey());
+
+	if (hash_req->getGroupAddress() != super_peer_address)
+	{
+		hash->setIsSuccess(false);
+		RECORD_STATS(getErrRequestOOG++);
+	}
+	else if (storage_it == storage_map.end())
+	{
+		hash->setIsSuccess(false);
+		RECORD_STATS(getErrMissingObjectOtherPeer++);
+	} else {
+		GameObject object(storage_it->second);
+
+		//A malicious node returns the hash of a corrupted object, as it would return a corrupted object (see createResponseMsg)
+		if (isMalicious)
+			object.setValue(intuniform(0, 100000));
+
+		hash->setContentHash(object.getContentHash());
+		hash->setIsSuccess(true);
+	}
+
+	RECORD_STATS(numSent++);
+	send(hash, "comms_gate$o");
+}
+
+void GroupStorage::handleVotedResponse(PendingRequests::iterator it, ResponsePkt *response, PeerData peer_data)
+{
+	PendingRequestsEntry &entry = it->second;
+
+	if (response->getPayloadType() == HASH)
+	{
+		HashPkt *hash = check_and_cast<HashPkt *>(response);
+
+		if (!hash->getIsSuccess())
+			entry.numVotesFailed++;
+		else if (entry.votedHash.isUnspecified())
+			entry.votes[hash->getContentHash()].push_back(peer_data);
+		else {
+			//Once a majority has been reached, later holders that agree with it are kept in case the object cannot be fetched
+			if (hash->getContentHash() == entry.votedHash)
+				entry.votes[hash->getContentHash()].push_back(peer_data);
+
+			group_ledger->recordAgreement(peer_data, hash->getContentHash() == entry.votedHash);
+		}
+
+		if (entry.votedHash.isUnspecified())
+			countVotes(it);
+		return;
+	}
+
+	//The object fetched after the vote is only accepted if it is the object the majority agreed on
+	if (response->getIsSuccess())
+	{
+		GameObject *object = (GameObject *)response->getObject("GameObject");
+
+		if ((object != NULL) && (object->getContentHash() == entry.votedHash))
 		{
-			container_peer = group_ledger->getRandomPeer(retrieve_req->getKey());
-			chosen_peers_it = chosen_peers.find(container_peer.getAddress());
-			if (chosen_peers_it == chosen_peers.end())
+			RECORD_STATS(voteBytesSaved += (numGetRequests - 1) * object->getSize() - numGetRequests * (HASH_PKT_SIZE - RESPONSE_PKT_SIZE));
+			finishVote(it, true, *object);
+			return;
+		}
+
+		RECORD_STATS(numVoteBodiesRejected++);
+		group_ledger->recordAgreement(peer_data, false);
+	}
+
+	if (!fetchVotedObject(it))
+		finishVote(it, false);
+}
+
+void GroupStorage::countVotes(PendingRequests::iterator it)
+{
+	PendingRequestsEntry &entry = it->second;
+	std::map<OverlayKey, std::vector<PeerData> >::iterator votes_it;
+	unsigned int majority = numGetRequests/2 + 1;
+	int responses = entry.numVotesFailed;
+
+	for (votes_it = entry.votes.begin() ; votes_it != entry.votes.end() ; votes_it++)
+	{
+		if (votes_it->second.size() >= majority)
+		{
+			entry.votedHash = votes_it->first;
+
+			//Every holder that has voted so far either agreed or disagreed with the majority
+			for (std::map<OverlayKey, std::vector<PeerData> >::iterator voters_it = entry.votes.begin() ; voters_it != entry.votes.end() ; voters_it++)
 			{
-				chosen_peers.insert(container_peer.getAddress());
-				break;
+				for (unsigned int i = 0 ; i < voters_it->second.size() ; i++)
+					group_ledger->recordAgreement(voters_it->second[i], voters_it->first == entry.votedHash);
 			}
-			else choose_tries++;
+
+			if (!fetchVotedObject(it))
+				finishVote(it, false);
+			return;
 		}
-		if (choose_tries >= 2*group_size)
+
+		responses += votes_it->second.size();
+	}
+
+	//All holders responded without agreeing on the object
+	if (responses >= entry.numGetSent)
+		finishVote(it, false);
+}
+
+bool GroupStorage::fetchVotedObject(PendingRequests::iterator it)
+{
+	PendingRequestsEntry &entry = it->second;
+	std::vector<PeerData> &agreeing = entry.votes[entry.votedHash];
+
+	if (agreeing.empty())
+		return false;
+
+	PeerData holder = agreeing.back();
+	agreeing.pop_back();
+
+	OverlayKeyPkt *retrieve_dup = entry.retrieveRequest->dup();
+	retrieve_dup->setDestinationAddress(holder.getAddress());
+	retrieve_dup->setGroupAddress(super_peer_address);
+	retrieve_dup->setHops(entry.retrieveRequest->getHops()+1);
+	retrieve_dup->setRoutedVia(holder.getAddress());
+
+	send(retrieve_dup, "comms_gate$o");
+	RECORD_STATS(numSent++; numGetSent++);
+
+	entry.bodyPeer = holder.getAddress();
+	entry.timeouts.push_back(scheduleRequestTimeout(it->first, holder));
+
+	return true;
+}
+
+void GroupStorage::finishVote(PendingRequests::iterator it, bool isSuccess, const GameObject& object)
+{
+	PendingRequestsEntry &entry = it->second;
+
+	//Hash requests that are still outstanding are abandoned, and their responses will be dropped
+	for (unsigned int i = 0 ; i < entry.timeouts.size() ; i++)
+		cancelAndDelete(entry.timeouts[i]);
+	entry.timeouts.clear();
+
+	sendUpperResponse(GROUP_GET, entry.request_time, it->first, isSuccess, object);
+
+	if (isSuccess)
+	{
+		RECORD_STATS(numGetSuccess++);
+	} else {
+		RECORD_STATS(numGetError++);
+	}
+
+	delete(entry.retrieveRequest);
+	entry.retrieveRequest = NULL;
+
+	pendingRequests.erase(it);
+}
+
+void GroupStorage::encodeObject(const GameObject &object, std::vector<GameObject> &fragments)
+{
+	unsigned int k = erasure_code.getDataFragments();
+	unsigned int n = k + erasure_code.getParityFragments();
+	uint32_t value = object.getValue();
+	uint64_t size = object.getSize();
+
+	//The coded data is the value followed by the size, little endian, padded to fill the data fragments
+	size_t length = (FRAGMENT_PAYLOAD_SIZE + k - 1) / k;
+	std::vector<std::vector<uint8_t> > coded(n, std::vector<uint8_t>(length, 0));
+	std::vector<const uint8_t *> data;
+	std::vector<uint8_t *> parity;
+
+	for (unsigned int i = 0 ; i < FRAGMENT_PAYLOAD_SIZE ; i++)
+	{
+		uint8_t byte = (i < 4) ? (uint8_t)(value >> (8*i)) : (uint8_t)(size >> (8*(i-4)));
+		coded[i / length][i % length] = byte;
+	}
+
+	for (unsigned int i = 0 ; i < n ; i++)
+	{
+		if (i < k)
+			data.push_back(&coded[i][0]);
+		else parity.push_back(&coded[i][0]);
+	}
+
+	erasure_code.encode(data, parity, length);
+
+	for (unsigned int i = 0 ; i < n ; i++)
+	{
+		GameObject fragment(object);
+
+		//Every fragment carries an equal share of the object's size
+		fragment.setSize((object.getSize() + k - 1) / k);
+		fragment.setFragment(i, coded[i], object.getContentHash());
+
+		fragments.push_back(fragment);
+	}
+}
+
+bool GroupStorage::decodeObject(const std::vector<GameObject> &fragments, GameObject &object)
+{
+	unsigned int k = erasure_code.getDataFragments();
+	std::vector<unsigned int> indices;
+	std::vector<const uint8_t *> available;
+	uint32_t value = 0;
+	uint64_t size = 0;
+	unsigned int first = 0;
+	unsigned int votes = 0;
+
+	if (fragments.size() < k)
+		return false;
+
+	//The whole object hash claimed by most fragments is the one the decoded object has to match
+	for (unsigned int i = 0 ; i < fragments.size() ; i++)
+	{
+		unsigned int count = 0;
+
+		for (unsigned int j = 0 ; j < fragments.size() ; j++)
+		{
+			if (fragments[j].getObjectHash() == fragments[i].getObjectHash())
+				count++;
+		}
+
+		if (count > votes)
 		{
-			delete(retrieve_dup);
+			first = i;
+			votes = count;
+		}
+	}
+
+	const OverlayKey &object_hash = fragments[first].getObjectHash();
+	size_t length = fragments[first].getFragmentData().size();
+
+	//Fragments of a different length or object hash cannot belong to the same object
+	for (unsigned int i = 0 ; i < fragments.size() ; i++)
+	{
+		if (fragments[i].getObjectHash() != object_hash)
 			continue;
+
+		if (fragments[i].getFragmentData().size() != length || length * k < FRAGMENT_PAYLOAD_SIZE)
+			return false;
+
+		indices.push_back(fragments[i].getFragmentIndex());
+		available.push_back(&(fragments[i].getFragmentData()[0]));
+	}
+
+	std::vector<std::vector<uint8_t> > decoded(k, std::vector<uint8_t>(length));
+	std::vector<uint8_t *> data;
+
+	for (unsigned int i = 0 ; i < k ; i++)
+		data.push_back(&decoded[i][0]);
+
+	if (!erasure_code.decode(indices, available, data, length))
+		return false;
+
+	for (unsigned int i = 0 ; i < FRAGMENT_PAYLOAD_SIZE ; i++)
+	{
+		uint8_t byte = decoded[i / length][i % length];
+
+		if (i < 4)
+			value |= ((uint32_t)byte) << (8*i);
+		else size |= ((uint64_t)byte) << (8*(i-4));
+	}
+
+	object = fragments[first];
+	object.clearFragment();
+	object.setValue(value);
+	object.setSize(size);
+
+	//A fragment that was corrupted, but still claims the right hash, decodes to a different object
+	if (object.getContentHash() != object_hash)
+	{
+		EV << "[GroupStorage] Discarding decoded object " << object.getObjectName() << ", which does not match its content hash\n";
+		RECORD_STATS(numDecodeCorrupt++);
+		return false;
+	}
+
+	return true;
+}
+
+bool GroupStorage::requestMissingFragments(PendingRequests::iterator it)
+{
+	PendingRequestsEntry &entry = it->second;
+
+	while (entry.fragments.size() + entry.timeouts.size() < dataFragments)
+	{
+		if (!sendGroupRetrieve(entry.retrieveRequest, entry))
+			return false;
+	}
+
+	return true;
+}
+
+void GroupStorage::handleFragmentResponse(PendingRequests::iterator it, ResponsePkt *response)
+{
+	PendingRequestsEntry &entry = it->second;
+
+	if (response->getIsSuccess())
+	{
+		GameObject *fragment = (GameObject *)response->getObject("GameObject");
+		bool isDuplicate = false;
+
+		for (unsigned int i = 0 ; fragment != NULL && i < entry.fragments.size() ; i++)
+		{
+			if (entry.fragments[i].getFragmentIndex() == fragment->getFragmentIndex())
+				isDuplicate = true;
 		}
 
-		//Send a retrieve request to the group peer storing the object
-		retrieve_dup->setDestinationAddress(container_peer.getAddress());
-		retrieve_dup->setGroupAddress(super_peer_address);
+		//A peer may hold a copy of a fragment that was already received, in which case another peer is asked
+		if (fragment != NULL && fragment->isFragment() && !isDuplicate)
+			entry.fragments.push_back(*fragment);
+	}
 
-		retrieve_dup->setHops(retrieve_req->getHops()+1);
+	if (entry.fragments.size() >= dataFragments || !requestMissingFragments(it))
+		finishFragmentRequest(it);
+}
 
-		send(retrieve_dup, "comms_gate$o");
-		entry.numGetSent++;
-		RECORD_STATS(numSent++; numGetSent++);
+void GroupStorage::finishFragmentRequest(PendingRequests::iterator it)
+{
+	PendingRequestsEntry &entry = it->second;
+	GameObject object;
+	bool isSuccess = false;
 
-		//Create and schedule request timeout timer
-		ResponseTimeoutEvent *timeout = new ResponseTimeoutEvent("timeout");
-		timeout->setRpcid(rpcid);
-		timeout->setPeerData(container_peer);
-		scheduleAt(simTime()+requestTimeout, timeout);
+	if (entry.fragments.size() >= dataFragments)
+	{
+		isSuccess = decodeObject(entry.fragments, object);
 
-		//Insert timer into list of pending requests
-		entry.timeouts.push_back(timeout);
+		if (isSuccess)
+			RECORD_STATS(numObjectsDecoded++);
+		else RECORD_STATS(numDecodeErrors++);
 	}
 
-	pendingRequests.insert(std::make_pair(rpcid, entry));
-	delete(retrieve_req);
+	if (isSuccess)
+	{
+		RECORD_STATS(numGetSuccess++);
+		sendUpperResponse(GROUP_GET, entry.request_time, it->first, true, object);
+	} else {
+		RECORD_STATS(numGetError++);
+		sendUpperResponse(GROUP_GET, entry.request_time, it->first, false);
+	}
+
+	//The requests still outstanding are abandoned and their responses will be dropped
+	for (unsigned int i = 0 ; i < entry.timeouts.size() ; i++)
+		cancelAndDelete(entry.timeouts[i]);
+	entry.timeouts.clear();
+
+	delete(entry.retrieveRequest);
+	entry.retrieveRequest = NULL;
+
+	pendingRequests.erase(it);
 }
 
 bool GroupStorage::handleMissingObject(OverlayKeyPkt *retrieve_req)
@@ -329,7 +1061,7 @@ bool GroupStorage::handleMissingObject(OverlayKeyPkt *retrieve_req)
 		} else {
 			//If the object is not stored in the group, send a failure response to the higher layer
 			//This situation shouldn't really occur. Make sure there are no packets dropped by the underlay, since it can cause this situation.
-			sendUDPResponse(retrieve_req->getDestinationAddress(), retrieve_req->getSourceAddress(), GROUP_GET, retrieve_req->getTimestamp(), rpcid, false);
+			sendUDPResponse(retrieve_req->getRoutedVia(), retrieve_req->getSourceAddress(), GROUP_GET, retrieve_req->getTimestamp(), rpcid, false);
 			RECORD_STATS(getErrMissingObjectOtherPeer++);
 			delete(retrieve_req);
 			return true;
@@ -346,7 +1078,12 @@ bool GroupStorage::retrieveLocally(OverlayKeyPkt *retrieve_req)
 	if (storage_map_it != storage_map.end())
 	{
 		//If the object is stored in the group, check whether the object is on the same peer that sent the request
-		if (retrieve_req->getSourceAddress() == retrieve_req->getDestinationAddress())
+		//A fragment stored on this peer does not suffice for the higher layer, so other fragments are requested (see forwardRequest)
+		if (erasureCoding && retrieve_req->getSourceAddress() == retrieve_req->getDestinationAddress())
+		{
+			return false;
+		}
+		else if (retrieve_req->getSourceAddress() == retrieve_req->getDestinationAddress())
 		{
 			//If the source and destination addresses are the same it means the request comes from the higher layer and not another peer
 			//The object is therefore on the requesting peer itself and we can just reply with the object to the higher layer directly
@@ -357,7 +1094,11 @@ bool GroupStorage::retrieveLocally(OverlayKeyPkt *retrieve_req)
 			return true;
 		} else {
 			//If the object is stored on this peer, but another peer sent the request, send a UDP response with the object
-			sendUDPResponse(retrieve_req->getDestinationAddress(), retrieve_req->getSourceAddress(), GROUP_GET, retrieve_req->getTimestamp(), rpcid, true, storage_map_it->second);
+			if (partialGroup)
+				RECORD_STATS(globalStatistics->addStdDev("GroupStorage: GET hops", retrieve_req->getHops()));
+
+			//The response carries the address of the first hop, since the requester matches responses against the peers it sent requests to
+			sendUDPResponse(retrieve_req->getRoutedVia(), retrieve_req->getSourceAddress(), GROUP_GET, retrieve_req->getTimestamp(), rpcid, true, storage_map_it->second);
 			delete(retrieve_req);
 			return true;
 		}
@@ -388,21 +1129,111 @@ void GroupStorage::requestRetrieve(OverlayKeyPkt *retrieve_req)
 	{
 		if (retrieve_req->getGroupAddress() != super_peer_address)
 		{
-			sendUDPResponse(retrieve_req->getDestinationAddress(), retrieve_req->getSourceAddress(), GROUP_GET, retrieve_req->getTimestamp(), rpcid, false);
+			sendUDPResponse(retrieve_req->getRoutedVia(), retrieve_req->getSourceAddress(), GROUP_GET, retrieve_req->getTimestamp(), rpcid, false);
 			RECORD_STATS(getErrRequestOOG++);
 			delete(retrieve_req);
 			return;
 		}
 	}
 
-	isSuccess = handleMissingObject(retrieve_req);
-	if (isSuccess) return;
+	//In a partially connected group, the object may be stored on a peer this peer does not know of, so the request is routed further
+	if (partialGroup && retrieve_req->getHops() > 0)
+	{
+		routeRequest(retrieve_req);
+		return;
+	}
+
+	//A peer in a partially connected group that has not heard of the object can still route the request through its view
+	if (!partialGroup || view.empty())
+	{
+		isSuccess = handleMissingObject(retrieve_req);
+		if (isSuccess) return;
+	}
 
 	forwardRequest(retrieve_req);
 }
 
+void GroupStorage::routeRequest(OverlayKeyPkt *retrieve_req)
+{
+	OverlayKey key = retrieve_req->getKey();
+	PeerData next_peer;
+
+	if (retrieve_req->getHops() < maxHops)
+	{
+		if (group_ledger->isObjectInGroup(key))
+			next_peer = group_ledger->getRandomPeer(key);
+
+		//This peer may still be listed as storing an object that has expired
+		if (next_peer.getAddress().isUnspecified() || (next_peer.getAddress() == this_address))
+			next_peer = view.getRandomPeer(retrieve_req->getSourceAddress());
+	}
+
+	if (next_peer.getAddress().isUnspecified() || (next_peer.getAddress() == this_address))
+	{
+		sendUDPResponse(retrieve_req->getRoutedVia(), retrieve_req->getSourceAddress(), GROUP_GET, retrieve_req->getTimestamp(), retrieve_req->getValue(), false);
+		RECORD_STATS(getErrMaxHops++);
+		delete(retrieve_req);
+		return;
+	}
+
+	//The source address and first hop are left unchanged, so that the peer storing the object can respond to the requester directly
+	retrieve_req->setDestinationAddress(next_peer.getAddress());
+	retrieve_req->setHops(retrieve_req->getHops()+1);
+
+	send(retrieve_req, "comms_gate$o");
+	RECORD_STATS(numSent++);
+}
+
 void GroupStorage::updatePeerObjects(const GameObject& go)
 {
+	//In a partially connected group, only the super peer is informed directly and the group learns of the object by gossip
+	if (partialGroup)
+	{
+		if (super_peer_address.isUnspecified())
+		{
+			//TODO: This error condition should be logged
+			EV << "No super peer has been identified. The group object will not be stored on this peer\n";
+			return;
+		}
+
+		ObjectData object_data(go, group_ledger->getGroupSize());
+
+		group_ledger->addObject(object_data, PeerData(this_address));
+		addObjectRumor(object_data, PeerData(this_address));
+
+		PeerListPkt *objectAddPkt = new PeerListPkt("object_add");
+		objectAddPkt->setObjectData(object_data);
+		objectAddPkt->setPayloadType(SP_OBJECT_ADD);
+		objectAddPkt->setSourceAddress(this_address);
+		objectAddPkt->setDestinationAddress(super_peer_address);
+		objectAddPkt->setGroupAddress(super_peer_address);
+		objectAddPkt->addToPeerList(PeerData(this_address));
+		objectAddPkt->setByteLength(PEERLIST_PKT_SIZE(PEERDATA_SIZE));
+
+		send(objectAddPkt, "comms_gate$o");
+		return;
+	}
+
+	//Coalesce the notification with others, if batching is enabled
+	if (objectAddWindow > 0 || objectAddBatchSize > 1)
+	{
+		if (super_peer_address.isUnspecified())
+		{
+			//TODO: This error condition should be logged
+			EV << "No super peer has been identified. The group object will not be stored on this peer\n";
+			return;
+		}
+
+		pendingObjectAdds.push_back(ObjectData(go, group_ledger->getGroupSize()));
+
+		if (objectAddBatchSize > 0 && pendingObjectAdds.size() >= objectAddBatchSize)
+			sendObjectAddBatch();
+		else if (!objectAddTimer->isScheduled())
+			scheduleAt(simTime() + objectAddWindow, objectAddTimer);
+
+		return;
+	}
+
 	PeerListPkt *objectAddPkt = new PeerListPkt();
 	objectAddPkt->setByteLength(PEERLIST_PKT_SIZE(PEERDATA_SIZE));
 
@@ -437,30 +1268,74 @@ void GroupStorage::updatePeerObjects(const GameObject& go)
 	send(objectAddPkt, "comms_gate$o");		//Set address
 }
 
-PeerData GroupStorage::selectDestination(std::vector<TransportAddress> send_list)
+void GroupStorage::sendObjectAddBatch()
 {
-	unsigned int j;
-	bool original_address = false;
-	PeerData peerData;
+	unsigned int batch_size = pendingObjectAdds.size();
 
-	while(!original_address)
-	{
-		peerData = group_ledger->getRandomPeer();		//Choose a uniform random peer in the group for the destination
+	if (objectAddTimer->isScheduled())
+		cancelEvent(objectAddTimer);
 
-		//Check all previous chosen addresses to determine whether this address is unique
-		original_address = true;
+	if (batch_size == 0)
+		return;
 
-		for (j = 0 ; j < send_list.size() ; j++)
-		{
-			if (send_list.at(j) == peerData.getAddress())
-			{
-				original_address = false;
-				break;
-			}
-		}
+	ObjectListPkt *batch_p = new ObjectListPkt("object_add_batch");
+	batch_p->setPayloadType(OBJECT_ADD_BATCH);
+	batch_p->setSourceAddress(this_address);
+	batch_p->setGroupAddress(super_peer_address);
+	batch_p->setPeerData(PeerData(this_address));
+	batch_p->setObjectDataArraySize(batch_size);
+
+	for (unsigned int i = 0 ; i < batch_size ; i++)
+		batch_p->setObjectData(i, pendingObjectAdds[i]);
+
+	batch_p->setByteLength(OBJECTLIST_PKT_SIZE(batch_size));
+
+	pendingObjectAdds.clear();
+
+	//Inform all group peers about the new objects and where they are stored
+	for (unsigned int i = 0 ; i < group_ledger->getGroupSize() ; i++)
+	{
+		batch_p->setDestinationAddress((*(group_ledger->getPeerPtr(i))).getAddress());
+		send(batch_p->dup(), "comms_gate$o");
 	}
 
-	return peerData;
+	//The group peers and the super peer would otherwise each have received one PeerListPkt per object
+	unsigned int destinations = group_ledger->getGroupSize() + 1;
+	long unbatched_bytes = (long)destinations * batch_size * (PEERLIST_PKT_SIZE(PEERDATA_SIZE));
+
+	RECORD_STATS(numObjectAddBatches++);
+	RECORD_STATS(objectAddBytesSaved += unbatched_bytes - (long)destinations * batch_p->getByteLength());
+	RECORD_STATS(globalStatistics->recordOutVector("GroupStorage: OBJECT_ADD batch size", batch_size));
+
+	//The super peer object type must be different to the group object type for communicator routing purposes
+	batch_p->setPayloadType(SP_OBJECT_ADD_BATCH);
+	batch_p->setDestinationAddress(super_peer_address);
+	send(batch_p, "comms_gate$o");
+}
+
+void GroupStorage::addObjectBatch(ObjectListPkt *list_p)
+{
+	//If a packet was received from another group, ignore it.
+	if (list_p->getGroupAddress() != super_peer_address)
+		return;
+
+	if (group_ledger->getGroupSize() == 0)
+		informUpperOfJoin();
+
+	//Check whether this peer didn't just leave the group and this message is in fact a delayed out dated message
+	if (membership_log.hasLeft(list_p->getPeerData()))
+		return;
+
+	for (unsigned int i = 0 ; i < list_p->getObjectDataArraySize() ; i++)
+		group_ledger->addObject(list_p->getObjectData(i), list_p->getPeerData());
+}
+
+void GroupStorage::informUpperOfJoin()
+{
+	AddressPkt *request_start = new AddressPkt("request_start");
+	request_start->setAddress(super_peer_address);
+	request_start->setByteLength(ADDRESS_SIZE);	//The super peer IP
+	send(request_start, "to_upperTier");
 }
 
 void GroupStorage::createWritePkt(ValuePkt **write, simtime_t request_time, unsigned int rpcid)
@@ -518,12 +1393,10 @@ void GroupStorage::send_forstore(ValuePkt *store_req)
 	ValuePkt *write_dup;
 
 	unsigned int replicas;
-	std::vector<TransportAddress> send_list;
-	send_list.push_back(this_address);	//Add this peers address to the send list to ensure its never chosen for security reasons.
+	std::vector<PeerData> destinations;
+	std::vector<GameObject> fragments;
 
 	PendingRequestsEntry entry;
-	ResponseTimeoutEvent *timeout;
-	PeerData destAdr;
 
 	int rpcid = store_req->getValue();
 
@@ -531,6 +1404,16 @@ void GroupStorage::send_forstore(ValuePkt *store_req)
 	if (replicas == 0)
 		return;
 
+	//An object that is stored on fewer peers than it has data fragments cannot be reconstructed
+	if (erasureCoding && replicas < dataFragments)
+	{
+		for (i = 0 ; i < replicas ; i++)
+			sendUpperResponse(GROUP_PUT, store_req->getTimestamp(), rpcid, false);
+
+		RECORD_STATS(numPutError++);
+		return;
+	}
+
 	createWritePkt(&write, store_req->getTimestamp(), rpcid);
 
 	GameObject *go = (GameObject *)store_req->removeObject("GameObject");
@@ -540,6 +1423,15 @@ void GroupStorage::send_forstore(ValuePkt *store_req)
 	//std::cout << "Inserting pending put request with rpcid: " << rpcid << endl;
 	//std::cout << simTime() << ": Inserting object (" << go->getObjectName() << ") with " << replicas << " replicas.\n";
 
+	//The data fragments are sent first, so that the object can be reconstructed even if the group is too small for all parity fragments
+	if (erasureCoding)
+		encodeObject(*go, fragments);
+
+	//Choose distinct group peers to store the replicas. This peer is never chosen for security reasons.
+	group_ledger->getStoragePeers(replicas, this_address, placementLoad, destinations);
+	if (destinations.size() < replicas)
+		error("[GroupStorage]: Too few group peers to store all replicas.");
+
 	//Add a new request for which at least one response is required
 	entry.numPutSent = replicas;
 	entry.responseType = GROUP_PUT;
@@ -548,25 +1440,30 @@ void GroupStorage::send_forstore(ValuePkt *store_req)
 	for (i = 0 ; i < replicas ; i++)
 	{
 		//Duplicates the objects for sending
-		go_dup = go->dup();
+		if (erasureCoding)
+			go_dup = fragments[i].dup();
+		else go_dup = go->dup();
 		write_dup = write->dup();
 
 		write_dup->addObject(go_dup);
+		write_dup->setByteLength(VALUE_PKT_SIZE + go_dup->getSize());	//Packet + object size
+
+		//A peer that already stores the payload only needs the object's metadata. The object is kept in case the peer has since dropped the payload.
+		if (deduplication && (go_dup->getSize() > OBJECTDATA_SIZE + PAYLOADHASH_SIZE) && group_ledger->isContentOnPeer(go_dup->getPayloadHash(), destinations[i]))
+		{
+			write_dup->setPayloadType(WRITE_REF);
+			write_dup->setByteLength(VALUE_PKT_SIZE + OBJECTDATA_SIZE + PAYLOADHASH_SIZE);	//Packet + object metadata + payload hash
+			entry.refObjects.insert(std::make_pair(destinations[i].getAddress(), *go_dup));
 
-		destAdr = selectDestination(send_list);
-		write_dup->setDestinationAddress(destAdr.getAddress());
+			RECORD_STATS(numPutsDeduplicated++; dedupBytesSaved += go_dup->getSize() - (OBJECTDATA_SIZE + PAYLOADHASH_SIZE));
+		}
 
-		send_list.push_back(destAdr.getAddress());
+		write_dup->setDestinationAddress(destinations[i].getAddress());
 
 		RECORD_STATS(numSent++; numPutSent++);
-		send(write_dup, "comms_gate$o");
-
-		timeout = new ResponseTimeoutEvent("timeout");
-		timeout->setRpcid(rpcid);
-		timeout->setPeerData(destAdr);
-		scheduleAt(simTime()+requestTimeout, timeout);
+		sendToPeer(write_dup);
 
-		entry.timeouts.push_back(timeout);
+		entry.timeouts.push_back(scheduleRequestTimeout(rpcid, destinations[i]));
 	}
 
 	pendingRequests.insert(std::make_pair(rpcid, entry));
@@ -575,6 +1472,166 @@ void GroupStorage::send_forstore(ValuePkt *store_req)
 	delete(write);
 }
 
+void GroupStorage::sendUpdate(UpdatePkt *modify_req)
+{
+	std::vector<PeerData> holders;
+	UpdatePkt *update;
+	PendingRequestsEntry entry;
+	unsigned int rpcid = modify_req->getValue();
+
+	GameObject *go = (GameObject *)modify_req->getObject("GameObject");
+	if (go == NULL)
+		error("No object was attached to be updated in group storage");
+
+	//Every parity fragment depends on the whole object, so erasure coded objects cannot be updated in place
+	if (erasureCoding)
+	{
+		sendUpperResponse(GROUP_MOD, modify_req->getTimestamp(), rpcid, false);
+		RECORD_STATS(numModError++);
+		return;
+	}
+
+	//Only the changed bytes are sent, unless the whole object changed
+	int64_t deltaSize = std::min((int64_t)modify_req->getDeltaSize(), go->getSize());
+	if (deltaSize < 0)
+		error("[GroupStorage]: The size of an update should not be negative.");
+
+	//A replica stored on this peer is updated directly
+	StorageMap::iterator storage_it = storage_map.find(go->getNameHash());
+	if (storage_it != storage_map.end())
+		applyUpdate(storage_it, *go);
+
+	group_ledger->getObjectHolders(go->getNameHash(), holders);
+
+	entry.responseType = GROUP_MOD;
+	entry.request_time = modify_req->getTimestamp();
+
+	for (unsigned int i = 0 ; i < holders.size() ; i++)
+	{
+		if (holders[i].getAddress() == this_address)
+			continue;
+
+		update = new UpdatePkt("update");
+		update->setPayloadType(UPDATE);
+		update->setValue(rpcid);
+		update->setTimestamp(modify_req->getTimestamp());
+		update->setSourceAddress(this_address);
+		update->setGroupAddress(super_peer_address);
+		update->setDestinationAddress(holders[i].getAddress());
+		update->setDeltaSize(deltaSize);
+		update->addObject(go->dup());		//The object is attached to carry the update in the simulation, but only the delta is sent
+		update->setByteLength(UPDATE_PKT_SIZE + deltaSize);		//Packet + changed bytes
+
+		RECORD_STATS(numSent++; numModSent++; updateBytesSaved += go->getSize() - deltaSize);
+		send(update, "comms_gate$o");
+
+		entry.timeouts.push_back(scheduleRequestTimeout(rpcid, holders[i]));
+		entry.numModSent++;
+	}
+
+	//If no other peer stores the object, the update only succeeded if this peer stores it
+	if (entry.numModSent == 0)
+	{
+		bool isSuccess = (storage_it != storage_map.end());
+
+		sendUpperResponse(GROUP_MOD, modify_req->getTimestamp(), rpcid, isSuccess);
+		if (isSuccess)
+		{
+			RECORD_STATS(numModSuccess++);
+		} else {
+			RECORD_STATS(numModError++);
+		}
+		return;
+	}
+
+	pendingRequests.insert(std::make_pair(rpcid, entry));
+}
+
+bool GroupStorage::applyUpdate(StorageMap::iterator storage_it, const GameObject &update)
+{
+	GameObject &stored = storage_it->second;
+
+	if (update.getVersion() < stored.getVersion())
+		return false;
+
+	if (update.getVersion() == stored.getVersion())
+	{
+		//The same update may arrive more than once
+		if (update.getPayloadHash() == stored.getPayloadHash())
+			return true;
+
+		if (update.getPayloadHash() < stored.getPayloadHash())
+			return false;
+	}
+
+	//The creation time and TTL of the stored object are kept, since its expiry has already been scheduled
+	totals.remove(stored);
+	content_store.release(stored.getPayloadHash());
+
+	stored.setValue(update.getValue());
+	stored.setSize(update.getSize());
+	stored.setVersion(update.getVersion());
+
+	totals.add(stored);
+	content_store.addRef(stored.getPayloadHash(), stored.getSize());
+	emitStorageTotals();
+
+	//The ledgers of the group and the super peer still record the old size and payload hash of the replica, so the
+	//update is announced in the same way as a newly stored object
+	updatePeerObjects(stored);
+
+	return true;
+}
+
+void GroupStorage::handleUpdate(UpdatePkt *update)
+{
+	bool isSuccess = false;
+
+	//The peer may have changed groups since it was informed of the object
+	if (update->getGroupAddress() == super_peer_address)
+	{
+		GameObject *go = (GameObject *)update->getObject("GameObject");
+		if (go == NULL)
+			error("[GroupStorage::handleUpdate]: Storage received an update with no game object attached");
+
+		StorageMap::iterator storage_it = storage_map.find(go->getNameHash());
+
+		if (storage_it != storage_map.end())
+		{
+			isSuccess = applyUpdate(storage_it, *go);
+
+			if (!isSuccess)
+				RECORD_STATS(numModStale++);
+		}
+	}
+
+	sendUDPResponse(update->getDestinationAddress(), update->getSourceAddress(), GROUP_MOD, update->getTimestamp(), update->getValue(), isSuccess);
+}
+
+void GroupStorage::handleUpdateResponse(PendingRequests::iterator it, bool isSuccess)
+{
+	if (isSuccess)
+		it->second.numGroupModSucceeded++;
+	else it->second.numGroupModFailed++;
+
+	if (it->second.numGroupModSucceeded + it->second.numGroupModFailed < it->second.numModSent)
+		return;
+
+	//As with a safe put, at least as many replicas should have been updated as not
+	isSuccess = (it->second.numGroupModSucceeded > 0) && (it->second.numGroupModSucceeded >= it->second.numGroupModFailed);
+
+	sendUpperResponse(GROUP_MOD, it->second.request_time, it->first, isSuccess);
+
+	if (isSuccess)
+	{
+		RECORD_STATS(numModSuccess++);
+	} else {
+		RECORD_STATS(numModError++);
+	}
+
+	pendingRequests.erase(it);
+}
+
 void GroupStorage::handleResponse(PendingRequests::iterator it, ResponsePkt *response)
 {
 	if (response->getResponseType() == GROUP_PUT)
@@ -619,7 +1676,68 @@ void GroupStorage::handleResponse(PendingRequests::iterator it, ResponsePkt *res
 	} else error("Unknown response type received");
 }
 
-PeerData GroupStorage::cancelRequestTimer(PendingRequests::iterator it, TransportAddress source_address)
+simtime_t GroupStorage::getRequestTimeout(PeerData peer_data)
+{
+	if (!adaptiveTimeouts)
+		return requestTimeout;
+
+	RttEstimator *rtt = group_ledger->getRttEstimator(peer_data);
+
+	//Peers that are not in the ledger have not been measured
+	if (rtt == NULL)
+		return requestTimeout;
+
+	simtime_t timeout = rtt->getRto(SIMTIME_DBL(minRequestTimeout), SIMTIME_DBL(requestTimeout));
+	RECORD_STATS(globalStatistics->addStdDev("GroupStorage: Adaptive request timeout", SIMTIME_DBL(timeout)));
+
+	return timeout;
+}
+
+ResponseTimeoutEvent *GroupStorage::scheduleRequestTimeout(int rpcid, PeerData peer_data)
+{
+	ResponseTimeoutEvent *timeout = new ResponseTimeoutEvent("timeout");
+	timeout->setRpcid(rpcid);
+	timeout->setPeerData(peer_data);
+	scheduleAt(simTime()+getRequestTimeout(peer_data), timeout);
+
+	return timeout;
+}
+
+bool GroupStorage::resendContent(PendingRequests::iterator it, ResponsePkt *response, PeerData peer_data)
+{
+	std::map<TransportAddress, GameObject>::iterator ref_it = it->second.refObjects.find(response->getSourceAddress());
+
+	if (ref_it == it->second.refObjects.end())
+		return false;
+
+	ValuePkt *write;
+	createWritePkt(&write, it->second.request_time, it->first);
+
+	write->addObject(ref_it->second.dup());
+	write->setByteLength(VALUE_PKT_SIZE + ref_it->second.getSize());	//Packet + object size
+	write->setDestinationAddress(peer_data.getAddress());
+
+	RECORD_STATS(numSent++; numPutSent++; numContentMissing++);
+	send(write, "comms_gate$o");
+
+	it->second.timeouts.push_back(scheduleRequestTimeout(it->first, peer_data));
+	it->second.refObjects.erase(ref_it);
+
+	return true;
+}
+
+bool GroupStorage::isAwaitingResponse(PendingRequests::iterator it, TransportAddress source_address)
+{
+	for (unsigned int i = 0 ; i < it->second.timeouts.size() ; i++)
+	{
+		if (it->second.timeouts[i]->getPeerData().getAddress() == source_address)
+			return true;
+	}
+
+	return false;
+}
+
+PeerData GroupStorage::cancelRequestTimer(PendingRequests::iterator it, TransportAddress source_address, simtime_t *send_time)
 {
 	bool found = false;
 	ResponseTimeoutEvent * timeout;
@@ -645,6 +1763,10 @@ PeerData GroupStorage::cancelRequestTimer(PendingRequests::iterator it, Transpor
 		//timeout_it is an iterator to a pointer, so it has to be dereferenced once to get to the ResponseTimeoutEvent pointer
 		if (peerData.getAddress() == source_address)
 		{
+			//The timeout was scheduled when the request was sent
+			if (send_time != NULL)
+				*send_time = timeout->getSendingTime();
+
 			cancelAndDelete(timeout);
 			it->second.timeouts.erase(timeout_it);
 			found = true;
@@ -655,6 +1777,10 @@ PeerData GroupStorage::cancelRequestTimer(PendingRequests::iterator it, Transpor
 	if (!found)
 		error("No timeout found for response message from peer.");
 
+	//The first hop responded, so its earlier timeouts were caused by later hops
+	if (partialGroup)
+		hopTimeouts.erase(source_address);
+
 	return peerData;
 }
 
@@ -662,6 +1788,12 @@ void GroupStorage::respond_toUpper(cMessage *msg)
 {
 	ResponsePkt *response = check_and_cast<ResponsePkt *>(msg);
 	PeerData peerData;
+	simtime_t send_time;
+	bool isHedged = hedgedGets && (response->getResponseType() == GROUP_GET);
+	bool isFragmented = erasureCoding && (response->getResponseType() == GROUP_GET);
+	bool isUpdate = (response->getResponseType() == GROUP_MOD);
+	bool isVoted = hashVoting && (response->getResponseType() == GROUP_GET);
+	bool forward = true;
 
 	if (response->getResponseType() == GROUP_GET)
 		RECORD_STATS(numGetReponses++);
@@ -670,9 +1802,30 @@ void GroupStorage::respond_toUpper(cMessage *msg)
 
 	PendingRequests::iterator it = pendingRequests.find(response->getRpcid());
 
+	//Hedged, erasure coded, hash voted and update requests are reported to the higher layer only once, so responses to abandoned requests are dropped
+	if ((isHedged || isFragmented || isUpdate || isVoted) && (it == pendingRequests.end()))
+	{
+		delete(msg);
+		return;
+	}
+
+	//A request that timed out has already been reported as failed, so its late response is dropped
+	if ((it != pendingRequests.end()) && !isAwaitingResponse(it, response->getSourceAddress()))
+	{
+		RECORD_STATS(numLateResponses++);
+		delete(msg);
+		return;
+	}
+
 	if (it != pendingRequests.end()) // unknown request or request for already erased call
 	{
-		peerData = cancelRequestTimer(it, response->getSourceAddress());
+		peerData = cancelRequestTimer(it, response->getSourceAddress(), &send_time);
+
+		if (response->getResponseType() == GROUP_GET)
+			getLatencies.add(SIMTIME_DBL(simTime() - send_time));
+
+		//Every request is only sent once, so the round trip time of its response is unambiguous
+		group_ledger->recordRtt(peerData, simTime() - send_time);
 
 		//TODO: If a response has been received for a request that has already timed out, that response should not be forwarded to the upper layer.
 
@@ -691,25 +1844,34 @@ void GroupStorage::respond_toUpper(cMessage *msg)
 
 		//TODO: Record the group put latency (This will merely require that the response packet be expanded with the initiation time of the request)
 
-		handleResponse(it, response);
-
-	}
-
-	send(msg, "read");
-}
-
-int GroupStorage::getStorageBytes()
-{
-	int total_size = 0;
-
-	StorageMap::iterator it;
+		if (isFragmented)
+		{
+			handleFragmentResponse(it, response);
+			forward = false;
+		}
+		else if (isUpdate)
+		{
+			handleUpdateResponse(it, response->getIsSuccess());
+			forward = false;
+		}
+		else if (isVoted)
+		{
+			handleVotedResponse(it, response, peerData);
+			forward = false;
+		}
+		//A peer in this group that could not store an object by reference no longer holds its payload, so the object is sent in full
+		else if ((response->getResponseType() == GROUP_PUT) && !response->getIsSuccess() && (response->getGroupAddress() == super_peer_address)
+				&& resendContent(it, response, peerData))
+			forward = false;
+		else if (isHedged)
+			forward = handleHedgedResponse(it, response);
+		else handleResponse(it, response);
 
-	for (it = storage_map.begin() ; it != storage_map.end() ; it++)
-	{
-		total_size += it->second.getSize();
 	}
 
-	return total_size;
+	if (forward)
+		send(msg, "read");
+	else delete(msg);
 }
 
 void GroupStorage::store(Packet *pkt)
@@ -719,7 +1881,7 @@ void GroupStorage::store(Packet *pkt)
 	//This happens when a group peer changes groups, after being selected to store a file
 	if (pkt->getGroupAddress() != super_peer_address)
 	{
-		if (pkt->getPayloadType() == WRITE)
+		if ((pkt->getPayloadType() == WRITE) || (pkt->getPayloadType() == WRITE_REF))
 		{
 			//We can also receive a replicate packet, which does not expect a response
 			ValuePkt *value_pkt = check_and_cast<ValuePkt *>(pkt);
@@ -740,22 +1902,42 @@ void GroupStorage::store(Packet *pkt)
 	if (simTime() > (go->getCreationTime() + go->getTTL()))
 		return;
 
+	//An object sent by reference can only be stored if its payload is still held by this peer
+	if ((pkt->getPayloadType() == WRITE_REF) && !content_store.contains(go->getPayloadHash()))
+	{
+		ValuePkt *value_pkt = check_and_cast<ValuePkt *>(pkt);
+		sendUDPResponse(value_pkt->getDestinationAddress(), value_pkt->getSourceAddress(), GROUP_PUT, value_pkt->getTimestamp(), value_pkt->getValue(), false);
+		return;
+	}
+
 	//std::cout << "[GroupStorageTarget] Stored object with key " << go->getHash() << endl;
 	EV << getName() << " " << getIndex() << " received Game Object of size " << go->getSize() << "\n";
 	EV << getName() << " " << getIndex() << " received write command of size " << go->getSize() << " with delay " << go->getCreationTime() << "\n";
 
 	ret = storage_map.insert(std::make_pair(go->getNameHash(), *go));
-	//Ensure that a duplicate key wasn't inserted
+
 	if (ret.second == false)
-		return;
-		//error("[GroupStorage::store]: Duplicate key inserted into storage.");
+	{
+		//A replica of an object that is already stored adds nothing
+		if (pkt->getPayloadType() == REPLICATE)
+			return;
+
+		//A new PUT of a stored key replaces the stored object. Its expiry is rescheduled below.
+		totals.remove(ret.first->second);
+		content_store.release(ret.first->second.getPayloadHash());
+		ret.first->second = *go;
+		RECORD_STATS(numStoreOverwrites++);
+	}
+
+	totals.add(ret.first->second);
+	content_store.addRef(go->getPayloadHash(), go->getSize());
+	emitStorageTotals();
 
 	//Schedule the object to be removed when its TTL expires.
-	ObjectTTLTimer* timer = new ObjectTTLTimer();
-	timer->setKey(go->getNameHash());
-	scheduleAt(go->getCreationTime() + go->getTTL(), timer);
+	expiry_wheel.schedule(go->getNameHash(), go->getCreationTime() + go->getTTL());
+	scheduleExpiryTimer();
 
-	if (pkt->getPayloadType() == WRITE)
+	if ((pkt->getPayloadType() == WRITE) || (pkt->getPayloadType() == WRITE_REF))
 	{
 		//We can also receive a replicate packet, which does not expect a response
 		ValuePkt *value_pkt = check_and_cast<ValuePkt *>(pkt);
@@ -765,6 +1947,13 @@ void GroupStorage::store(Packet *pkt)
 	updatePeerObjects(*go);
 }
 
+void GroupStorage::eraseStored(StorageMap::iterator storage_it)
+{
+	totals.remove(storage_it->second);
+	content_store.release(storage_it->second.getPayloadHash());
+	storage_map.erase(storage_it);
+}
+
 /**
  * According to Valgrind's Callgrind, this is one of the most expensive functions in Pithos.
  */
@@ -783,14 +1972,15 @@ void GroupStorage::addToGroup(cMessage *msg)
 	//This is also the time when we record that we've successfully joined a group (When we've joined a super peer and we know of other peers in the group).
 	if ((group_ledger->getGroupSize() == 0) && (list_p->getPeer_listArraySize() > 0))
 	{
-		AddressPkt *request_start = new AddressPkt("request_start");
-		request_start->setAddress(super_peer_address);
-		request_start->setByteLength(ADDRESS_SIZE);	//The super peer IP
-		send(request_start, "to_upperTier");
+		informUpperOfJoin();
 
 		//This is where the join time can be recorded.
 	}
 
+	//Membership deltas of the group start from the epoch in which this peer was accepted
+	if (list_p->getPayloadType() == JOIN_ACCEPT)
+		membership_log.setEpoch(list_p->getMembershipEpoch());
+
 	object_dat = list_p->getObjectData();
 
 	//std::cout << "Peer list array size: " << list_p->getPeer_listArraySize() << endl;
@@ -800,11 +1990,14 @@ void GroupStorage::addToGroup(cMessage *msg)
 		peer_dat = list_p->getPeer_list(i);
 
 		//Check whether this peer didn't just leave the group and this message is in fact a delayed out dated message
-		if ((lastPeerLeft.getAddress().isUnspecified()) || (peer_dat != lastPeerLeft))
+		if (!membership_log.hasLeft(peer_dat))
 		{
 			if ((list_p->getObjectData()).isUnspecified())
 			{
 				group_ledger->addPeer(peer_dat);
+
+				if (partialGroup)
+					addToView(peer_dat);
 				//std::cout << simTime() << ": " << this_address << " was informed of peer: " << peer_dat.getAddress() << endl;
 			}
 			else {
@@ -878,6 +2071,9 @@ void GroupStorage::replicateLocalObjects()
 
 void GroupStorage::leaveGroup()
 {
+	//The old group still has to be informed of the objects that were stored before leaving
+	sendObjectAddBatch();
+
 	group_ledger->removePeer(PeerData(this_address));
 	if (objectRepair && !periodicRepair && gracefulMigration)
 	{
@@ -890,7 +2086,11 @@ void GroupStorage::leaveGroup()
 
 	group_ledger->recordAndClear();
 
-	lastPeerLeft = PeerData();	//Sets the transport address to unspecified for the new group
+	membership_log.clear();	//The epochs of the new group are unrelated to those of the old group
+
+	view.clear();
+	rumors.clear();
+	hopTimeouts.clear();
 }
 
 void GroupStorage::addAndJoinSuperPeer(Packet *packet)
@@ -923,18 +2123,80 @@ void GroupStorage::addAndJoinSuperPeer(Packet *packet)
 	joinRequest(super_peer_address);
 }
 
-void GroupStorage::handleLeftPeer(PeerDataPkt *peer_data_pkt)
+void GroupStorage::handleMembershipDelta(MembershipDeltaPkt *delta_p)
 {
+	unsigned int epoch = membership_log.getEpoch();
+	unsigned int to_epoch = delta_p->getToEpoch();
+
 	//If a packet was received from another group, ignore it.
-	if (peer_data_pkt->getGroupAddress() != super_peer_address)
+	if (delta_p->getGroupAddress() != super_peer_address)
+		return;
+
+	//Deltas that arrive late or more than once contain no changes this peer doesn't know about
+	if (to_epoch <= epoch)
+		return;
+
+	//The changes between this peer's epoch and the start of the delta were missed
+	if (delta_p->getFromEpoch() > epoch)
 	{
+		requestMembershipSync();
 		return;
 	}
 
-	group_ledger->removePeer(peer_data_pkt->getPeerData());
+	//A snapshot lists the whole group, so any peer not in it has left
+	if (delta_p->getSnapshot())
+	{
+		std::set<TransportAddress> members;
+		std::vector<PeerData> departed;
+
+		for (unsigned int i = 0 ; i < delta_p->getJoinedArraySize() ; i++)
+			members.insert(delta_p->getJoined(i).getAddress());
+
+		for (unsigned int i = 0 ; i < group_ledger->getGroupSize() ; i++)
+		{
+			if (members.find(group_ledger->getPeerPtr(i)->getAddress()) == members.end())
+				departed.push_back(*(group_ledger->getPeerPtr(i)));
+		}
+
+		for (unsigned int i = 0 ; i < departed.size() ; i++)
+		{
+			group_ledger->removePeer(departed[i]);
+			membership_log.record(departed[i], false, to_epoch);
+		}
+	}
+
+	for (unsigned int i = 0 ; i < delta_p->getLeftArraySize() ; i++)
+	{
+		group_ledger->removePeer(delta_p->getLeft(i));
+
+		//Record that the peer left, in case we get an outdated object add message from that peer
+		membership_log.record(delta_p->getLeft(i), false, to_epoch);
+	}
+
+	if ((group_ledger->getGroupSize() == 0) && (delta_p->getJoinedArraySize() > 0))
+		informUpperOfJoin();
 
-	//Record the data of the last peer that left, in case we get an outdated object add message from that peer
-	lastPeerLeft = peer_data_pkt->getPeerData();
+	for (unsigned int i = 0 ; i < delta_p->getJoinedArraySize() ; i++)
+	{
+		group_ledger->addPeer(delta_p->getJoined(i));
+		membership_log.record(delta_p->getJoined(i), true, to_epoch);
+	}
+
+	membership_log.setEpoch(to_epoch);
+}
+
+void GroupStorage::requestMembershipSync()
+{
+	MembershipSyncPkt *sync_p = new MembershipSyncPkt("membership_sync");
+
+	sync_p->setSourceAddress(this_address);
+	sync_p->setDestinationAddress(super_peer_address);
+	sync_p->setGroupAddress(super_peer_address);
+	sync_p->setPayloadType(SP_MEMBERSHIP_SYNC);
+	sync_p->setEpoch(membership_log.getEpoch());
+	sync_p->setByteLength(MEMBERSHIP_SYNC_PKT_SIZE);
+
+	send(sync_p, "comms_gate$o");
 }
 
 void GroupStorage::replicate(ObjectData object_data, int repplica_diff)
@@ -1007,15 +2269,15 @@ void GroupStorage::handlePacket(Packet *packet)
 	{
 		addToGroup(packet);
 		delete(packet);
-	}else if (packet->getPayloadType() == JOIN_ACCEPT)
+	} else if (packet->getPayloadType() == OBJECT_ADD_BATCH)
 	{
-		addToGroup(packet);
+		addObjectBatch(check_and_cast<ObjectListPkt *>(packet));
 		delete(packet);
-	}else if (packet->getPayloadType() == PEER_JOIN)
+	}else if (packet->getPayloadType() == JOIN_ACCEPT)
 	{
 		addToGroup(packet);
 		delete(packet);
-	} else if (packet->getPayloadType() == WRITE)
+	} else if ((packet->getPayloadType() == WRITE) || (packet->getPayloadType() == WRITE_REF))
 	{
 		store(packet);
 		delete(packet);
@@ -1023,6 +2285,21 @@ void GroupStorage::handlePacket(Packet *packet)
 	{
 		store(packet);
 		delete(packet);
+	} else if (packet->getPayloadType() == HASH_REQ)
+	{
+		handleHashRequest(check_and_cast<OverlayKeyPkt *>(packet));
+		delete(packet);
+	} else if (packet->getPayloadType() == HASH)
+	{
+		respond_toUpper(packet);
+	} else if (packet->getPayloadType() == UPDATE)
+	{
+		handleUpdate(check_and_cast<UpdatePkt *>(packet));
+		delete(packet);
+	} else if (packet->getPayloadType() == MODIFY_REQ)
+	{
+		sendUpdate(check_and_cast<UpdatePkt *>(packet));
+		delete(packet);
 	} else if (packet->getPayloadType() == RESPONSE)
 	{
 		respond_toUpper(packet);
@@ -1037,6 +2314,10 @@ void GroupStorage::handlePacket(Packet *packet)
 		OverlayKeyPkt *retrieve_req = check_and_cast<OverlayKeyPkt *>(packet);
 
 		requestRetrieve(retrieve_req);
+	} else if (packet->getPayloadType() == BATCH)
+	{
+		handleBatch(check_and_cast<BatchPkt *>(packet));
+		delete(packet);
 	} else if (packet->getPayloadType() == REPLICATION_REQ)
 	{
 		ReplicationReqPkt *replicate_pkt = check_and_cast<ReplicationReqPkt *>(packet);
@@ -1049,44 +2330,289 @@ void GroupStorage::handlePacket(Packet *packet)
 
 		replicate(replicate_pkt->getObjectData(), replicate_pkt->getReplicaDiff());
 		delete(packet);
-	} else if (packet->getPayloadType() == PEER_LEFT)
+	} else if (packet->getPayloadType() == MEMBERSHIP_DELTA)
 	{
-		PeerDataPkt *peer_data_pkt = check_and_cast<PeerDataPkt *>(packet);
-
-		handleLeftPeer(peer_data_pkt);
+		handleMembershipDelta(check_and_cast<MembershipDeltaPkt *>(packet));
+		delete(packet);
+	} else if (packet->getPayloadType() == GOSSIP)
+	{
+		handleGossip(check_and_cast<GossipPkt *>(packet));
 		delete(packet);
 	}
 	else error("Group storage received an unknown packet");
 }
 
+void GroupStorage::addToBatch(BatchPkt *batch, Packet *pkt)
+{
+	batch->addObject(pkt);
+	batch->addByteLength(pkt->getByteLength() - 3*ADDRESS_SIZE);
+}
+
+void GroupStorage::sendToPeer(Packet *pkt)
+{
+	if (isBatching)
+		outgoingBatches[pkt->getDestinationAddress()].push_back(pkt);
+	else send(pkt, "comms_gate$o");
+}
+
+void GroupStorage::sendOutgoingBatches()
+{
+	OutgoingBatches::iterator batch_it;
+
+	for (batch_it = outgoingBatches.begin() ; batch_it != outgoingBatches.end() ; batch_it++)
+	{
+		std::vector<Packet *> &packets = batch_it->second;
+
+		//A single request is sent as it is
+		if (packets.size() == 1)
+		{
+			send(packets[0], "comms_gate$o");
+			continue;
+		}
+
+		BatchPkt *batch_p = new BatchPkt("batch");
+		batch_p->setPayloadType(BATCH);
+		batch_p->setSourceAddress(this_address);
+		batch_p->setDestinationAddress(batch_it->first);
+		batch_p->setGroupAddress(super_peer_address);
+		batch_p->setByteLength(BATCH_PKT_SIZE);
+
+		for (unsigned int i = 0 ; i < packets.size() ; i++)
+			addToBatch(batch_p, packets[i]);
+
+		RECORD_STATS(numRequestBatches++; numBatchedRequests += packets.size());
+		send(batch_p, "comms_gate$o");
+	}
+
+	outgoingBatches.clear();
+}
+
+void GroupStorage::handleBatch(BatchPkt *batch)
+{
+	cArray &list = batch->getParList();
+	std::vector<Packet *> packets;
+
+	for (int i = 0 ; i < list.size() ; i++)
+	{
+		if (list[i] != NULL)
+			packets.push_back(check_and_cast<Packet *>(list[i]));
+	}
+
+	//Only a batch from the higher layer is coalesced again. A peer receiving a batch responds to each of its requests.
+	isBatching = batch->arrivedOn("write");
+
+	for (unsigned int i = 0 ; i < packets.size() ; i++)
+	{
+		batch->removeObject(packets[i]);
+		take(packets[i]);
+		handlePacket(packets[i]);
+	}
+
+	if (isBatching)
+	{
+		isBatching = false;
+		sendOutgoingBatches();
+	}
+}
+
 void GroupStorage::peerLeftInform(PeerData peerData, int sp_way_left)
 {
-	std::vector<PeerDataPtr>::iterator it;
 	PeerDataPkt *pkt = new PeerDataPkt("peerLeft");
 
 	pkt->setSourceAddress(this_address);
 	pkt->setGroupAddress(super_peer_address);
-	pkt->setPayloadType(PEER_LEFT);
 	pkt->setPeerData(peerData);
 	pkt->setByteLength(PEERDATA_PKT_SIZE);
 
-	/*std::ostringstream msg;
-	msg << "[" << this_address << "]: Leaving peer group size\n";
+	//The peer is no longer used for gossip or routing, even before the super peer confirms that it left
+	view.remove(peerData);
+	hopTimeouts.erase(peerData.getAddress());
 
-	RECORD_STATS(globalStatistics->recordOutVector(msg.str().c_str(), group_ledger->getGroupSize()));*/
+	//The group peers are not informed directly. The super peer records the change and sends it to them in a membership delta.
+	//Can be either SP_PEER_LEFT or SP_PEER_MIGRATED (only the super peer's is different, since the super peer decides to replicate or note based on this info
+	pkt->setPayloadType(sp_way_left);
+	pkt->setDestinationAddress(super_peer_address);
+	send(pkt, "comms_gate$o");
+}
 
-	for (unsigned int i = 0 ; i < group_ledger->getGroupSize() ; i++)
+void GroupStorage::addToView(PeerData peer_data)
+{
+	if ((peer_data.getAddress() == this_address) || membership_log.hasLeft(peer_data))
+		return;
+
+	view.insert(peer_data);
+}
+
+void GroupStorage::addObjectRumor(const ObjectData &object_data, const PeerData &peer_data)
+{
+	GossipRumor rumor;
+
+	rumor.isObject = true;
+	rumor.objectData = object_data;
+	rumor.peerData = peer_data;
+	rumor.epoch = 0;
+	rumor.joined = false;
+	rumor.rounds = rumorRounds;
+
+	rumors.push_back(rumor);
+}
+
+void GroupStorage::addMembershipRumor(const PeerData &peer_data, bool joined, unsigned int epoch)
+{
+	GossipRumor rumor;
+
+	rumor.isObject = false;
+	rumor.peerData = peer_data;
+	rumor.epoch = epoch;
+	rumor.joined = joined;
+	rumor.rounds = rumorRounds;
+
+	rumors.push_back(rumor);
+}
+
+bool GroupStorage::applyMembershipRumor(PeerData peer_data, bool joined, unsigned int epoch)
+{
+	//This peer's own membership is known from its join, so rumors of it are outdated
+	if (peer_data.getAddress() == this_address)
+		return false;
+
+	if (!membership_log.apply(peer_data, joined, epoch))
+		return false;
+
+	if (joined)
 	{
-		//Dereference it to get PeerDataPtr and use -> operator to get PeerData
-		pkt->setDestinationAddress(group_ledger->getPeerPtr(i)->getAddress());
+		group_ledger->addPeer(peer_data);
+		addToView(peer_data);
+	} else {
+		group_ledger->removePeer(peer_data);
+		view.remove(peer_data);
+	}
+
+	return true;
+}
+
+void GroupStorage::sendGossip(const TransportAddress &dest_adr, bool isReply)
+{
+	std::vector<PeerData> sample;
+	unsigned int num_objects = 0, num_members = 0;
+
+	GossipPkt *gossip_p = new GossipPkt("gossip");
+	gossip_p->setSourceAddress(this_address);
+	gossip_p->setDestinationAddress(dest_adr);
+	gossip_p->setGroupAddress(super_peer_address);
+	gossip_p->setPayloadType(GOSSIP);
+	gossip_p->setIsReply(isReply);
+
+	//Half of the view and this peer itself are offered, so that views are mixed without being replaced outright
+	view.getSample(viewSize/2, sample);
+	sample.push_back(PeerData(this_address));
+
+	gossip_p->setViewArraySize(sample.size());
+	for (unsigned int i = 0 ; i < sample.size() ; i++)
+		gossip_p->setView(i, sample[i]);
 
-		send(pkt->dup(), "comms_gate$o");
+	for (unsigned int i = 0 ; i < rumors.size() ; i++)
+	{
+		if (rumors[i].isObject)
+			num_objects++;
+		else num_members++;
 	}
 
-	//Can be either SP_PEER_LEFT or SP_PEER_MIGRATED (only the super peer's is different, since the super peer decides to replicate or note based on this info
-	pkt->setPayloadType(sp_way_left);
-	pkt->setDestinationAddress(super_peer_address);
-	send(pkt, "comms_gate$o");
+	gossip_p->setObjectsArraySize(num_objects);
+	gossip_p->setHoldersArraySize(num_objects);
+	gossip_p->setMembersArraySize(num_members);
+	gossip_p->setMemberEpochsArraySize(num_members);
+	gossip_p->setMemberJoinedArraySize(num_members);
+
+	num_objects = 0;
+	num_members = 0;
+
+	//Every rumor is passed on in a limited number of exchanges, after which it is assumed to have reached the whole group
+	for (unsigned int i = 0 ; i < rumors.size() ; )
+	{
+		GossipRumor &rumor = rumors[i];
+
+		if (rumor.isObject)
+		{
+			gossip_p->setObjects(num_objects, rumor.objectData);
+			gossip_p->setHolders(num_objects, rumor.peerData);
+			num_objects++;
+		} else {
+			gossip_p->setMembers(num_members, rumor.peerData);
+			gossip_p->setMemberEpochs(num_members, rumor.epoch);
+			gossip_p->setMemberJoined(num_members, rumor.joined);
+			num_members++;
+		}
+
+		if (--rumor.rounds <= 0)
+		{
+			rumors[i] = rumors.back();
+			rumors.pop_back();
+		} else i++;
+	}
+
+	gossip_p->setByteLength(GOSSIP_PKT_SIZE(sample.size(), num_objects, num_members));
+
+	RECORD_STATS(numGossipSent++; gossipBytesSent += gossip_p->getByteLength());
+
+	send(gossip_p, "comms_gate$o");
+}
+
+void GroupStorage::handleGossip(GossipPkt *gossip_p)
+{
+	//If a packet was received from another group, ignore it.
+	if (gossip_p->getGroupAddress() != super_peer_address)
+		return;
+
+	//Membership changes are applied first, so that objects of peers that have left are not added again
+	for (unsigned int i = 0 ; i < gossip_p->getMembersArraySize() ; i++)
+	{
+		PeerData peer_data = gossip_p->getMembers(i);
+		bool joined = gossip_p->getMemberJoined(i);
+		unsigned int epoch = gossip_p->getMemberEpochs(i);
+
+		if (applyMembershipRumor(peer_data, joined, epoch))
+			addMembershipRumor(peer_data, joined, epoch);
+	}
+
+	for (unsigned int i = 0 ; i < gossip_p->getViewArraySize() ; i++)
+	{
+		PeerData peer_data = gossip_p->getView(i);
+
+		if ((peer_data.getAddress() == this_address) || membership_log.hasLeft(peer_data))
+			continue;
+
+		group_ledger->addPeer(peer_data);
+		addToView(peer_data);
+	}
+
+	for (unsigned int i = 0 ; i < gossip_p->getObjectsArraySize() ; i++)
+	{
+		ObjectData object_data = gossip_p->getObjects(i);
+		PeerData peer_data = gossip_p->getHolders(i);
+
+		if (membership_log.hasLeft(peer_data))
+			continue;
+
+		//A known replica is only spread further if it was updated or stored again since it was recorded
+		bool isKnown = group_ledger->isObjectOnPeer(object_data, peer_data);
+		if (isKnown && !group_ledger->isObjectDataNewer(object_data))
+			continue;
+
+		//An object that has already expired is not worth spreading further
+		if (simTime() > object_data.getCreationTime() + object_data.getTTL())
+			continue;
+
+		group_ledger->addObject(object_data, peer_data);
+		addObjectRumor(object_data, peer_data);
+
+		//The creation time of an updated object is that of its first version, so only new replicas are measured
+		if (!isKnown)
+			RECORD_STATS(globalStatistics->addStdDev("GroupStorage: Gossip object dissemination delay", SIMTIME_DBL(simTime() - object_data.getCreationTime())));
+	}
+
+	if (!gossip_p->getIsReply())
+		sendGossip(gossip_p->getSourceAddress(), true);
 }
 
 void GroupStorage::handleTimeout(ResponseTimeoutEvent *timeout)
@@ -1096,12 +2622,19 @@ void GroupStorage::handleTimeout(ResponseTimeoutEvent *timeout)
 	bool found = false;
 	std::vector<ResponseTimeoutEvent *>::iterator timeout_it;
 	PeerData peerData;
+	unsigned int timeout_rpcid = timeout->getRpcid();	//The timeout is deleted before the hedge is handled
 
 	//Locate the timeout in the pending requests list
 	PendingRequests::iterator it = pendingRequests.find(timeout->getRpcid());
+	bool isHedged = hedgedGets && (it->second.responseType == GROUP_GET);
+	bool isFragmented = erasureCoding && (it->second.responseType == GROUP_GET);
+	bool isUpdate = (it->second.responseType == GROUP_MOD);
+	bool isVoted = hashVoting && (it->second.responseType == GROUP_GET);
 
 	// a failure response to the higher layer for the received timeout
-	sendUpperResponse(it->second.responseType, it->second.request_time, timeout->getRpcid(), false);
+	//Hedged, erasure coded and hash voted requests only report a failure once the object can no longer be retrieved, and updates once all peers have responded
+	if (!isHedged && !isFragmented && !isUpdate && !isVoted)
+		sendUpperResponse(it->second.responseType, it->second.request_time, timeout->getRpcid(), false);
 
 	/*if (it->second.numGetSent > 0)
 		std::cout << "[" << simTime() << ":" << this_address <<"]: GET timeout received for peer (" << timeout->getPeerData().getAddress() << " with rpcid " << timeout->getRpcid() << endl;
@@ -1128,23 +2661,74 @@ void GroupStorage::handleTimeout(ResponseTimeoutEvent *timeout)
 	if (!found)
 		error("When a timeout expired, its linked peer data could not be located.");
 
+	//A timed out fragment request is replaced by a request to another peer storing a fragment
+	if (isFragmented)
+	{
+		if (!requestMissingFragments(it))
+			finishFragmentRequest(it);
+	}
+	//A timed out hedged request is followed by the hedge immediately, if it has not been sent yet
+	else if (isHedged)
+	{
+		sendHedge(it);
+
+		if (it->second.timeouts.size() == 0)
+		{
+			sendUpperResponse(it->second.responseType, it->second.request_time, timeout_rpcid, false);
+			RECORD_STATS(numGetError++);
+		}
+	}
+
+	//A timed out update counts as a failed one, and the request is removed once all peers have responded
+	if (isUpdate)
+		handleUpdateResponse(it, false);
+	else if (isVoted)
+	{
+		//A timed out hash request counts as a failed vote. If the object itself timed out, the next agreeing holder is asked.
+		if (it->second.votedHash.isUnspecified())
+		{
+			it->second.numVotesFailed++;
+			countVotes(it);
+		}
+		else if ((peerData.getAddress() == it->second.bodyPeer) && !fetchVotedObject(it))
+			finishVote(it, false);
+	}
 	//If there are no more timeouts outstanding, remove the pending request item from the requests vector
-	if (it->second.timeouts.size() == 0)
+	else if (!isFragmented && it->second.timeouts.size() == 0)
 		pendingRequests.erase(it);
 
-	//The peer is not removed from the group ledger here. Since the peer itself is contained in its own group ledger, a message is just sent to itself to remove the peer.
+	//The peer is not removed from the group ledger here. The super peer removes it and informs the group, including this peer, in a membership delta.
+	//In a partially connected group, the request may have been delayed on a later hop, so the first hop is only reported
+	//once several requests to it have timed out in a row, without a response in between.
+	if (partialGroup)
+	{
+		if (++hopTimeouts[peerData.getAddress()] >= hopFailureTimeouts)
+			peerLeftInform(peerData, SP_PEER_LEFT);
+	} else {
+		if (adaptiveTimeouts)
+		{
+			//An adaptive timeout may only mean that the peer was slower than usual, so the peer is pinged with the full
+			//timeout before it is reported (see pingTimeout). Until it responds again, its requests use a longer timeout.
+			RttEstimator *rtt = group_ledger->getRttEstimator(peerData);
+			if (rtt != NULL)
+				rtt->backOff();
 
-	peerLeftInform(peerData, SP_PEER_LEFT);
+			communicator->externallyPingNode(peerData.getAddress(), requestTimeout, 0, new PeerStatsContext(globalStatistics->isMeasuring(), peerData), "PING", NULL, -1, UDP_TRANSPORT);
+		}
+		else peerLeftInform(peerData, SP_PEER_LEFT);
+	}
 }
 
 void GroupStorage::pingResponse(PingResponse* pingResponse, PeerStatsContext* context, int rpcId, simtime_t rtt)
 {
 	Enter_Method_Silent();	//Required for Omnet++ context switching between modules
-	delete(context);
 
 	//std::cout << "Received a ping response.\n";
 
-	//The pinged peer responded, so all is well. We can collect some stats here if we want.
+	//The pinged peer responded, so all is well. Its round trip time is used to choose the replica holders GET requests are sent to.
+	group_ledger->recordRtt(context->peer_data, rtt);
+
+	delete(context);
 	return;
 }
 
@@ -1163,18 +2747,36 @@ void GroupStorage::pingRandomGroupPeer()
 {
 	TransportAddress dest_adr;
 
-	if (group_ledger->getGroupSize() == 0)
-		return;
+	//In a partially connected group, only the peers in the view are monitored
+	if (partialGroup)
+	{
+		if (view.empty())
+			return;
+
+		dest_adr = view.getRandomPeer().getAddress();
+	} else {
+		if (group_ledger->getGroupSize() == 0)
+			return;
 
-	dest_adr = group_ledger->getRandomPeer().getAddress();
+		dest_adr = group_ledger->getRandomPeer().getAddress();
+	}
 
 	communicator->externallyPingNode(dest_adr, requestTimeout, 0, new PeerStatsContext(globalStatistics->isMeasuring(), PeerData(dest_adr)), "PING", NULL, -1, UDP_TRANSPORT);
 }
 
-void GroupStorage::handleMessage(cMessage *msg)
+void GroupStorage::scheduleExpiryTimer()
 {
-	ObjectTTLTimer *ttlTimer = NULL;
+	simtime_t wakeup = expiry_wheel.getTimerWakeup(expiryTimer);
+
+	if (wakeup < 0)
+		return;
+
+	cancelEvent(expiryTimer);
+	scheduleAt(wakeup, expiryTimer);
+}
 
+void GroupStorage::handleMessage(cMessage *msg)
+{
 	if (msg == event)
 	{
 		//For the first join request, a request is sent to the well known directory server
@@ -1197,14 +2799,53 @@ void GroupStorage::handleMessage(cMessage *msg)
 
 		pingRandomGroupPeer();
 	}
-	else if ((ttlTimer = dynamic_cast<ObjectTTLTimer*>(msg)) != NULL)
-    {
-		//If the object's TTL has expired, remove the object from the local storage map.
-		//(The object is also automatically removed from the group ledger by the group ledger)
-		storage_map.erase(ttlTimer->getKey());
-        delete msg;
+	else if (msg->isName("hedge"))
+	{
+		ResponseTimeoutEvent *hedge = check_and_cast<ResponseTimeoutEvent *>(msg);
+		PendingRequests::iterator it = pendingRequests.find(hedge->getRpcid());
 
-    }
+		//The timer is owned by the pending request and deleted when the hedge is sent
+		if (it != pendingRequests.end() && it->second.hedgeTimer == hedge)
+		{
+			it->second.hedgeTimer = NULL;
+			delete(hedge);
+			sendHedge(it);
+		} else delete(hedge);
+	}
+	else if (msg == objectAddTimer)
+	{
+		sendObjectAddBatch();
+	}
+	else if (msg == gossipTimer)
+	{
+		scheduleAt(simTime()+gossipInterval, gossipTimer);
+
+		if (!super_peer_address.isUnspecified() && !view.empty())
+			sendGossip(view.getRandomPeer().getAddress(), false);
+	}
+	else if (msg == expiryTimer)
+	{
+		std::vector<OverlayKey> expired;
+
+		expiry_wheel.advance(simTime(), expired);
+
+		//If the objects' TTLs have expired, remove the objects from the local storage map.
+		//(The objects are also automatically removed from the group ledger by the group ledger)
+		for (unsigned int i = 0 ; i < expired.size() ; i++)
+		{
+			StorageMap::iterator storage_it = storage_map.find(expired[i]);
+
+			if (storage_it == storage_map.end())
+				continue;
+
+			eraseStored(storage_it);
+		}
+
+		if (!expired.empty())
+			emitStorageTotals();
+
+		scheduleExpiryTimer();
+	}
 	else if (strcmp(msg->getArrivalGate()->getName(), "from_upperTier") == 0)
 	{
 		PositionUpdatePkt *update_pkt = check_and_cast<PositionUpdatePkt *>(msg);
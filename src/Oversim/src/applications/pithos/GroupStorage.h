@@ -21,15 +21,24 @@
 
 #include <omnetpp.h>
 #include <GlobalStatistics.h>
+#include <tr1/unordered_map>
 
 
 #include "BaseApp.h"
 #include "Peer_logic.h"
 
 #include "GroupLedger.h"
+#include "LedgerArena.h"
 #include "PeerData.h"
 #include "GameObject.h"
 #include "PeerListPkt.h"
+#include "ExpiryWheel.h"
+#include "StorageTotals.h"
+#include "ContentStore.h"
+#include "MembershipLog.h"
+#include "PartialView.h"
+#include "LatencyWindow.h"
+#include "ReedSolomon.h"
 #include "PithosMessages_m.h"
 
 class GlobalStatistics;
@@ -59,8 +68,9 @@ class GroupStorage : public cSimpleModule
 		};
 		GroupStorage();
 		virtual ~GroupStorage();
-		int getStorageBytes();
-		int getStorageFiles();
+		int64_t getStorageBytes() { return totals.getBytes(); }
+		int getStorageFiles() { return totals.getObjects(); }
+		int64_t getStorageBytes(int ttl) { return totals.getBucketBytes(ttl); }
 
 		bool hasSuperPeer();
 		TransportAddress getSuperPeerAddress();
@@ -69,6 +79,11 @@ class GroupStorage : public cSimpleModule
 
 	private:
 
+		/**
+		 * Emit the current storage totals.
+		 */
+		void emitStorageTotals();
+
 		/**
 		 * This class provides a means to store all information about pending requests sent to the group.
 		 * A map of all pending requests are maintained and matched against responses received. If a response for
@@ -87,8 +102,15 @@ class GroupStorage : public cSimpleModule
 					numGroupPutSucceeded = 0;
 					numGroupGetFailed = 0;
 					numGroupGetSucceeded = 0;
+					numModSent = 0;
+					numGroupModSucceeded = 0;
+					numGroupModFailed = 0;
 					responseType = UNSPECIFIED;
 					request_time = SIMTIME_ZERO;
+					hedgeTimer = NULL;
+					retrieveRequest = NULL;
+					hedgeRequest = NULL;
+					numVotesFailed = 0;
 				};
 
 				int numGetSent;
@@ -97,11 +119,34 @@ class GroupStorage : public cSimpleModule
 				int numGroupPutSucceeded;
 				int numGroupGetFailed;
 				int numGroupGetSucceeded;
+				int numModSent;
+				int numGroupModSucceeded;
+				int numGroupModFailed;
 				int responseType;
 				simtime_t request_time;
 
 				//Smart pointers are not required here, since the pointers do not point to elements in dynamic containers
 				std::vector<ResponseTimeoutEvent *> timeouts;
+
+				std::set<TransportAddress> contacted;	//The peers a GET request has been sent to
+
+				//Hedged GET requests
+				ResponseTimeoutEvent *hedgeTimer;		//The timer that sends the hedge, or NULL if it is not pending
+				OverlayKeyPkt *hedgeRequest;			//The original request, kept until the hedge is sent
+				TransportAddress hedgePeer;				//The peer the hedge was sent to
+
+				//Erasure coded GET requests
+				OverlayKeyPkt *retrieveRequest;			//The original request, kept to ask further peers for fragments
+				std::vector<GameObject> fragments;		//The distinct fragments received so far
+
+				//Hash voted GET requests (the original request is kept in retrieveRequest)
+				std::map<OverlayKey, std::vector<PeerData> > votes;	//The peers that returned each content hash, which have not been asked for the object yet
+				int numVotesFailed;						//The number of hash requests that failed or timed out
+				OverlayKey votedHash;					//The content hash agreed on by a majority, unspecified until a majority is reached
+				TransportAddress bodyPeer;				//The peer the object itself was last requested from
+
+				//Deduplicated PUT requests
+				std::map<TransportAddress, GameObject> refObjects;	//The objects only sent by reference, kept in case a peer no longer holds their payload
 		};
 
 		//friend std::ostream& operator<<(std::ostream& Stream, const PendingRequestsEntry& entry);
@@ -116,6 +161,17 @@ class GroupStorage : public cSimpleModule
 		typedef std::map<OverlayKey, GameObject> StorageMap;
 		StorageMap storage_map;
 
+		StorageTotals totals;		/**< Running totals of the bytes and objects in the storage map */
+
+		ContentStore content_store;	/**< The payloads of the objects in the storage map, shared by objects with identical payloads */
+
+		simsignal_t storageBytesSignal;		/**< Signal for recording the number of bytes stored */
+		simsignal_t storageObjectsSignal;	/**< Signal for recording the number of objects stored */
+		simsignal_t storageContentBytesSignal;	/**< Signal for recording the number of distinct payload bytes stored */
+
+		ExpiryWheel expiry_wheel;	/**< Keeps track of when the objects in the storage map expire */
+		cMessage *expiryTimer;		/**< The timer that triggers the removal of expired objects */
+
 		TransportAddress super_peer_address; /**< The TransPort address of the group super peer (this address is set, after the peer has joined a group) */
 		TransportAddress this_address;		 /**< The TransPort address of the peer that houses the group storage module*/
 
@@ -127,7 +183,7 @@ class GroupStorage : public cSimpleModule
 
 		double longitude; /**< The longitude of this peer (position in the virtual world) */
 
-		PeerData lastPeerLeft;	/**< The peer data of the last peer that left the group */
+		MembershipLog membership_log;	/**< The membership changes of the group this peer has been informed of by the super peer */
 
 		GroupLedger *group_ledger;
 
@@ -158,6 +214,9 @@ class GroupStorage : public cSimpleModule
 
 		//Request settings
 		simtime_t requestTimeout;	/**< The amount of time to wait for a response to a request, before a node is removed from the group*/
+		bool adaptiveTimeouts;		/**< true if the timeout of a request is derived from the round trip time to its destination, with requestTimeout as the ceiling */
+		simtime_t minRequestTimeout;	/**< The shortest adaptive request timeout */
+		long numLateResponses;		/**< number of responses received after their request timed out */
 		int numGetRequests;
 
 		bool gracefulMigration;
@@ -169,6 +228,99 @@ class GroupStorage : public cSimpleModule
 		//Security parameters
 		bool isMalicious;
 
+		//OBJECT_ADD batching
+		simtime_t objectAddWindow;		/**< The longest time an OBJECT_ADD notification is held back to be batched with others */
+		unsigned int objectAddBatchSize;	/**< The number of notifications after which a batch is sent immediately (0 for no limit) */
+		std::vector<ObjectData> pendingObjectAdds;	/**< The objects stored on this peer that the group has not yet been informed of */
+		cMessage *objectAddTimer;		/**< The timer that sends the pending batch when the window closes */
+
+		long numObjectAddBatches;		/**< number of OBJECT_ADD batches sent */
+		long objectAddBytesSaved;		/**< bytes saved by sending batches instead of one packet per object and destination */
+
+		//Request batching
+		typedef std::map<TransportAddress, std::vector<Packet *> > OutgoingBatches;
+		bool isBatching;				/**< true while the requests of a batch from the higher layer are handled */
+		OutgoingBatches outgoingBatches;	/**< The requests held back while batching, grouped by the peer they are sent to */
+
+		long numRequestBatches;			/**< number of batch packets sent to other peers */
+		long numBatchedRequests;		/**< number of requests sent in batch packets */
+
+		/**
+		 * An object or membership change that is spread through a partially connected group by gossip
+		 */
+		struct GossipRumor
+		{
+			bool isObject;			//true for an object rumor, false for a membership rumor
+			ObjectData objectData;
+			PeerData peerData;		//The peer storing the object, or the peer that joined or left
+			unsigned int epoch;		//The membership epoch of a membership change
+			bool joined;
+			int rounds;				//The number of gossip exchanges the rumor is still passed on in
+		};
+
+		//Partially connected groups
+		bool partialGroup;			/**< true if this peer only communicates with the peers in its view, and learns of group changes by gossip */
+		PartialView view;			/**< The bounded random view of the group peers */
+		unsigned int viewSize;		/**< The maximum number of peers in the view */
+		double gossipInterval;		/**< The time between gossip exchanges started by this peer */
+		int rumorRounds;			/**< The number of gossip exchanges a rumor is passed on in */
+		unsigned int maxHops;		/**< The maximum number of hops a GET request is routed within the group */
+		unsigned int hopFailureTimeouts;	/**< The number of consecutive timeouts after which a first hop is reported as failed */
+
+		typedef std::tr1::unordered_map<TransportAddress, unsigned int, TransportAddress::hashFcn> HopTimeouts;
+		HopTimeouts hopTimeouts;	/**< The number of consecutive timeouts of every first hop since it last responded */
+		std::vector<GossipRumor> rumors;	/**< The rumors this peer is still spreading */
+		cMessage *gossipTimer;		/**< The timer that starts a gossip exchange with a random peer in the view */
+
+		PlacementLoad placementLoad;	/**< The load by which the peers that store replicas are chosen */
+
+		//Erasure coding
+		bool erasureCoding;			/**< true if objects are stored as erasure coded fragments instead of replicas */
+		unsigned int dataFragments;	/**< The number of fragments an object is split into. The remaining fragments up to the number of replicas are parity. */
+		ReedSolomon erasure_code;
+
+		static const unsigned int FRAGMENT_PAYLOAD_SIZE = 12;	/**< The coded bytes of an object: its value and its size */
+
+		//Hash voted GET requests
+		bool hashVoting;			/**< true if GET requests ask several replica holders for the content hash, and only fetch the object agreed on by a majority */
+		long numVoteBodiesRejected;	/**< number of objects fetched after a vote whose content hash did not match the voted hash */
+		long voteBytesSaved;		/**< bytes saved by voting on content hashes instead of comparing whole objects */
+
+		//Object updates
+		long numModSent;			/**< number of update packets sent to peers storing the updated objects */
+		long numModSuccess;			/**< number of update requests applied by the group */
+		long numModError;			/**< number of update requests that failed */
+		long numModStale;			/**< number of received updates rejected because the stored object had a newer version */
+		long updateBytesSaved;		/**< bytes saved by sending only the changed part of updated objects */
+
+		//Deduplication
+		bool deduplication;			/**< true if objects are only sent by payload hash to peers that already store their payload */
+		long numPutsDeduplicated;	/**< number of objects sent by payload hash instead of in full */
+		long numStoreOverwrites;	/**< number of stored objects replaced by a new PUT of the same key */
+		long dedupBytesSaved;		/**< bytes saved by sending objects by payload hash */
+		long numContentMissing;		/**< number of objects sent by payload hash that had to be sent again in full */
+
+		long numObjectsDecoded;		/**< number of objects reconstructed from fragments */
+		long numDecodeErrors;		/**< number of objects that could not be reconstructed from the fragments received */
+		long numDecodeCorrupt;		/**< number of decoded objects rejected because they did not match their content hash */
+
+		bool nearReplicas;			/**< true if GET requests are sent to replica holders with a low round trip time, instead of random holders */
+		unsigned int latencyCandidates;	/**< The number of holders with the lowest round trip time from which a GET target is chosen at random */
+
+		//Hedged GET requests
+		bool hedgedGets;			/**< true if a GET is sent to one replica holder, and only sent to a second one if no response arrived in time */
+		double hedgePercentile;		/**< The percentile of recent GET latencies after which the hedge is sent */
+		simtime_t hedgeDelay;		/**< The time after which the hedge is sent, until enough GET latencies have been observed */
+		unsigned int minHedgeSamples;	/**< The number of GET latencies required before the percentile is used */
+		LatencyWindow getLatencies;	/**< The most recent latencies of GET requests sent to the group */
+
+		long numGetHedged;			/**< number of hedged GET requests sent */
+		long numGetHedgeWon;		/**< number of GET requests answered first by the hedge */
+
+		long numGossipSent;			/**< number of gossip packets sent */
+		long gossipBytesSent;		/**< number of gossip bytes sent */
+		int getErrMaxHops;			/**< number of GET requests that did not reach the object within the hop limit */
+
 		/**
 		 * The function creates a write packet and fills it with address information, payload type and byte length.
 		 *
@@ -188,19 +340,115 @@ class GroupStorage : public cSimpleModule
 		void updatePeerObjects(const GameObject& go);
 
 		/**
-		 * Select a random TransportAddress within the group that has not be chosen for a replica during the current selection process.
+		 * Inform the group peers and the super peer of all pending objects, in one batch packet per destination.
+		 */
+		void sendObjectAddBatch();
+
+		/**
+		 * Function is called when a group peer informs this peer of a batch of objects it has stored.
 		 *
-		 * @param dest_adr The selected destination address to which an object should be written.
-		 * @param send_list A history of peers selected to store the particular GameObject.
+		 * @param list_p The peer that stores the objects and the objects' data.
 		 */
-		PeerData selectDestination(std::vector<TransportAddress> send_list);
+		void addObjectBatch(ObjectListPkt *list_p);
+
+		/**
+		 * Inform the game module that a group has been joined, so that it may start producing requests.
+		 */
+		void informUpperOfJoin();
 
 		void handleResponse(PendingRequests::iterator it, ResponsePkt *response);
 		/**
 		 * Cancel the pending request timeout
 		 * @returns the peer data related to the request
 		 */
-		PeerData cancelRequestTimer(PendingRequests::iterator it, TransportAddress source_address);
+		PeerData cancelRequestTimer(PendingRequests::iterator it, TransportAddress source_address, simtime_t *send_time = NULL);
+
+		/**
+		 * @return the time to wait for a response to a request sent to the given peer
+		 */
+		simtime_t getRequestTimeout(PeerData peer_data);
+
+		/**
+		 * Schedule the timeout of a request sent to a group peer.
+		 */
+		ResponseTimeoutEvent *scheduleRequestTimeout(int rpcid, PeerData peer_data);
+
+		/**
+		 * Send an object in full to a peer that failed to store it by reference, because it no longer holds its payload.
+		 *
+		 * @return true if the object had been sent to the peer by reference
+		 */
+		bool resendContent(PendingRequests::iterator it, ResponsePkt *response, PeerData peer_data);
+
+		/**
+		 * Remove an object from the storage map, releasing its payload.
+		 */
+		void eraseStored(StorageMap::iterator storage_it);
+
+		/**
+		 * @return true if a response from the given peer is still expected for the pending request
+		 */
+		bool isAwaitingResponse(PendingRequests::iterator it, TransportAddress source_address);
+
+		/**
+		 * Handle a response to a hedged GET request. The first successful response is reported to the higher layer and the
+		 * other requests are abandoned. A failure is only reported once all requests have failed.
+		 *
+		 * @return true if the response should be forwarded to the higher layer
+		 */
+		bool handleHedgedResponse(PendingRequests::iterator it, ResponsePkt *response);
+
+		/**
+		 * Send the hedge of a GET request to a replica holder that has not been asked yet, unless the hedge was already sent.
+		 */
+		void sendHedge(PendingRequests::iterator it);
+
+		/**
+		 * Cancel the hedge of a pending request and release the request kept for it.
+		 */
+		void clearHedge(PendingRequestsEntry &entry);
+
+		/**
+		 * Split an object into erasure coded fragments. The value and size of the object are coded, while its other
+		 * attributes are copied into every fragment.
+		 *
+		 * @param object The object to be coded
+		 * @param fragments All data and parity fragments are appended to this list, in the order of their indices
+		 */
+		void encodeObject(const GameObject &object, std::vector<GameObject> &fragments);
+
+		/**
+		 * Reconstruct an object from its fragments.
+		 * Only fragments that claim the same whole object hash as most of the others are used, and the decoded object
+		 * has to match that hash, so that a corrupted fragment cannot silently decode to a wrong object.
+		 *
+		 * @return false if the fragments do not suffice, are inconsistent, or decode to an object that does not match its hash
+		 */
+		bool decodeObject(const std::vector<GameObject> &fragments, GameObject &object);
+
+		/**
+		 * Ask further group peers for fragments, until enough fragments have been received or requested to reconstruct the object.
+		 *
+		 * @return false if too few peers store fragments of the object
+		 */
+		bool requestMissingFragments(PendingRequests::iterator it);
+
+		/**
+		 * Handle a response to an erasure coded GET request. The response itself is never forwarded, since the
+		 * reconstructed object is sent to the higher layer by finishFragmentRequest().
+		 */
+		void handleFragmentResponse(PendingRequests::iterator it, ResponsePkt *response);
+
+		/**
+		 * Reconstruct the object of an erasure coded GET request, inform the higher layer of the outcome, abandon
+		 * the requests still outstanding and remove the pending request.
+		 */
+		void finishFragmentRequest(PendingRequests::iterator it);
+
+		/**
+		 * @return the time after which the hedge of a GET request is sent
+		 */
+		simtime_t getHedgeDelay();
 
 		void respond_toUpper(cMessage *msg);
 
@@ -230,7 +478,17 @@ class GroupStorage : public cSimpleModule
 
 		void store(Packet *pkt);
 
-		void handleLeftPeer(PeerDataPkt *peer_data_pkt);
+		/**
+		 * Apply the membership changes sent by the super peer. If changes were missed, the super peer is asked to resend them.
+		 *
+		 * @param delta_p The peers that joined and left the group since the delta's starting epoch
+		 */
+		void handleMembershipDelta(MembershipDeltaPkt *delta_p);
+
+		/**
+		 * Ask the super peer for the membership changes since the last epoch this peer has been informed of.
+		 */
+		void requestMembershipSync();
 		/**
 		 * Function to store files in the group. This function replicates game objects and sends them to different group nodes.
 		 *
@@ -238,7 +496,70 @@ class GroupStorage : public cSimpleModule
 		 */
 		void send_forstore(ValuePkt *store_req);
 
+		/**
+		 * Send the changed part of an object to every group peer that stores it, so that they can update their replicas in place.
+		 * A single response is sent to the higher layer once all peers have responded.
+		 *
+		 * @param modify_req The update request, with the updated object attached
+		 */
+		void sendUpdate(UpdatePkt *modify_req);
+
+		/**
+		 * Apply an update received from a group peer to the stored replica, and respond with the outcome.
+		 */
+		void handleUpdate(UpdatePkt *update);
+
+		/**
+		 * Update a stored object in place. Concurrent updates are resolved by version, so that all replicas end up with the
+		 * same object regardless of the order in which the updates arrive: the higher version wins, and of two different
+		 * updates with the same version, the one with the higher payload hash wins.
+		 *
+		 * @return true if the stored object now holds the update
+		 */
+		bool applyUpdate(StorageMap::iterator storage_it, const GameObject &update);
+
+		/**
+		 * Count the response of a peer to an update, and inform the higher layer once all peers have responded.
+		 */
+		void handleUpdateResponse(PendingRequests::iterator it, bool isSuccess);
+
 		void forwardRequest(OverlayKeyPkt *retrieve_req);
+
+		/**
+		 * Send a GET request to a group peer that stores the object and has not been asked yet, and schedule its timeout.
+		 *
+		 * @return false if no such peer could be found
+		 */
+		bool sendGroupRetrieve(OverlayKeyPkt *retrieve_req, PendingRequestsEntry &entry);
+
+		/**
+		 * Respond to a HASH_REQ with the content hash of the stored object.
+		 */
+		void handleHashRequest(OverlayKeyPkt *hash_req);
+
+		/**
+		 * Handle a content hash, or the object fetched after a vote. Once a majority of the holders asked agree on a hash,
+		 * the object is fetched from one of them, and only accepted if its content hash matches.
+		 */
+		void handleVotedResponse(PendingRequests::iterator it, ResponsePkt *response, PeerData peer_data);
+
+		/**
+		 * Fetch the object from the next holder that returned the voted hash.
+		 *
+		 * @return false if no such holder is left
+		 */
+		bool fetchVotedObject(PendingRequests::iterator it);
+
+		/**
+		 * Check whether a content hash has reached a majority, and fetch the object if it has. A failure is reported if
+		 * all holders have responded without a majority.
+		 */
+		void countVotes(PendingRequests::iterator it);
+
+		/**
+		 * Report the outcome of a hash voted GET request to the higher layer, and remove the request.
+		 */
+		void finishVote(PendingRequests::iterator it, bool isSuccess, const GameObject& object = GameObject::UNSPECIFIED_OBJECT);
 		bool handleMissingObject(OverlayKeyPkt *retrieve_req);
 		bool retrieveLocally(OverlayKeyPkt *retrieve_req);
 		void requestRetrieve(OverlayKeyPkt *retrieve_req);
@@ -254,8 +575,55 @@ class GroupStorage : public cSimpleModule
 
 		void removePeer(PeerDataPtr peerDataPtr);
 
+		/**
+		 * Inform the super peer that a peer has left the group. The super peer informs the rest of the group in its next membership delta.
+		 *
+		 * @param peerData The peer that left
+		 * @param sp_way_left SP_PEER_LEFT, or SP_PEER_MIGRATED if the peer's objects have already been replicated
+		 */
 		void peerLeftInform(PeerData peerData, int sp_way_left);
 
+		/**
+		 * Add a peer to the view of a partially connected group, unless it is this peer or is known to have left.
+		 */
+		void addToView(PeerData peer_data);
+
+		/**
+		 * Start spreading a rumor of an object stored on a peer.
+		 */
+		void addObjectRumor(const ObjectData &object_data, const PeerData &peer_data);
+
+		/**
+		 * Start spreading a rumor of a peer that joined or left the group.
+		 */
+		void addMembershipRumor(const PeerData &peer_data, bool joined, unsigned int epoch);
+
+		/**
+		 * Apply a membership change learnt by gossip.
+		 *
+		 * @return false if the change is outdated or already known
+		 */
+		bool applyMembershipRumor(PeerData peer_data, bool joined, unsigned int epoch);
+
+		/**
+		 * Send a sample of the view and all rumors still being spread to a peer.
+		 *
+		 * @param dest_adr The peer the gossip is sent to
+		 * @param isReply true if the gossip is the pull half of an exchange, to which no gossip should be sent back
+		 */
+		void sendGossip(const TransportAddress &dest_adr, bool isReply);
+
+		/**
+		 * Merge the view sample and rumors received from another peer, and answer with this peer's gossip if required.
+		 */
+		void handleGossip(GossipPkt *gossip_p);
+
+		/**
+		 * Route a GET request, that was forwarded to this peer but is not stored here, to the next peer in a partially connected group.
+		 * The request is routed to a peer known to store the object, or otherwise to a random peer in the view, until the hop limit is reached.
+		 */
+		void routeRequest(OverlayKeyPkt *retrieve_req);
+
 		/**
 		 * @returns the number of required replicas or the number of group peers, if this number is less than the required replicas (this case is also logged).
 		 */
@@ -265,6 +633,38 @@ class GroupStorage : public cSimpleModule
 
 		void pingRandomGroupPeer();
 
+		/**
+		 * (Re)schedule the expiry timer for the next time the expiry wheel has to be advanced.
+		 */
+		void scheduleExpiryTimer();
+
+		/**
+		 * Send a request to another group peer. While a batch from the higher layer is handled, the request is held back
+		 * and sent together with the batch's other requests to the same peer.
+		 */
+		void sendToPeer(Packet *pkt);
+
+		/**
+		 * Attach a packet to a batch packet. The packet's addresses are the batch packet's, so they are not counted again.
+		 *
+		 * @param batch The batch packet, which takes ownership of the packet
+		 * @param pkt The packet to be coalesced
+		 */
+		void addToBatch(BatchPkt *batch, Packet *pkt);
+
+		/**
+		 * Send all requests that were held back while batching, in one packet per peer.
+		 */
+		void sendOutgoingBatches();
+
+		/**
+		 * Handle every packet attached to a batch packet as if it had been received separately.
+		 * The requests in a batch from the higher layer are coalesced again by the peer they are sent to.
+		 * The requests in a batch from another peer are each responded to separately, so that every key's response is sent
+		 * as soon as it is available.
+		 */
+		void handleBatch(BatchPkt *batch);
+
 	protected:
 		void finish();
 		virtual void initialize();
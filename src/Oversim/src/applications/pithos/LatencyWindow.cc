@@ -0,0 +1,74 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#include <algorithm>
+
+#include "LatencyWindow.h"
+
+LatencyWindow::LatencyWindow() {
+	capacity = 100;
+	next = 0;
+}
+
+LatencyWindow::~LatencyWindow() {
+
+}
+
+void LatencyWindow::setCapacity(unsigned int capacity)
+{
+	if (capacity == 0)
+		opp_error("[LatencyWindow]: The latency window should hold at least one sample.");
+
+	this->capacity = capacity;
+	clear();
+}
+
+void LatencyWindow::add(double latency)
+{
+	if (samples.size() < capacity)
+	{
+		samples.push_back(latency);
+		return;
+	}
+
+	samples[next] = latency;
+	next = (next + 1) % capacity;
+}
+
+double LatencyWindow::getPercentile(double p)
+{
+	if (samples.empty())
+		return -1;
+
+	//The window is small, so selecting from a copy is cheaper than keeping the samples sorted
+	std::vector<double> sorted(samples);
+	unsigned int rank = (unsigned int)(p * (sorted.size() - 1) + 0.5);
+
+	if (rank >= sorted.size())
+		rank = sorted.size() - 1;
+
+	std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+
+	return sorted[rank];
+}
+
+void LatencyWindow::clear()
+{
+	samples.clear();
+	next = 0;
+}
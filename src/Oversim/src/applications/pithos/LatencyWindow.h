@@ -0,0 +1,57 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#ifndef LATENCYWINDOW_H_
+#define LATENCYWINDOW_H_
+
+#include <omnetpp.h>
+#include <vector>
+
+/**
+ * A sliding window over the most recently observed request latencies.
+ * Once the window is full, every new sample replaces the oldest one.
+ *
+ * @author John Gilmore
+ */
+class LatencyWindow
+{
+	private:
+		std::vector<double> samples;
+		unsigned int capacity;
+		unsigned int next;		/**< The position the next sample is written to, once the window is full */
+
+	public:
+		LatencyWindow();
+		virtual ~LatencyWindow();
+
+		void setCapacity(unsigned int capacity);
+
+		void add(double latency);
+
+		/**
+		 * @param p The percentile as a fraction between 0 and 1
+		 * @return the p-th percentile of the latencies in the window, or -1 if the window is empty.
+		 */
+		double getPercentile(double p);
+
+		unsigned int size() { return samples.size(); }
+
+		void clear();
+};
+
+#endif /* LATENCYWINDOW_H_ */
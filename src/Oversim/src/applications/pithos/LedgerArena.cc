@@ -0,0 +1,172 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#include "LedgerArena.h"
+
+const LedgerHandle LedgerArena::NULL_HANDLE;
+
+LedgerArena::LedgerArena() {
+
+}
+
+LedgerArena::~LedgerArena() {
+	clear();
+}
+
+LedgerHandle LedgerArena::addPeer(const PeerData &peer_data)
+{
+	LedgerHandle handle = peers.allocate();
+	PeerEntry &entry = peers[handle];
+
+	entry.peerData = peer_data;
+	entry.slot = 0;
+	entry.bytes_stored = 0;
+	entry.agreements = 0;
+	entry.disagreements = 0;
+	entry.object_total = 0;
+	entry.times_recorded = 0;
+
+	return handle;
+}
+
+void LedgerArena::removePeer(LedgerHandle peer)
+{
+	if (!peers[peer].links.empty())
+		opp_error("[LedgerArena]: Removing a peer that still stores objects.");
+
+	peers.release(peer);
+}
+
+LedgerHandle LedgerArena::addObject(const ObjectData &object_data)
+{
+	LedgerHandle handle = objects.allocate();
+	ObjectEntry &entry = objects[handle];
+
+	entry.objectData = object_data;
+	entry.replications = 0;
+	entry.repairs = 0;
+
+	return handle;
+}
+
+void LedgerArena::removeObject(LedgerHandle object)
+{
+	if (!objects[object].links.empty())
+		opp_error("[LedgerArena]: Removing an object that is still stored on peers.");
+
+	objects.release(object);
+}
+
+bool LedgerArena::isLinked(LedgerHandle peer, LedgerHandle object)
+{
+	LedgerLinkList &object_links = objects[object].links;
+	LedgerLinkList &peer_links = peers[peer].links;
+
+	//Search the shorter of the two lists. An object is usually stored on only a few peers.
+	if (object_links.size() <= peer_links.size())
+	{
+		for (unsigned int i = 0 ; i < object_links.size() ; i++)
+		{
+			if (object_links[i].handle == peer)
+				return true;
+		}
+	} else {
+		for (unsigned int i = 0 ; i < peer_links.size() ; i++)
+		{
+			if (peer_links[i].handle == object)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+bool LedgerArena::link(LedgerHandle peer, LedgerHandle object)
+{
+	if (isLinked(peer, object))
+		return false;
+
+	PeerEntry &peer_entry = peers[peer];
+	ObjectEntry &object_entry = objects[object];
+
+	LedgerLink peer_side;
+	peer_side.handle = object;
+	peer_side.back = object_entry.links.size();
+
+	LedgerLink object_side;
+	object_side.handle = peer;
+	object_side.back = peer_entry.links.size();
+
+	peer_entry.links.push_back(peer_side);
+	object_entry.links.push_back(object_side);
+
+	peer_entry.bytes_stored += object_entry.objectData.getSize();
+
+	return true;
+}
+
+void LedgerArena::removeLinkAt(LedgerLinkList &links, uint32_t i, bool mirror_is_peer)
+{
+	LedgerLink last = links.back();
+
+	links[i] = last;
+	links.pop_back();
+
+	//If the removed link was not the last one, the moved link's mirror has to point to its new position
+	if (i < links.size())
+	{
+		if (mirror_is_peer)
+			peers[last.handle].links[last.back].back = i;
+		else objects[last.handle].links[last.back].back = i;
+	}
+}
+
+void LedgerArena::unlinkPeerAt(LedgerHandle peer, uint32_t i)
+{
+	LedgerLink peer_side = peers[peer].links.at(i);
+
+	peers[peer].bytes_stored -= objects[peer_side.handle].objectData.getSize();
+	removeLinkAt(objects[peer_side.handle].links, peer_side.back, true);
+	removeLinkAt(peers[peer].links, i, false);
+}
+
+void LedgerArena::unlinkObjectAt(LedgerHandle object, uint32_t i)
+{
+	LedgerLink object_side = objects[object].links.at(i);
+
+	peers[object_side.handle].bytes_stored -= objects[object].objectData.getSize();
+	removeLinkAt(peers[object_side.handle].links, object_side.back, false);
+	removeLinkAt(objects[object].links, i, true);
+}
+
+void LedgerArena::setObjectData(LedgerHandle object, const ObjectData &object_data)
+{
+	ObjectEntry &object_entry = objects[object];
+	int old_size = object_entry.objectData.getSize();
+
+	object_entry.objectData = object_data;
+
+	for (unsigned int i = 0 ; i < object_entry.links.size() ; i++)
+		peers[object_entry.links[i].handle].bytes_stored += object_entry.objectData.getSize() - old_size;
+}
+
+void LedgerArena::clear()
+{
+	peers.clear();
+	objects.clear();
+}
@@ -0,0 +1,244 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#ifndef LEDGERARENA_H_
+#define LEDGERARENA_H_
+
+#include <omnetpp.h>
+#include <vector>
+
+#include "PeerData.h"
+#include "ObjectData.h"
+#include "RttEstimator.h"
+
+/**
+ * A 32-bit handle to a peer or object entry in the ledger arena.
+ */
+typedef uint32_t LedgerHandle;
+
+/**
+ * One side of a link between a peer and an object.
+ * A peer entry holds a link for every object stored on it, and an object entry holds a link for every peer it is stored on.
+ * Each link also records where its mirror link can be found in the other entry's link list, so that a link can be removed
+ * from both lists in O(1) without searching.
+ */
+struct LedgerLink
+{
+	LedgerHandle handle;	//The handle of the entry on the other side of the link
+	uint32_t back;			//The index of the mirror link in the other entry's link list
+};
+
+typedef std::vector<LedgerLink> LedgerLinkList;
+
+/**
+ * The load by which peers are compared when replicas are placed
+ */
+enum PlacementLoad
+{
+	PLACEMENT_RANDOM,		//Peers are chosen uniformly at random
+	PLACEMENT_OBJECTS,		//The peer storing fewer objects is chosen
+	PLACEMENT_BYTES			//The peer storing fewer bytes is chosen
+};
+
+/**
+ * A peer as it is recorded in the ledger arena
+ */
+struct PeerEntry
+{
+	PeerData peerData;
+	LedgerLinkList links;		//Links to all objects stored on the peer
+
+	uint32_t slot;				//The position of the peer in the group ledger's dense peer list
+
+	RttEstimator rtt;			//The round trip time to the peer, as measured by the peer that owns the ledger
+
+	int64_t bytes_stored;		//The total size of all objects stored on the peer
+
+	unsigned int agreements;	//The number of the peer's responses that agreed with the other holders of an object
+	unsigned int disagreements;	//The number of the peer's responses that disagreed with the other holders of an object
+
+	unsigned int object_total;
+	unsigned int times_recorded;
+};
+
+/**
+ * An object as it is recorded in the ledger arena
+ */
+struct ObjectEntry
+{
+	ObjectData objectData;
+	LedgerLinkList links;		//Links to all peers the object is stored on
+
+	//Records the number of times an object has been stored (object removals do not subtract from this number)
+	int replications;
+	int repairs;
+};
+
+/**
+ * A slab allocator for ledger entries.
+ * Entries are allocated in fixed size slabs that are never moved or resized, so that a pointer to an entry stays valid
+ * for as long as the entry is alive. Released slots are reused before a new slab is allocated.
+ *
+ * @author John Gilmore
+ */
+template <class T> class LedgerSlab
+{
+	private:
+		static const unsigned int SLAB_BITS = 8;
+		static const unsigned int SLAB_SIZE = 1 << SLAB_BITS;
+
+		std::vector<T*> slabs;
+		std::vector<LedgerHandle> free_list;
+		unsigned int live;
+
+		//Slabs own their entries, so copying the arena is not allowed
+		LedgerSlab(const LedgerSlab& other);
+		LedgerSlab& operator=(const LedgerSlab& other);
+
+	public:
+		LedgerSlab() { live = 0; }
+		~LedgerSlab() { clear(); }
+
+		LedgerHandle allocate()
+		{
+			LedgerHandle handle;
+
+			if (free_list.empty())
+			{
+				handle = slabs.size() * SLAB_SIZE;
+				slabs.push_back(new T[SLAB_SIZE]);
+
+				//Hand out the slots of the new slab in ascending order
+				for (unsigned int i = SLAB_SIZE - 1 ; i > 0 ; i--)
+					free_list.push_back(handle + i);
+			} else {
+				handle = free_list.back();
+				free_list.pop_back();
+			}
+
+			live++;
+			(*this)[handle] = T();
+
+			return handle;
+		}
+
+		void release(LedgerHandle handle)
+		{
+			(*this)[handle] = T();	//Free the memory held by the entry's link list
+			free_list.push_back(handle);
+			live--;
+		}
+
+		T& operator[](LedgerHandle handle)
+		{
+			return slabs[handle >> SLAB_BITS][handle & (SLAB_SIZE - 1)];
+		}
+
+		unsigned int size() { return live; }
+
+		void clear()
+		{
+			for (unsigned int i = 0 ; i < slabs.size() ; i++)
+				delete[] slabs[i];
+
+			slabs.clear();
+			free_list.clear();
+			live = 0;
+		}
+};
+
+/**
+ * The core storage of the group ledger.
+ * Peers and objects are stored in slab arenas and refer to each other through 32-bit handles, instead of through
+ * reference counted pointers. The peer-object incidence is stored as paired link lists with back-pointers, which
+ * allows a link to be added or removed in O(1).
+ *
+ * @author John Gilmore
+ */
+class LedgerArena
+{
+	private:
+		LedgerSlab<PeerEntry> peers;
+		LedgerSlab<ObjectEntry> objects;
+
+		/**
+		 * Remove the link at the given index from a link list by moving the last link into its place.
+		 * The back-pointer of the moved link's mirror is updated to its new position.
+		 *
+		 * @param links The link list from which the link should be removed.
+		 * @param i The index of the link to be removed.
+		 * @param mirror_is_peer true if the mirrors of the links in the list are stored in peer entries.
+		 */
+		void removeLinkAt(LedgerLinkList &links, uint32_t i, bool mirror_is_peer);
+
+	public:
+		static const LedgerHandle NULL_HANDLE = 0xFFFFFFFF;
+
+		LedgerArena();
+		virtual ~LedgerArena();
+
+		LedgerHandle addPeer(const PeerData &peer_data);
+
+		/**
+		 * Release a peer entry. All links to the peer should already have been removed.
+		 */
+		void removePeer(LedgerHandle peer);
+
+		LedgerHandle addObject(const ObjectData &object_data);
+
+		/**
+		 * Release an object entry. All links to the object should already have been removed.
+		 */
+		void removeObject(LedgerHandle object);
+
+		/**
+		 * Link a peer and an object in both directions.
+		 *
+		 * @return false if the peer and object were already linked, in which case nothing is changed.
+		 */
+		bool link(LedgerHandle peer, LedgerHandle object);
+
+		/**
+		 * Remove the i-th object link of a peer, together with its mirror in the object's link list.
+		 * The last object link of the peer is moved into position i.
+		 */
+		void unlinkPeerAt(LedgerHandle peer, uint32_t i);
+
+		/**
+		 * Remove the i-th peer link of an object, together with its mirror in the peer's link list.
+		 * The last peer link of the object is moved into position i.
+		 */
+		void unlinkObjectAt(LedgerHandle object, uint32_t i);
+
+		bool isLinked(LedgerHandle peer, LedgerHandle object);
+
+		/**
+		 * Replace the data of an object, e.g. after it was updated, and adjust the bytes stored on every peer it is linked to.
+		 */
+		void setObjectData(LedgerHandle object, const ObjectData &object_data);
+
+		PeerEntry& peer(LedgerHandle handle) { return peers[handle]; }
+		ObjectEntry& object(LedgerHandle handle) { return objects[handle]; }
+
+		unsigned int getNumPeers() { return peers.size(); }
+		unsigned int getNumObjects() { return objects.size(); }
+
+		void clear();
+};
+
+#endif /* LEDGERARENA_H_ */
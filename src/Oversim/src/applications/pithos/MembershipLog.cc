@@ -0,0 +1,144 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#include "MembershipLog.h"
+
+MembershipLog::MembershipLog() {
+	epoch = 0;
+	trimmed_epoch = 0;
+	capacity = 1000;
+}
+
+MembershipLog::~MembershipLog() {
+	clear();
+}
+
+void MembershipLog::setCapacity(unsigned int capacity)
+{
+	if (capacity == 0)
+		opp_error("[MembershipLog]: The membership log should retain at least one change.");
+
+	this->capacity = capacity;
+}
+
+void MembershipLog::setEpoch(unsigned int epoch)
+{
+	if (epoch > this->epoch)
+		this->epoch = epoch;
+}
+
+void MembershipLog::append(MembershipEntry entry)
+{
+	entries.push_back(entry);
+	latest[entry.peerData.getAddress()] = entry;
+
+	//Forget the oldest changes. A peer is only removed from the status map if its forgotten change is also its latest one.
+	while (entries.size() > capacity)
+	{
+		MembershipEntry &oldest = entries.front();
+		StatusMap::iterator latest_it = latest.find(oldest.peerData.getAddress());
+
+		if (latest_it != latest.end() && latest_it->second.epoch == oldest.epoch)
+			latest.erase(latest_it);
+
+		trimmed_epoch = oldest.epoch;
+		entries.pop_front();
+	}
+}
+
+void MembershipLog::record(PeerData peer_data, bool joined)
+{
+	record(peer_data, joined, epoch + 1);
+}
+
+void MembershipLog::record(PeerData peer_data, bool joined, unsigned int at_epoch)
+{
+	if (at_epoch < epoch)
+		opp_error("[MembershipLog]: A membership change cannot be recorded in an earlier epoch.");
+
+	MembershipEntry entry;
+	entry.epoch = at_epoch;
+	entry.peerData = peer_data;
+	entry.joined = joined;
+
+	epoch = at_epoch;
+	append(entry);
+}
+
+bool MembershipLog::apply(PeerData peer_data, bool joined, unsigned int at_epoch)
+{
+	StatusMap::iterator latest_it = latest.find(peer_data.getAddress());
+
+	if (latest_it != latest.end() && latest_it->second.epoch >= at_epoch)
+		return false;
+
+	MembershipEntry entry;
+	entry.epoch = at_epoch;
+	entry.peerData = peer_data;
+	entry.joined = joined;
+
+	setEpoch(at_epoch);
+	append(entry);
+
+	return true;
+}
+
+bool MembershipLog::hasLeft(PeerData peer_data)
+{
+	StatusMap::iterator latest_it = latest.find(peer_data.getAddress());
+
+	return (latest_it != latest.end()) && !latest_it->second.joined;
+}
+
+bool MembershipLog::getDelta(unsigned int since, std::vector<PeerData> &joined, std::vector<PeerData> &left)
+{
+	if (since < trimmed_epoch)
+		return false;
+
+	//Walk back from the latest change, listing every peer only at its latest change
+	for (EntryList::reverse_iterator entry_it = entries.rbegin() ; entry_it != entries.rend() && entry_it->epoch > since ; entry_it++)
+	{
+		StatusMap::iterator latest_it = latest.find(entry_it->peerData.getAddress());
+
+		if (latest_it->second.epoch != entry_it->epoch)
+			continue;
+
+		if (entry_it->joined)
+			joined.push_back(entry_it->peerData);
+		else left.push_back(entry_it->peerData);
+	}
+
+	return true;
+}
+
+void MembershipLog::getLeft(std::vector<PeerData> &left)
+{
+	for (StatusMap::iterator latest_it = latest.begin() ; latest_it != latest.end() ; latest_it++)
+	{
+		if (!latest_it->second.joined)
+			left.push_back(latest_it->second.peerData);
+	}
+}
+
+void MembershipLog::clear()
+{
+	entries.clear();
+	latest.clear();
+	epoch = 0;
+	trimmed_epoch = 0;
+}
@@ -0,0 +1,133 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#ifndef MEMBERSHIPLOG_H_
+#define MEMBERSHIPLOG_H_
+
+#include <omnetpp.h>
+#include <deque>
+#include <vector>
+#include <tr1/unordered_map>
+
+#include <TransportAddress.h>
+
+#include "PeerData.h"
+
+/**
+ * A single membership change, recorded at the epoch in which it happened
+ */
+struct MembershipEntry
+{
+	unsigned int epoch;
+	PeerData peerData;
+	bool joined;	//true if the peer joined the group, false if it left
+};
+
+/**
+ * An epoch-numbered log of the peers that joined and left a group.
+ *
+ * The super peer starts a new epoch for every membership change, so that a group peer only has to be sent the changes
+ * since the last epoch it was informed of. The log is bounded, and the oldest changes are forgotten first. A delta that
+ * reaches back further than the log cannot be computed, in which case the full membership has to be sent instead.
+ *
+ * Group peers keep a log of the changes they were informed of as well, to recognise outdated messages from peers that
+ * have already left the group.
+ *
+ * @author John Gilmore
+ */
+class MembershipLog
+{
+	private:
+		typedef std::deque<MembershipEntry> EntryList;
+		typedef std::tr1::unordered_map<TransportAddress, MembershipEntry, TransportAddress::hashFcn> StatusMap;
+
+		EntryList entries;		/**< All retained changes, in the order of their epochs */
+		StatusMap latest;		/**< The latest retained change of every peer in the log */
+
+		unsigned int epoch;			/**< The current epoch */
+		unsigned int trimmed_epoch;	/**< The epoch of the last change that was forgotten */
+		unsigned int capacity;		/**< The maximum number of changes retained */
+
+		void append(MembershipEntry entry);
+
+	public:
+		MembershipLog();
+		virtual ~MembershipLog();
+
+		/**
+		 * Set the maximum number of changes that are retained.
+		 */
+		void setCapacity(unsigned int capacity);
+
+		unsigned int getEpoch() { return epoch; }
+
+		/**
+		 * Move the log forward to the given epoch. The log never moves back to an earlier epoch.
+		 */
+		void setEpoch(unsigned int epoch);
+
+		/**
+		 * Record a membership change in a new epoch.
+		 *
+		 * @param peer_data The peer that joined or left
+		 * @param joined true if the peer joined the group, false if it left
+		 */
+		void record(PeerData peer_data, bool joined);
+
+		/**
+		 * Record a membership change that happened in the given epoch, as learnt from a delta.
+		 */
+		void record(PeerData peer_data, bool joined, unsigned int at_epoch);
+
+		/**
+		 * Record a membership change that was spread by gossip, and may therefore arrive out of order.
+		 * Changes applied in this way are not ordered by epoch, so the log should not be used to compute deltas.
+		 *
+		 * @return false if a change of the peer in the same or a later epoch is already known, in which case nothing is changed.
+		 */
+		bool apply(PeerData peer_data, bool joined, unsigned int at_epoch);
+
+		/**
+		 * @return true if the latest retained change of the peer is that it left the group.
+		 */
+		bool hasLeft(PeerData peer_data);
+
+		/**
+		 * Compute the net membership changes since the given epoch. Every peer is listed at most once, according to its latest change.
+		 *
+		 * @param since The last epoch the receiver of the delta was informed of
+		 * @param joined The peers that joined since the epoch are appended to this list
+		 * @param left The peers that left since the epoch are appended to this list
+		 * @return false if changes since the epoch have already been forgotten, in which case the lists are not changed.
+		 */
+		bool getDelta(unsigned int since, std::vector<PeerData> &joined, std::vector<PeerData> &left);
+
+		/**
+		 * List the peers whose latest retained change is that they left the group.
+		 *
+		 * @param left The departed peers are appended to this list
+		 */
+		void getLeft(std::vector<PeerData> &left);
+
+		/**
+		 * Forget all changes and return to epoch 0, e.g. when a peer moves to a new group.
+		 */
+		void clear();
+};
+
+#endif /* MEMBERSHIPLOG_H_ */
@@ -0,0 +1,267 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#include <algorithm>
+
+#include "NearCache.h"
+
+//Odd multipliers that spread a key's hash over a different counter in every row of the sketch
+static const uint32_t SKETCH_SEEDS[] = {0x9E3779B1, 0x85EBCA77, 0xC2B2AE3D, 0x27D4EB2F};
+
+NearCache::NearCache() {
+	capacity = 0;
+	window_capacity = 0;
+	protected_capacity = 0;
+
+	bytes[WINDOW] = 0;
+	bytes[PROBATION] = 0;
+	bytes[PROTECTED] = 0;
+
+	sketch.assign(SKETCH_DEPTH * SKETCH_MIN_WIDTH, 0);
+	sketch_mask = SKETCH_MIN_WIDTH - 1;
+	sketch_additions = 0;
+}
+
+NearCache::~NearCache() {
+	clear();
+}
+
+void NearCache::setCapacity(int64_t capacity)
+{
+	if (capacity < 0)
+		opp_error("[NearCache]: The capacity of the near cache cannot be negative.");
+
+	this->capacity = capacity;
+
+	//The window holds 1% of the cache and the protected segment 80% of the remainder, as suggested for W-TinyLFU
+	window_capacity = capacity / 100;
+	protected_capacity = (capacity - window_capacity) * 4 / 5;
+
+	demote();
+	admit(simTime());
+}
+
+void NearCache::touch(CacheEntry &entry)
+{
+	//Move the key to the front of its segment's list without reallocating it
+	lists[entry.segment].splice(lists[entry.segment].begin(), lists[entry.segment], entry.position);
+}
+
+void NearCache::moveTo(const OverlayKey &key, CacheEntry &entry, Segment segment)
+{
+	lists[entry.segment].erase(entry.position);
+	bytes[entry.segment] -= entry.size;
+
+	entry.segment = segment;
+	entry.position = lists[segment].insert(lists[segment].begin(), key);
+	bytes[segment] += entry.size;
+}
+
+void NearCache::erase(EntryMap::iterator it)
+{
+	lists[it->second.segment].erase(it->second.position);
+	bytes[it->second.segment] -= it->second.size;
+	entries.erase(it);
+}
+
+void NearCache::demote()
+{
+	while (bytes[PROTECTED] > protected_capacity)
+	{
+		OverlayKey key = lists[PROTECTED].back();
+		moveTo(key, entries.find(key)->second, PROBATION);
+	}
+}
+
+void NearCache::admit(simtime_t now)
+{
+	int64_t main_capacity = capacity - window_capacity;
+
+	while (bytes[WINDOW] > window_capacity)
+	{
+		EntryMap::iterator candidate = entries.find(lists[WINDOW].back());
+		bool admitted = true;
+		bool contested = false;
+
+		while (bytes[PROBATION] + bytes[PROTECTED] + candidate->second.size > main_capacity)
+		{
+			//Probation holds the objects that were hit least recently, so victims are taken from there first
+			Segment victim_segment = lists[PROBATION].empty() ? PROTECTED : PROBATION;
+
+			//The candidate does not fit into an empty main cache
+			if (lists[victim_segment].empty())
+			{
+				admitted = false;
+				break;
+			}
+
+			EntryMap::iterator victim = entries.find(lists[victim_segment].back());
+
+			//Only the first live victim has to be outvoted. A large candidate that wins may push out several objects.
+			if (!contested && victim->second.expiry >= now)
+			{
+				if (frequency(candidate->first) <= frequency(victim->first))
+				{
+					admitted = false;
+					break;
+				}
+
+				contested = true;
+			}
+
+			erase(victim);
+		}
+
+		if (admitted)
+			moveTo(candidate->first, candidate->second, PROBATION);
+		else erase(candidate);
+	}
+}
+
+size_t NearCache::sketchIndex(size_t hash, unsigned int row)
+{
+	uint32_t h = ((uint32_t)hash ^ (uint32_t)(hash >> 16)) * SKETCH_SEEDS[row];
+	h ^= h >> 15;
+
+	return row * (sketch_mask + 1) + (h & sketch_mask);
+}
+
+void NearCache::increment(const OverlayKey &key)
+{
+	size_t hash = OverlayKey::hashFcn()(key);
+
+	for (unsigned int row = 0 ; row < SKETCH_DEPTH ; row++)
+	{
+		uint8_t &counter = sketch[sketchIndex(hash, row)];
+
+		if (counter < SKETCH_MAX)
+			counter++;
+	}
+
+	//Halve all counters periodically, so that the sketch follows changes in popularity
+	if (++sketch_additions >= 10 * (sketch_mask + 1))
+	{
+		for (unsigned int i = 0 ; i < sketch.size() ; i++)
+			sketch[i] >>= 1;
+
+		sketch_additions /= 2;
+	}
+}
+
+unsigned int NearCache::frequency(const OverlayKey &key)
+{
+	size_t hash = OverlayKey::hashFcn()(key);
+	unsigned int estimate = SKETCH_MAX;
+
+	//Collisions only ever add to a counter, so the smallest counter is the best estimate
+	for (unsigned int row = 0 ; row < SKETCH_DEPTH ; row++)
+		estimate = std::min(estimate, (unsigned int)sketch[sketchIndex(hash, row)]);
+
+	return estimate;
+}
+
+void NearCache::resizeSketch()
+{
+	unsigned int width = sketch_mask + 1;
+
+	if (entries.size() <= width)
+		return;
+
+	while (width < entries.size())
+		width <<= 1;
+
+	sketch.assign(SKETCH_DEPTH * width, 0);
+	sketch_mask = width - 1;
+	sketch_additions = 0;
+}
+
+bool NearCache::get(const OverlayKey &key, simtime_t now, BinaryValue &value, simtime_t &fetched)
+{
+	increment(key);
+
+	EntryMap::iterator it = entries.find(key);
+
+	if (it == entries.end())
+		return false;
+
+	CacheEntry &entry = it->second;
+
+	if (entry.expiry < now)
+	{
+		erase(it);
+		return false;
+	}
+
+	if (entry.segment == PROBATION)
+	{
+		moveTo(key, entry, PROTECTED);
+		demote();
+	} else touch(entry);
+
+	value = entry.value;
+	fetched = entry.fetched;
+
+	return true;
+}
+
+bool NearCache::put(const OverlayKey &key, const BinaryValue &value, int64_t size, simtime_t now, simtime_t expiry)
+{
+	remove(key);
+
+	if (size > capacity - window_capacity || expiry < now)
+		return false;
+
+	CacheEntry entry;
+	entry.value = value;
+	entry.size = size;
+	entry.fetched = now;
+	entry.expiry = expiry;
+	entry.segment = WINDOW;
+
+	CacheEntry &inserted = entries.insert(std::make_pair(key, entry)).first->second;
+	inserted.position = lists[WINDOW].insert(lists[WINDOW].begin(), key);
+	bytes[WINDOW] += size;
+
+	resizeSketch();
+	admit(now);
+
+	return contains(key);
+}
+
+bool NearCache::remove(const OverlayKey &key)
+{
+	EntryMap::iterator it = entries.find(key);
+
+	if (it == entries.end())
+		return false;
+
+	erase(it);
+
+	return true;
+}
+
+void NearCache::clear()
+{
+	entries.clear();
+
+	for (unsigned int i = 0 ; i < 3 ; i++)
+	{
+		lists[i].clear();
+		bytes[i] = 0;
+	}
+}
@@ -0,0 +1,158 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#ifndef NEARCACHE_H_
+#define NEARCACHE_H_
+
+#include <omnetpp.h>
+#include <list>
+#include <vector>
+#include <tr1/unordered_map>
+
+#include <OverlayKey.h>
+#include <BinaryValue.h>
+
+/**
+ * A bounded cache of objects that were fetched from the overlay, sized in bytes.
+ *
+ * Admission and eviction follow W-TinyLFU: new objects enter a small LRU window, and an object that falls out of the
+ * window only replaces the main cache's victim if it has been requested more often, according to a count-min sketch
+ * of recent request frequencies. The main cache is a segmented LRU, in which objects that were hit while on probation
+ * are promoted to the protected segment. A single scan over many keys can therefore only flush the window, not the
+ * objects that are read over and over.
+ *
+ * Every object carries the time at which it expires, and an expired object is never returned.
+ *
+ * @author John Gilmore
+ */
+class NearCache
+{
+	private:
+		enum Segment
+		{
+			WINDOW,
+			PROBATION,
+			PROTECTED
+		};
+
+		typedef std::list<OverlayKey> KeyList;
+
+		struct CacheEntry
+		{
+			BinaryValue value;
+			int64_t size;			//The number of bytes the object is charged in the cache
+			simtime_t fetched;		//The time at which the object was fetched
+			simtime_t expiry;		//The time after which the object may no longer be returned
+			Segment segment;
+			KeyList::iterator position;	//The position of the key in its segment's LRU list
+		};
+
+		typedef std::tr1::unordered_map<OverlayKey, CacheEntry, OverlayKey::hashFcn> EntryMap;
+
+		static const unsigned int SKETCH_DEPTH = 4;
+		static const uint8_t SKETCH_MAX = 15;
+		static const unsigned int SKETCH_MIN_WIDTH = 64;
+
+		EntryMap entries;
+
+		KeyList lists[3];		/**< The LRU list of every segment, with the most recently used key in front */
+		int64_t bytes[3];		/**< The total size of the objects in every segment */
+
+		int64_t capacity;		/**< The maximum total size of all cached objects */
+		int64_t window_capacity;	/**< The maximum size of the admission window */
+		int64_t protected_capacity;	/**< The maximum size of the protected segment */
+
+		std::vector<uint8_t> sketch;	/**< SKETCH_DEPTH rows of saturating frequency counters */
+		unsigned int sketch_mask;		/**< The width of a sketch row minus one */
+		unsigned int sketch_additions;	/**< The number of increments since the counters were last halved */
+
+		void touch(CacheEntry &entry);
+		void moveTo(const OverlayKey &key, CacheEntry &entry, Segment segment);
+		void erase(EntryMap::iterator it);
+
+		/**
+		 * Move objects from the window into the main cache while the window is over its budget, evicting either the
+		 * window's candidate or the main cache's victim, whichever has been requested less often. Expired victims are
+		 * always evicted.
+		 */
+		void admit(simtime_t now);
+
+		/**
+		 * Demote the least recently used protected objects to probation while the protected segment is over its budget.
+		 */
+		void demote();
+
+		size_t sketchIndex(size_t hash, unsigned int row);
+		void increment(const OverlayKey &key);
+		unsigned int frequency(const OverlayKey &key);
+
+		/**
+		 * Grow the sketch so that a row has at least as many counters as there are cached objects.
+		 * Counters are reset when the sketch grows.
+		 */
+		void resizeSketch();
+
+	public:
+		NearCache();
+		virtual ~NearCache();
+
+		/**
+		 * Sets the maximum number of bytes held by the cache. Objects are evicted if the cache is already larger.
+		 */
+		void setCapacity(int64_t capacity);
+
+		/**
+		 * Look up an object and record the request in the frequency sketch. An expired object is removed and not returned.
+		 *
+		 * @param key The key of the requested object
+		 * @param now The current simulation time
+		 * @param value Set to the cached object on a hit
+		 * @param fetched Set to the time at which the cached object was fetched on a hit
+		 * @return true if a fresh object was found
+		 */
+		bool get(const OverlayKey &key, simtime_t now, BinaryValue &value, simtime_t &fetched);
+
+		/**
+		 * Insert or replace an object. Objects that do not fit into the main cache are not cached.
+		 *
+		 * @param key The key of the object
+		 * @param value The object, as stored in the overlay
+		 * @param size The number of bytes the object is charged in the cache
+		 * @param now The current simulation time
+		 * @param expiry The time after which the object may no longer be returned
+		 * @return true if the object was cached
+		 */
+		bool put(const OverlayKey &key, const BinaryValue &value, int64_t size, simtime_t now, simtime_t expiry);
+
+		/**
+		 * Remove an object, for instance because it has been overwritten.
+		 *
+		 * @return true if the object was cached
+		 */
+		bool remove(const OverlayKey &key);
+
+		bool contains(const OverlayKey &key) { return entries.find(key) != entries.end(); }
+
+		int64_t getBytes() { return bytes[WINDOW] + bytes[PROBATION] + bytes[PROTECTED]; }
+		int64_t getCapacity() { return capacity; }
+		unsigned int size() { return entries.size(); }
+
+		void clear();
+};
+
+#endif /* NEARCACHE_H_ */
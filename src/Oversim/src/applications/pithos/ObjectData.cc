@@ -25,6 +25,7 @@ ObjectData::ObjectData(std::string name, int siz, OverlayKey k, simtime_t time,
 	creationTime = time;
 	ttl = t;
 	init_group_size = group_size;
+	version = 0;
 }
 
 ObjectData::ObjectData(const GameObject& go, int group_size)
@@ -32,9 +33,11 @@ ObjectData::ObjectData(const GameObject& go, int group_size)
 	object_name = go.getObjectName();
 	size = go.getSize();
 	key = go.getNameHash();
+	payloadHash = go.getPayloadHash();
 	creationTime = go.getCreationTime();
 	ttl = go.getTTL();
 	init_group_size = group_size;
+	version = go.getVersion();
 }
 
 ObjectData::ObjectData(const ObjectData& other)
@@ -54,9 +57,11 @@ ObjectData& ObjectData::operator=(const ObjectData& other)
 	object_name = other.object_name;
 	size = other.size;
 	key = other.key;
+	payloadHash = other.payloadHash;
 	creationTime = other.creationTime;
 	ttl = other.ttl;
 	init_group_size = other.init_group_size;
+	version = other.version;
 
 	return *this;
 }
@@ -131,6 +136,16 @@ OverlayKey ObjectData::getKey()
 	return key;
 }
 
+void ObjectData::setPayloadHash(const OverlayKey &hash)
+{
+	payloadHash = hash;
+}
+
+OverlayKey ObjectData::getPayloadHash()
+{
+	return payloadHash;
+}
+
 void ObjectData::setCreationTime(simtime_t time)
 {
 	creationTime = time;
@@ -151,6 +166,27 @@ int ObjectData::getTTL()
 	return ttl;
 }
 
+void ObjectData::setVersion(unsigned int ver)
+{
+	version = ver;
+}
+
+unsigned int ObjectData::getVersion()
+{
+	return version;
+}
+
+bool ObjectData::supersedes(const ObjectData& other) const
+{
+	if (creationTime != other.creationTime)
+		return creationTime > other.creationTime;
+
+	if (version != other.version)
+		return version > other.version;
+
+	return other.payloadHash < payloadHash;
+}
+
 bool ObjectData::isUnspecified()
 {
 	return (*this == ObjectData::UNSPECIFIED_OBJECT);
@@ -33,7 +33,8 @@ class ObjectData;
  */
 typedef std::tr1::shared_ptr <ObjectData> ObjectDataPtr;
 
-#define OBJECTDATA_SIZE 8+4+sizeof(OverlayKey)+sizeof(simtime_t)+4+4	//Object name ID (8B), size (4B), key, creation time (4B), ttl (4B), init group size (4B)
+#define OBJECTDATA_SIZE (8+4+sizeof(OverlayKey)+sizeof(simtime_t)+4+4+4)	//Object name ID (8B), size (4B), key, creation time (4B), ttl (4B), init group size (4B), version (4B)
+#define PAYLOADHASH_SIZE 20	//SHA-1 payload hash, only sent with objects that are deduplicated
 
 class ObjectData
 {
@@ -45,11 +46,13 @@ private:
 	int size;
 
 	OverlayKey key;
+	OverlayKey payloadHash;	/**< The hash of the object's data, which identifies its content blob in deduplicated storage */
 
 	simtime_t creationTime; /**< The time when the object was created */
 	int init_group_size;	/**< The initial group size, when the object was inserted */
 
 	int ttl;				/**< The time-to-live of the object */
+	unsigned int version;	/**< The number of times the object has been updated */
 
 	friend std::ostream& operator<<(std::ostream& Stream, const ObjectData object_data);
 
@@ -99,10 +102,24 @@ public:
 
 	OverlayKey getKey();
 
+	void setPayloadHash(const OverlayKey &hash);
+
+	OverlayKey getPayloadHash();
+
 	void setCreationTime(simtime_t time);
 	simtime_t getCreationTime();
 	void setTTL(int t);
 	int getTTL();
+	void setVersion(unsigned int ver);
+	unsigned int getVersion();
+
+	/**
+	 * A new PUT replaces an object, while updates keep its creation time, so the creation time is compared before the
+	 * version. Concurrent updates of the same version are resolved by the payload hash, as group storage does.
+	 *
+	 * @return true if this describes a later PUT or update of the same object than other
+	 */
+	bool supersedes(const ObjectData& other) const;
 
 	bool isUnspecified();
 };
@@ -16,58 +16,44 @@
 #include "ObjectLedger.h"
 
 ObjectLedger::ObjectLedger() {
-	replications = 0;
-	repairs = 0;
+	arena = NULL;
+	handle = LedgerArena::NULL_HANDLE;
+	objectDataPtr = NULL;
+}
+
+ObjectLedger::ObjectLedger(LedgerArena *arena, LedgerHandle handle) {
+	this->arena = arena;
+	this->handle = handle;
+	objectDataPtr = &(arena->object(handle).objectData);
 }
 
 ObjectLedger::~ObjectLedger() {
-	location_list.clear();
 }
 
-void ObjectLedger::addPeerRef(PeerDataPtr peer_data_ptr)
+LedgerHandle ObjectLedger::getHandle()
 {
-	if (!isPeerPresent(*peer_data_ptr))
-	{
-		PeerDataPtr ptr(peer_data_ptr);
-		location_list.push_back(ptr);
-	} /*else {
-
-		std::vector<PeerDataPtr>::iterator it;
-
-		for (it = location_list.begin() ; it != location_list.end() ; it++)
-		{
-			std::cout << "Address: " << (*it)->getAddress() << endl;
-		}
-
-		opp_error("[ObjectLedger]: Peer not found for insertion.");
-	}*/
-
-	//Record how many times an object was replicated
-	replications++;
-
-	/*if (replications > objectDataPtr->getInitGroupSize())
-		std::cout << "More replicas stored than recorded initial group size.\n";*/
+	return handle;
 }
 
-PeerDataPtr ObjectLedger::getPeerRef(const int &i)
+PeerData *ObjectLedger::getPeerRef(const int &i)
 {
-	return location_list.at(i);
+	return &(arena->peer(arena->object(handle).links.at(i).handle).peerData);
 }
 
-PeerDataPtr ObjectLedger::getRandPeerRef()
+PeerData *ObjectLedger::getRandPeerRef()
 {
-	int index = intuniform(0, location_list.size()-1);
-	return location_list.at(index);
+	int index = intuniform(0, getPeerListSize()-1);
+	return getPeerRef(index);
 }
 
 bool ObjectLedger::isPeerPresent(PeerData peer_data)
 {
-	std::vector<PeerDataPtr>::iterator list_ptr;
+	LedgerLinkList &links = arena->object(handle).links;
 
-	for (list_ptr = location_list.begin() ; list_ptr != location_list.end() ; list_ptr++)
+	for (unsigned int i = 0 ; i < links.size() ; i++)
 	{
 		//This checks whether the PeerData object have the same values
-		if (**list_ptr == peer_data)
+		if (arena->peer(links[i].handle).peerData == peer_data)
 			return true;
 	}
 
@@ -76,49 +62,30 @@ bool ObjectLedger::isPeerPresent(PeerData peer_data)
 
 unsigned int ObjectLedger::getPeerListSize()
 {
-	return location_list.size();
-}
-
-void ObjectLedger::erasePeerRef(const int &i)
-{
-	location_list.erase(location_list.begin()+i);
-}
-
-void ObjectLedger::erasePeerRef(PeerDataPtr peer_data_ptr)
-{
-	for (unsigned int i = 0 ; i < location_list.size() ; i++)
-	{
-		if (peer_data_ptr == location_list.at(i))
-		{
-			location_list.erase(location_list.begin()+i);
-			return;
-		}
-	}
-
-	opp_error("Peer pointer not found when erasing.");
+	return arena->object(handle).links.size();
 }
 
 void ObjectLedger::resetReplications()
 {
-	replications = 0;
+	arena->object(handle).replications = 0;
 }
 
 int ObjectLedger::getReplications()
 {
-	return replications;
+	return arena->object(handle).replications;
 }
 
 void ObjectLedger::resetRepairs()
 {
-	repairs = 0;
+	arena->object(handle).repairs = 0;
 }
 
 int ObjectLedger::getRepairs()
 {
-	return repairs;
+	return arena->object(handle).repairs;
 }
 
 void ObjectLedger::addRepairs(int adds)
 {
-	repairs += adds;
+	arena->object(handle).repairs += adds;
 }
@@ -26,61 +26,51 @@
 
 #include "PeerData.h"
 #include "ObjectData.h"
+#include "LedgerArena.h"
 
 /**
- * This class stores the information of a single object, including name,
+ * This class gives access to the information of a single object, including name,
  * size and a list of peers that store the object. The class is used by
- * super peers as part of a vector to keep track of which game objects
+ * super peers as part of a map to keep track of which game objects
  * reside where in the group.
  *
+ * The object information itself is stored in the group ledger's arena. This class only
+ * refers to it by handle, so it can be copied cheaply.
+ *
  * @author John Gilmore
  */
 class ObjectLedger
 {
 	private:
 
-		/**
-		 * A list of peers this object is stored in, in the group.
-		 * A shared_ptr smart pointer is used, because this list is a list of pointers to the vector that stored the actual peer information. Pointers are used,
-		 * because multiple objects will contain sets of overlapping peers, which would create duplicate information.
-		 * Smart pointers are used, because a std::vector's memory addresses may change when more memory is required for an insert.
-		 * Smart pointers ensure that the memory region which is pointed too will always be available.
-		 */
-		std::vector<PeerDataPtr> location_list;
-
-		//Records the number of times an object has been stored (object removals do not subtract from this number)
-		int replications;
-		int repairs;
+		LedgerArena *arena;		/**< The arena in which the object entry is stored */
+		LedgerHandle handle;	/**< The handle of the object entry in the arena */
 
 	public:
 
-		ObjectDataPtr objectDataPtr;
+		/**
+		 * Points to the object data in the arena. The arena never moves its entries,
+		 * so the pointer is valid for as long as the object is recorded in the ledger.
+		 */
+		ObjectData *objectDataPtr;
 
 		ObjectLedger();
+		ObjectLedger(LedgerArena *arena, LedgerHandle handle);
 		virtual ~ObjectLedger();
 
-		/**
-		 * Add a peer data item to the list of object locations
-		 *
-		 * @param peer_data_ptr A smart pointer to a peer data object, containing the peer's transport address
-		 */
-		void addPeerRef(PeerDataPtr peer_data_ptr);
+		LedgerHandle getHandle();
 
-		PeerDataPtr getPeerRef(const int &i);
+		PeerData *getPeerRef(const int &i);
 
 		/**
-		 * @returns a random address from the list of object locations
+		 * @returns a random peer from the list of object locations
 		 */
-		PeerDataPtr getRandPeerRef();
+		PeerData *getRandPeerRef();
 
 		unsigned int getPeerListSize();
 
 		bool isPeerPresent(PeerData peer_data);
 
-		void erasePeerRef(const int &i);
-
-		void erasePeerRef(PeerDataPtr peer_data_ptr);
-
 		void resetReplications();
 		int getReplications();
 		void resetRepairs();
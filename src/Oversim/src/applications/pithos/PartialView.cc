@@ -0,0 +1,109 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#include <algorithm>
+
+#include "PartialView.h"
+
+PartialView::PartialView() {
+	capacity = 8;
+}
+
+PartialView::~PartialView() {
+
+}
+
+void PartialView::setCapacity(unsigned int capacity)
+{
+	if (capacity == 0)
+		opp_error("[PartialView]: The view of a partially connected group should contain at least one peer.");
+
+	this->capacity = capacity;
+}
+
+int PartialView::find(const TransportAddress &address)
+{
+	//Views are small, so a linear search is cheaper than maintaining an index
+	for (unsigned int i = 0 ; i < peers.size() ; i++)
+	{
+		if (peers[i].getAddress() == address)
+			return i;
+	}
+
+	return -1;
+}
+
+bool PartialView::insert(PeerData peer_data)
+{
+	if (find(peer_data.getAddress()) >= 0)
+		return false;
+
+	if (peers.size() >= capacity)
+		peers[intuniform(0, peers.size()-1)] = peer_data;
+	else peers.push_back(peer_data);
+
+	return true;
+}
+
+void PartialView::remove(PeerData peer_data)
+{
+	int i = find(peer_data.getAddress());
+
+	if (i < 0)
+		return;
+
+	peers[i] = peers.back();
+	peers.pop_back();
+}
+
+bool PartialView::contains(PeerData peer_data)
+{
+	return find(peer_data.getAddress()) >= 0;
+}
+
+PeerData PartialView::getRandomPeer(const TransportAddress &exclude)
+{
+	int excluded = find(exclude);
+	int choices = peers.size() - ((excluded >= 0) ? 1 : 0);
+
+	if (choices <= 0)
+		return PeerData();
+
+	//Draw from the peers other than the excluded one, by skipping over its position
+	int i = intuniform(0, choices-1);
+	if (excluded >= 0 && i >= excluded)
+		i++;
+
+	return peers[i];
+}
+
+void PartialView::getSample(unsigned int n, std::vector<PeerData> &sample)
+{
+	std::vector<PeerData> shuffled(peers);
+
+	if (n > shuffled.size())
+		n = shuffled.size();
+
+	//A partial Fisher-Yates shuffle of the first n positions
+	for (unsigned int i = 0 ; i < n ; i++)
+	{
+		unsigned int j = intuniform(i, shuffled.size()-1);
+		std::swap(shuffled[i], shuffled[j]);
+		sample.push_back(shuffled[i]);
+	}
+}
@@ -0,0 +1,83 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#ifndef PARTIALVIEW_H_
+#define PARTIALVIEW_H_
+
+#include <omnetpp.h>
+#include <vector>
+
+#include <TransportAddress.h>
+
+#include "PeerData.h"
+
+/**
+ * A bounded random view of the peers in a group.
+ *
+ * In a partially connected group, a peer only exchanges gossip with, and routes requests through, the peers in its view.
+ * When a peer is inserted into a full view, a random peer is evicted, so that the view remains a random sample of the
+ * peers this peer has heard of.
+ *
+ * @author John Gilmore
+ */
+class PartialView
+{
+	private:
+		std::vector<PeerData> peers;
+		unsigned int capacity;
+
+		int find(const TransportAddress &address);
+
+	public:
+		PartialView();
+		virtual ~PartialView();
+
+		void setCapacity(unsigned int capacity);
+
+		/**
+		 * Insert a peer into the view. If the view is full, a random peer is evicted to make room.
+		 *
+		 * @return false if the peer was already in the view
+		 */
+		bool insert(PeerData peer_data);
+
+		void remove(PeerData peer_data);
+
+		bool contains(PeerData peer_data);
+
+		/**
+		 * @param exclude A peer that should not be returned, e.g. the peer a request was received from
+		 * @return a random peer in the view, or unspecified peer data if the view contains no other peers.
+		 */
+		PeerData getRandomPeer(const TransportAddress &exclude = TransportAddress::UNSPECIFIED_NODE);
+
+		/**
+		 * Append a random sample of the view to a list.
+		 *
+		 * @param n The maximum number of peers in the sample
+		 * @param sample The list the sample is appended to
+		 */
+		void getSample(unsigned int n, std::vector<PeerData> &sample);
+
+		unsigned int size() { return peers.size(); }
+		bool empty() { return peers.empty(); }
+
+		void clear() { peers.clear(); }
+};
+
+#endif /* PARTIALVIEW_H_ */
@@ -17,6 +17,7 @@
 //
 
 #include "Peer_logic.h"
+#include "GroupLedger.h"
 
 Define_Module(Peer_logic);
 
@@ -31,9 +32,23 @@ Peer_logic::~Peer_logic()
     for (it = pendingRpcs.begin(); it != pendingRpcs.end(); it++) {
         delete(it->second.putCallMsg);
         delete(it->second.getCallMsg);
+        for (unsigned int i = 0 ; i < it->second.coalescedCalls.size() ; i++)
+            delete(it->second.coalescedCalls[i]);
+        delete(it->second.modCallMsg);
     }
 
     pendingRpcs.clear();
+
+    PendingBatches::iterator batch_it;
+
+    for (batch_it = pendingBatches.begin(); batch_it != pendingBatches.end(); batch_it++) {
+        delete(batch_it->second.getCallMsg);
+        delete(batch_it->second.putCallMsg);
+        delete(batch_it->second.getRespMsg);
+        delete(batch_it->second.putRespMsg);
+    }
+
+    pendingBatches.clear();
 }
 
 void Peer_logic::initialize()
@@ -42,6 +57,15 @@ void Peer_logic::initialize()
 
 	appBytesSent = 0;
 	appBytesReceived = 0;
+	numObjectsDisagreeing = 0;
+	numGetsReceived = 0;
+	numGetsCoalesced = 0;
+	numBatchesReceived = 0;
+	numBatchKeysReceived = 0;
+	nextLocalRpcid = 0;
+
+	cModule *groupLedgerModule = getParentModule()->getSubmodule("group_ledger");
+	group_ledger = check_and_cast<GroupLedger *>(groupLedgerModule);
 
 	replicas = par("replicas");
 	numGetRequests = par("numGetRequests");
@@ -61,6 +85,27 @@ void Peer_logic::initialize()
 	else if (getType == "safe")
 		fastGet = false;
 	else error("Unknown get type specified.");
+
+	//The GET responses that group storage sends depend on its own settings, so they are read from it
+	cModule *group_storage = getParentModule()->getSubmodule("group_storage");
+	if (group_storage == NULL)
+		error("Peer logic requires a group storage module in the same node.");
+
+	hashVoting = group_storage->par("hashVoting");
+	coalesceGets = par("coalesceGets");
+
+	//Hedged and erasure coded group storage report only the first successful response, or a single failure
+	//Hash voted group storage also reports a single response, but its object has already been compared
+	if (hashVoting)
+		numGroupGetResponses = 1;
+	else if (group_storage->par("hedgedGets").boolValue() || (strcmp(group_storage->par("redundancy"), "erasure") == 0))
+	{
+		numGroupGetResponses = 1;
+
+		if (!fastGet && (numGetCompares > (disableDHT ? 1 : 2)))
+			error("Hedged and erasure coded GET requests return a single group object, which is too few to compare for safe retrieval.");
+	}
+	else numGroupGetResponses = numGetRequests;
 }
 
 void Peer_logic::finish()
@@ -78,22 +123,28 @@ void Peer_logic::finish()
 	{
 		globalStatistics->addStdDev("Pithos: Bytes sent to higher layer/s", appBytesSent / time);
 		globalStatistics->addStdDev("Pithos: Bytes received from higher layer/s", appBytesReceived / time);
+		globalStatistics->addStdDev("Pithos: Group objects disagreeing with the picked object/s", numObjectsDisagreeing / time);
+
+		if (coalesceGets)
+		{
+			globalStatistics->addStdDev("Pithos: GET requests coalesced/s", numGetsCoalesced / time);
+
+			if (numGetsReceived > 0)
+				globalStatistics->addStdDev("Pithos: GET coalescing ratio", (double)numGetsCoalesced / numGetsReceived);
+		}
+
+		if (numBatchesReceived > 0)
+			globalStatistics->addStdDev("Pithos: Keys per batch request", (double)numBatchKeysReceived / numBatchesReceived);
 	}
 }
 
-void Peer_logic::handleGetCAPIRequest(RootObjectGetCAPICall* capiGetMsg)
+OverlayKeyPkt *Peer_logic::createRetrievePkt(const char *name, const OverlayKey &key, uint32_t rpcid, simtime_t request_time)
 {
-	OverlayKeyPkt *read_pkt;
-	Enter_Method("[Peer_logic]: handleGetCAPIRequest()");	//Required for Omnet++ context switching between modules
-	take(capiGetMsg);
-
 	const NodeHandle *thisNode = &(((BaseApp *)getParentModule()->getSubmodule("communicator"))->getThisNode());
 	TransportAddress address(thisNode->getIp(), thisNode->getPort());
 
-	EV << getParentModule()->getName() << " " << getParentModule()->getIndex() << " received storage request for overlay key " << capiGetMsg->getKey() << "\n";
-
-	read_pkt = new OverlayKeyPkt();
-	read_pkt->setName(capiGetMsg->getName());
+	OverlayKeyPkt *read_pkt = new OverlayKeyPkt();
+	read_pkt->setName(name);
 	read_pkt->setPayloadType(RETRIEVE_REQ);
 	read_pkt->setByteLength(OVERLAYKEY_PKT_SIZE);
 
@@ -101,17 +152,66 @@ void Peer_logic::handleGetCAPIRequest(RootObjectGetCAPICall* capiGetMsg)
 	read_pkt->setSourceAddress(address);
 	read_pkt->setDestinationAddress(address);
 
-	//This is the RPC ID of capiPutMsg and will be added to the response msg which the
+	//This is the RPC ID of the call and will be added to the response msg which the
 	//peer logic can then use to match the received response to the relevant RPC call.
-	read_pkt->setValue(capiGetMsg->getNonce());
-	read_pkt->setKey(capiGetMsg->getKey());
+	read_pkt->setValue(rpcid);
+	read_pkt->setKey(key);
 
-	read_pkt->setTimestamp(capiGetMsg->getCreationTime()); //Record the creation time of the original request.
-
-	//std::cout << "[Peer_logic] Retrieving object with key: " << capiGetMsg->getKey() << endl;
+	read_pkt->setTimestamp(request_time); //Record the creation time of the original request.
 
 	read_pkt->setHops(0);
 
+	return read_pkt;
+}
+
+ValuePkt *Peer_logic::createStorePkt(const char *name, GameObject *go, uint32_t rpcid, simtime_t request_time)
+{
+	ValuePkt *write_pkt = new ValuePkt();
+	write_pkt->setName(name);
+	write_pkt->setPayloadType(STORE_REQ);
+	write_pkt->addObject(go);
+
+	//This is the RPC ID of the call and will be added to the response msg which the
+	//peer logic can then use to match the received response to the relevant RPC call.
+	write_pkt->setValue(rpcid);
+
+	write_pkt->setTimestamp(request_time); //Record the creation time of the original request.
+
+	return write_pkt;
+}
+
+void Peer_logic::handleGetCAPIRequest(RootObjectGetCAPICall* capiGetMsg)
+{
+	OverlayKeyPkt *read_pkt;
+	Enter_Method("[Peer_logic]: handleGetCAPIRequest()");	//Required for Omnet++ context switching between modules
+	take(capiGetMsg);
+
+	EV << getParentModule()->getName() << " " << getParentModule()->getIndex() << " received storage request for overlay key " << capiGetMsg->getKey() << "\n";
+
+	RECORD_STATS(numGetsReceived++);
+
+	uint32_t rpcid = createRpcid(capiGetMsg->getNonce());
+
+	if (coalesceGets)
+	{
+		InFlightGets::iterator inflight_it = inFlightGets.find(capiGetMsg->getKey());
+		PendingRpcs::iterator pending_it;
+
+		//The key is already being retrieved, so this request completes with the pending request's response
+		if ((inflight_it != inFlightGets.end()) && ((pending_it = pendingRpcs.find(inflight_it->second)) != pendingRpcs.end()))
+		{
+			pending_it->second.coalescedCalls.push_back(capiGetMsg);
+			RECORD_STATS(numGetsCoalesced++);
+			return;
+		}
+
+		inFlightGets[capiGetMsg->getKey()] = rpcid;
+	}
+
+	read_pkt = createRetrievePkt(capiGetMsg->getName(), capiGetMsg->getKey(), rpcid, capiGetMsg->getCreationTime());
+
+	//std::cout << "[Peer_logic] Retrieving object with key: " << capiGetMsg->getKey() << endl;
+
 	//Send the game object to be stored in the group.
 	send(read_pkt->dup(), "group_write");
 
@@ -122,8 +222,8 @@ void Peer_logic::handleGetCAPIRequest(RootObjectGetCAPICall* capiGetMsg)
 
     PendingRpcsEntry entry;
     entry.getCallMsg = capiGetMsg;
-    entry.numSent = numGetRequests;
-    pendingRpcs.insert(std::make_pair(capiGetMsg->getNonce(), entry));
+    entry.numSent = numGroupGetResponses;
+    pendingRpcs.insert(std::make_pair(rpcid, entry));
 }
 
 void Peer_logic::handlePutCAPIRequest(RootObjectPutCAPICall* capiPutMsg)
@@ -139,18 +239,13 @@ void Peer_logic::handlePutCAPIRequest(RootObjectPutCAPICall* capiPutMsg)
 	//Record the application layer data received, to later be able to calculate overhead.
 	RECORD_STATS(appBytesReceived += go->getSize());
 
-	//std::cout << "[Peer_logic] Storing object with key " << go->getHash() << endl;
-
-	write_pkt = new ValuePkt();
-	write_pkt->setName(capiPutMsg->getName());
-	write_pkt->setPayloadType(STORE_REQ);
-	write_pkt->addObject(go);
+	//A GET that is already in flight may return the old object, so later GETs for the key are not coalesced with it
+	inFlightGets.erase(go->getNameHash());
 
-	//This is the RPC ID of capiPutMsg and will be added to the response msg which the
-	//peer logic can then use to match the received response to the relevant RPC call.
-	write_pkt->setValue(capiPutMsg->getNonce());
+	//std::cout << "[Peer_logic] Storing object with key " << go->getHash() << endl;
 
-	write_pkt->setTimestamp(capiPutMsg->getCreationTime()); //Record the creation time of the original request.
+	uint32_t rpcid = createRpcid(capiPutMsg->getNonce());
+	write_pkt = createStorePkt(capiPutMsg->getName(), go, rpcid, capiPutMsg->getCreationTime());
 
 	//Send the game object to be stored in the group.
 	send(write_pkt->dup(), "group_write");
@@ -169,7 +264,255 @@ void Peer_logic::handlePutCAPIRequest(RootObjectPutCAPICall* capiPutMsg)
 	}
 
 	//Add the received RPC to the list of RPC for which responses are still outstanding
-	pendingRpcs.insert(std::make_pair(capiPutMsg->getNonce(), entry));
+	pendingRpcs.insert(std::make_pair(rpcid, entry));
+}
+
+void Peer_logic::handleModCAPIRequest(RootObjectModCAPICall* capiModMsg)
+{
+	UpdatePkt *update_pkt;
+	ValuePkt *write_pkt;
+	Enter_Method("[Peer_logic]: handleModCAPIRequest()");	//Required for Omnet++ context switching between modules
+	take(capiModMsg);
+
+	GameObject *go = (GameObject *)capiModMsg->removeObject("GameObject");
+	if (go == NULL)
+		error("No object was attached to be updated in group storage");
+
+	//Only the changed bytes are received from the application layer
+	RECORD_STATS(appBytesReceived += capiModMsg->getDeltaSize());
+
+	//A GET that is already in flight may return the old object, so later GETs for the key are not coalesced with it
+	inFlightGets.erase(go->getNameHash());
+
+	uint32_t rpcid = createRpcid(capiModMsg->getNonce());
+
+	update_pkt = new UpdatePkt();
+	update_pkt->setName(capiModMsg->getName());
+	update_pkt->setPayloadType(MODIFY_REQ);
+	update_pkt->setDeltaSize(capiModMsg->getDeltaSize());
+	update_pkt->addObject(go->dup());
+
+	//This is the RPC ID of capiModMsg and will be added to the response msg which the
+	//peer logic can then use to match the received response to the relevant RPC call.
+	update_pkt->setValue(rpcid);
+	update_pkt->setTimestamp(capiModMsg->getCreationTime()); //Record the creation time of the original request.
+
+	//Group storage sends a single response, once all peers storing the object have responded
+	send(update_pkt, "group_write");
+
+	PendingRpcsEntry entry;
+	entry.modCallMsg = capiModMsg;
+
+	//The overlay copy is replaced by storing the whole updated object again, if the DHT was not disabled
+	if (!disableDHT)
+	{
+		write_pkt = new ValuePkt();
+		write_pkt->setName(capiModMsg->getName());
+		write_pkt->setPayloadType(STORE_REQ);
+		write_pkt->addObject(go);
+		write_pkt->setValue(rpcid);
+		write_pkt->setTimestamp(capiModMsg->getCreationTime());
+
+		send(write_pkt, "overlay_write");
+		entry.numSent = 2;
+	} else {
+		delete(go);
+		entry.numSent = 1;
+	}
+
+	pendingRpcs.insert(std::make_pair(rpcid, entry));
+}
+
+uint32_t Peer_logic::createRpcid(uint32_t nonce)
+{
+	if (pendingRpcs.find(nonce) == pendingRpcs.end())
+		return nonce;
+
+	return createLocalRpcid();
+}
+
+uint32_t Peer_logic::createLocalRpcid()
+{
+	do {
+		nextLocalRpcid++;
+	} while (pendingRpcs.find(nextLocalRpcid) != pendingRpcs.end());
+
+	return nextLocalRpcid;
+}
+
+void Peer_logic::handleBatchGetCAPIRequest(RootObjectBatchGetCAPICall* capiBatchGetMsg)
+{
+	Enter_Method("[Peer_logic]: handleBatchGetCAPIRequest()");	//Required for Omnet++ context switching between modules
+	take(capiBatchGetMsg);
+
+	unsigned int numKeys = capiBatchGetMsg->getKeysArraySize();
+
+	PendingBatchEntry batch;
+	batch.getCallMsg = capiBatchGetMsg;
+	batch.getRespMsg = new RootObjectBatchGetCAPIResponse();
+	batch.getRespMsg->setResultsArraySize(numKeys);
+	batch.getRespMsg->setIsSuccessArraySize(numKeys);
+	batch.numRemaining = numKeys;
+
+	RECORD_STATS(numBatchesReceived++; numBatchKeysReceived += numKeys; numGetsReceived += numKeys);
+
+	if (numKeys == 0)
+	{
+		cModule *communicatorModule = getParentModule()->getSubmodule("communicator");
+		Communicator *communicator = check_and_cast<Communicator *>(communicatorModule);
+
+		communicator->externallySendRpcResponse(capiBatchGetMsg, batch.getRespMsg);
+		return;
+	}
+
+	pendingBatches.insert(std::make_pair(capiBatchGetMsg->getNonce(), batch));
+
+	BatchPkt *group_batch = new BatchPkt(capiBatchGetMsg->getName());
+	group_batch->setPayloadType(BATCH);
+
+	for (unsigned int i = 0 ; i < numKeys ; i++)
+	{
+		uint32_t rpcid = createLocalRpcid();
+		OverlayKeyPkt *read_pkt = createRetrievePkt(capiBatchGetMsg->getName(), capiBatchGetMsg->getKeys(i), rpcid, capiBatchGetMsg->getCreationTime());
+
+		group_batch->addObject(read_pkt->dup());
+
+		if (!disableDHT)
+			send(read_pkt, "overlay_write");
+		else delete(read_pkt);
+
+		PendingRpcsEntry entry;
+		entry.isBatchKey = true;
+		entry.batchRpcid = capiBatchGetMsg->getNonce();
+		entry.batchIndex = i;
+		entry.numSent = numGroupGetResponses;
+		pendingRpcs.insert(std::make_pair(rpcid, entry));
+	}
+
+	send(group_batch, "group_write");
+}
+
+void Peer_logic::handleBatchPutCAPIRequest(RootObjectBatchPutCAPICall* capiBatchPutMsg)
+{
+	Enter_Method("[Peer_logic]: handleBatchPutCAPIRequest()");	//Required for Omnet++ context switching between modules
+	take(capiBatchPutMsg);
+
+	unsigned int numObjects = capiBatchPutMsg->getObjectsArraySize();
+
+	PendingBatchEntry batch;
+	batch.putCallMsg = capiBatchPutMsg;
+	batch.putRespMsg = new RootObjectBatchPutCAPIResponse();
+	batch.putRespMsg->setIsSuccessArraySize(numObjects);
+	batch.putRespMsg->setGroupAddressArraySize(numObjects);
+	batch.numRemaining = numObjects;
+
+	RECORD_STATS(numBatchesReceived++; numBatchKeysReceived += numObjects);
+
+	if (numObjects == 0)
+	{
+		cModule *communicatorModule = getParentModule()->getSubmodule("communicator");
+		Communicator *communicator = check_and_cast<Communicator *>(communicatorModule);
+
+		communicator->externallySendRpcResponse(capiBatchPutMsg, batch.putRespMsg);
+		return;
+	}
+
+	pendingBatches.insert(std::make_pair(capiBatchPutMsg->getNonce(), batch));
+
+	BatchPkt *group_batch = new BatchPkt(capiBatchPutMsg->getName());
+	group_batch->setPayloadType(BATCH);
+
+	for (unsigned int i = 0 ; i < numObjects ; i++)
+	{
+		GameObject *go = capiBatchPutMsg->getObjects(i).dup();
+
+		//Record the application layer data received, to later be able to calculate overhead.
+		RECORD_STATS(appBytesReceived += go->getSize());
+
+		//A GET that is already in flight may return the old object, so later GETs for the key are not coalesced with it
+		inFlightGets.erase(go->getNameHash());
+
+		uint32_t rpcid = createLocalRpcid();
+		ValuePkt *write_pkt = createStorePkt(capiBatchPutMsg->getName(), go, rpcid, capiBatchPutMsg->getCreationTime());
+
+		group_batch->addObject(write_pkt->dup());
+
+		PendingRpcsEntry entry;
+		entry.isBatchKey = true;
+		entry.batchRpcid = capiBatchPutMsg->getNonce();
+		entry.batchIndex = i;
+
+		if (!disableDHT)
+		{
+			send(write_pkt, "overlay_write");
+			entry.numSent = replicas + 1;
+		} else {
+			delete(write_pkt);
+			entry.numSent = replicas;
+		}
+
+		pendingRpcs.insert(std::make_pair(rpcid, entry));
+	}
+
+	send(group_batch, "group_write");
+}
+
+void Peer_logic::completeBatchGet(const PendingRpcsEntry &entry, RootObjectGetCAPIResponse* capiGetRespMsg)
+{
+	cModule *communicatorModule = getParentModule()->getSubmodule("communicator");
+	//This extra step ensures that the submodules exist and also does any other required error checking
+	Communicator *communicator = check_and_cast<Communicator *>(communicatorModule);
+
+	PendingBatches::iterator batch_it = pendingBatches.find(entry.batchRpcid);
+	if (batch_it == pendingBatches.end())
+		error("A key completed for an unknown batch request.");
+
+	batch_it->second.getRespMsg->setIsSuccess(entry.batchIndex, capiGetRespMsg->getIsSuccess());
+	if (capiGetRespMsg->getIsSuccess())
+		batch_it->second.getRespMsg->setResults(entry.batchIndex, capiGetRespMsg->getResult());
+
+	//The application receives every key as soon as it completes, so that a slow key does not hold back the others
+	RootObjectBatchGetResult *result_msg = new RootObjectBatchGetResult("batch_get_result");
+	result_msg->setBatchNonce(entry.batchRpcid);
+	result_msg->setIndex(entry.batchIndex);
+	result_msg->setIsSuccess(capiGetRespMsg->getIsSuccess());
+	if (capiGetRespMsg->getIsSuccess())
+		result_msg->setResult(capiGetRespMsg->getResult());
+	communicator->externallySendToUpperTier(result_msg);
+
+	delete(capiGetRespMsg);
+	completeBatchKey(batch_it);
+}
+
+void Peer_logic::completeBatchPut(const PendingRpcsEntry &entry, RootObjectPutCAPIResponse* capiPutRespMsg)
+{
+	PendingBatches::iterator batch_it = pendingBatches.find(entry.batchRpcid);
+	if (batch_it == pendingBatches.end())
+		error("A key completed for an unknown batch request.");
+
+	batch_it->second.putRespMsg->setIsSuccess(entry.batchIndex, capiPutRespMsg->getIsSuccess());
+	batch_it->second.putRespMsg->setGroupAddress(entry.batchIndex, capiPutRespMsg->getGroupAddress());
+
+	delete(capiPutRespMsg);
+	completeBatchKey(batch_it);
+}
+
+void Peer_logic::completeBatchKey(PendingBatches::iterator batch_it)
+{
+	cModule *communicatorModule = getParentModule()->getSubmodule("communicator");
+	//This extra step ensures that the submodules exist and also does any other required error checking
+	Communicator *communicator = check_and_cast<Communicator *>(communicatorModule);
+
+	PendingBatchEntry &batch = batch_it->second;
+
+	if (--batch.numRemaining > 0)
+		return;
+
+	if (batch.getCallMsg != NULL)
+		communicator->externallySendRpcResponse(batch.getCallMsg, batch.getRespMsg);
+	else communicator->externallySendRpcResponse(batch.putCallMsg, batch.putRespMsg);
+
+	pendingBatches.erase(batch_it);
 }
 
 void Peer_logic::processPut(PendingRpcsEntry entry, ResponsePkt *response)
@@ -221,7 +564,48 @@ void Peer_logic::processPut(PendingRpcsEntry entry, ResponsePkt *response)
 		if (success) capiPutRespMsg->setIsSuccess(true);
 		else capiPutRespMsg->setIsSuccess(false);
 
-		communicator->externallySendRpcResponse(entry.putCallMsg, capiPutRespMsg);
+		if (entry.isBatchKey)
+			completeBatchPut(entry, capiPutRespMsg);
+		else communicator->externallySendRpcResponse(entry.putCallMsg, capiPutRespMsg);
+		pendingRpcs.erase(response->getRpcid());
+	}
+}
+
+void Peer_logic::processMod(PendingRpcsEntry entry, ResponsePkt *response)
+{
+	cModule *communicatorModule = getParentModule()->getSubmodule("communicator");
+	//This extra step ensures that the submodules exist and also does any other required error checking
+	Communicator *communicator = check_and_cast<Communicator *>(communicatorModule);
+
+	bool complete = false;
+	bool success = false;
+
+	//Updates follow the put type: a safe update requires both the group and the overlay copies to be updated
+	if (!fastPut)
+	{
+		if (entry.numGroupModSucceeded + entry.numGroupModFailed + entry.numDHTModSucceeded + entry.numDHTModFailed == entry.numSent)
+		{
+			complete = true;
+			success = (entry.numGroupModSucceeded == 1) && ((entry.numDHTModSucceeded == 1) || disableDHT);
+		}
+	} else {
+		if (entry.numGroupModSucceeded == 1 || entry.numDHTModSucceeded == 1)
+		{
+			complete = true;
+			success = true;
+		}
+		else if (entry.numGroupModFailed + entry.numDHTModFailed == entry.numSent)
+		{
+			complete = true;
+		}
+	}
+
+	if (complete)
+	{
+		RootObjectModCAPIResponse* capiModRespMsg = new RootObjectModCAPIResponse();
+		capiModRespMsg->setIsSuccess(success);
+
+		communicator->externallySendRpcResponse(entry.modCallMsg, capiModRespMsg);
 		pendingRpcs.erase(response->getRpcid());
 	}
 }
@@ -261,12 +645,65 @@ GameObject Peer_logic::pickObject(std::vector<GameObject>objectsReceived)
 	else return GameObject::UNSPECIFIED_OBJECT;
 }
 
-void Peer_logic::processGet(PendingRpcsEntry *entry, ResponsePkt *response)
+void Peer_logic::recordAgreements(PendingRpcsEntry *entry, const GameObject &picked)
+{
+	for (unsigned int i = 0 ; i < entry->objectsReceived.size() ; i++)
+	{
+		//Objects from the DHT cannot be attributed to a group peer
+		if (entry->objectSources[i].isUnspecified())
+			continue;
+
+		bool agreed = (entry->objectsReceived[i] == picked);
+
+		if (!agreed)
+			RECORD_STATS(numObjectsDisagreeing++);
+
+		group_ledger->recordAgreement(PeerData(entry->objectSources[i]), agreed);
+	}
+}
+
+void Peer_logic::sendGetResponse(uint32_t rpcid, RootObjectGetCAPIResponse* capiGetRespMsg)
 {
 	cModule *communicatorModule = getParentModule()->getSubmodule("communicator");
 	//This extra step ensures that the submodules exist and also does any other required error checking
 	Communicator *communicator = check_and_cast<Communicator *>(communicatorModule);
 
+	PendingRpcs::iterator it = pendingRpcs.find(rpcid);
+	if (it == pendingRpcs.end())
+		error("A GET response was sent for an unknown request.");
+
+	PendingRpcsEntry &entry = it->second;
+
+	if (entry.isBatchKey)
+	{
+		completeBatchGet(entry, capiGetRespMsg);
+		pendingRpcs.erase(it);
+		return;
+	}
+
+	//The key is no longer in flight, so the next GET for it is sent again. The call message is deleted once it has been responded to.
+	if (coalesceGets)
+	{
+		InFlightGets::iterator inflight_it = inFlightGets.find(entry.getCallMsg->getKey());
+
+		if ((inflight_it != inFlightGets.end()) && (inflight_it->second == rpcid))
+			inFlightGets.erase(inflight_it);
+	}
+
+	for (unsigned int i = 0 ; i < entry.coalescedCalls.size() ; i++)
+	{
+		communicator->externallySendRpcResponse(entry.coalescedCalls[i], capiGetRespMsg->dup());
+
+		if (capiGetRespMsg->getIsSuccess())
+			RECORD_STATS(appBytesSent += capiGetRespMsg->getResult().getSize());
+	}
+
+	communicator->externallySendRpcResponse(entry.getCallMsg, capiGetRespMsg);
+	pendingRpcs.erase(it);
+}
+
+void Peer_logic::processGet(PendingRpcsEntry *entry, ResponsePkt *response)
+{
 	if (fastGet)
 	{
 		if ((entry->numGroupGetSucceeded == 1) || (entry->numDHTGetSucceeded == 1))
@@ -279,21 +716,34 @@ void Peer_logic::processGet(PendingRpcsEntry *entry, ResponsePkt *response)
 			RootObjectGetCAPIResponse* capiGetRespMsg = new RootObjectGetCAPIResponse();
 			capiGetRespMsg->setIsSuccess(true);
 			capiGetRespMsg->setResult(*object);	//The value is copied here and not the actual object
-			communicator->externallySendRpcResponse(entry->getCallMsg, capiGetRespMsg);
-			pendingRpcs.erase(response->getRpcid());
+			sendGetResponse(response->getRpcid(), capiGetRespMsg);
 
 			//Record the application layer data received, to later be able to calculate overhead.
 			RECORD_STATS(appBytesSent += object->getSize());
 		//If both the DHT get and all group gets failed, or DHT is disabled and all group gets failed, a failure occurred
-		} else if (((entry->numDHTGetFailed == 1) || disableDHT) && (entry->numGroupGetFailed == numGetRequests))
+		} else if (((entry->numDHTGetFailed == 1) || disableDHT) && (entry->numGroupGetFailed == numGroupGetResponses))
 		{
 			//This is the failure response to both situations where either the group messages
 			//failed or the overlay messages failed. Notice the "return" in the success scenario.
 			RootObjectGetCAPIResponse* capiGetRespMsg = new RootObjectGetCAPIResponse();
 			capiGetRespMsg->setIsSuccess(false);
-			communicator->externallySendRpcResponse(entry->getCallMsg, capiGetRespMsg);
-			pendingRpcs.erase(response->getRpcid());
+			sendGetResponse(response->getRpcid(), capiGetRespMsg);
 		}
+	} else if (hashVoting && (response->getResponseType() == GROUP_GET) && response->getIsSuccess())
+	{
+		//The group has already agreed on the object by a majority vote on its content hash, so it is used as is
+		//A failed vote is counted like any other group failure below, so that the overlay can still answer the request
+		GameObject *object = (GameObject *)response->getObject("GameObject");
+		if (object == NULL)
+			error("No object was attached to group storage response message");
+
+		RootObjectGetCAPIResponse* capiGetRespMsg = new RootObjectGetCAPIResponse();
+		capiGetRespMsg->setIsSuccess(true);
+		capiGetRespMsg->setResult(*object);	//The value is copied here and not the actual object
+		sendGetResponse(response->getRpcid(), capiGetRespMsg);
+
+		//Record the application layer data received, to later be able to calculate overhead.
+		RECORD_STATS(appBytesSent += object->getSize());
 	} else {
 
 		if (response->getIsSuccess())
@@ -304,6 +754,10 @@ void Peer_logic::processGet(PendingRpcsEntry *entry, ResponsePkt *response)
 
 			//Add the received object to the received objects vector for comparison
 			entry->objectsReceived.push_back(*object);
+
+			if (response->getResponseType() == GROUP_GET)
+				entry->objectSources.push_back(response->getSourceAddress());
+			else entry->objectSources.push_back(TransportAddress::UNSPECIFIED_NODE);
 		}
 
 		if (entry->numGroupGetSucceeded + entry->numDHTGetSucceeded == numGetCompares)
@@ -314,6 +768,8 @@ void Peer_logic::processGet(PendingRpcsEntry *entry, ResponsePkt *response)
 
 			if (object != GameObject::UNSPECIFIED_OBJECT)
 			{
+				recordAgreements(entry, object);
+
 				capiGetRespMsg->setIsSuccess(true);
 				capiGetRespMsg->setResult(object);	//The value is copied here and not the actual object
 
@@ -323,18 +779,29 @@ void Peer_logic::processGet(PendingRpcsEntry *entry, ResponsePkt *response)
 			//If it could not be determined which was the correct object, don't send any object
 			else capiGetRespMsg->setIsSuccess(false);
 
-			communicator->externallySendRpcResponse(entry->getCallMsg, capiGetRespMsg);
+			sendGetResponse(response->getRpcid(), capiGetRespMsg);
+		//Hash voted, hedged and erasure coded group storage sends a single response. Once it has failed, the overlay's
+		//object is the only one left, so it is used without a comparison rather than leaving the request unanswered.
+		} else if ((numGroupGetResponses == 1) && (entry->numGroupGetFailed == 1) && (entry->numDHTGetSucceeded == 1))
+		{
+			const GameObject &object = entry->objectsReceived.back();
+
+			RootObjectGetCAPIResponse* capiGetRespMsg = new RootObjectGetCAPIResponse();
+			capiGetRespMsg->setIsSuccess(true);
+			capiGetRespMsg->setResult(object);	//The value is copied here and not the actual object
 
-			pendingRpcs.erase(response->getRpcid());
+			//Record the application layer data received, to later be able to calculate overhead.
+			RECORD_STATS(appBytesSent += object.getSize());
+
+			sendGetResponse(response->getRpcid(), capiGetRespMsg);
 		//If both the DHT get and the group get failed, or DHT is disabled and group get failed, a failure occurred
-		} else if (((entry->numDHTGetFailed == 1) || disableDHT) && (entry->numGroupGetFailed == numGetRequests))
+		} else if (((entry->numDHTGetFailed == 1) || disableDHT) && (entry->numGroupGetFailed == numGroupGetResponses))
 		{
 			//This is the failure response to both situations where either the group messages
 			//failed or the overlay messages failed. Notice the "return" in the success scenario.
 			RootObjectGetCAPIResponse* capiGetRespMsg = new RootObjectGetCAPIResponse();
 			capiGetRespMsg->setIsSuccess(false);
-			communicator->externallySendRpcResponse(entry->getCallMsg, capiGetRespMsg);
-			pendingRpcs.erase(response->getRpcid());
+			sendGetResponse(response->getRpcid(), capiGetRespMsg);
 		}
 	}
 }
@@ -377,6 +844,25 @@ void Peer_logic::handleResponseMsg(cMessage *msg)
 		} else it->second.numGroupPutFailed++;
 
 		processPut(it->second, response);
+	} else if (response->getResponseType() == GROUP_MOD)
+	{
+		if (response->getTimestamp() == 0.0)
+			error("MOD response received recorded a zero time stamp.");
+		RECORD_STATS(globalStatistics->recordOutVector("GroupStorage: MOD Latency (s)", SIMTIME_DBL(simTime() - response->getTimestamp())));
+
+		if (response->getIsSuccess())
+			it->second.numGroupModSucceeded++;
+		else it->second.numGroupModFailed++;
+
+		processMod(it->second, response);
+	} else if ((response->getResponseType() == OVERLAY_PUT) && (it->second.modCallMsg != NULL))
+	{
+		//The overlay copy of an updated object is stored again in full
+		if (response->getIsSuccess())
+			it->second.numDHTModSucceeded++;
+		else it->second.numDHTModFailed++;
+
+		processMod(it->second, response);
 	} else if (response->getResponseType() == OVERLAY_PUT)
 	{
 		if (response->getIsSuccess())
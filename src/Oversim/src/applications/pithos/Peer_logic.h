@@ -32,6 +32,8 @@
 #include "PithosMessages_m.h"
 #include "PithosTestMessages_m.h"
 
+class GroupLedger;
+
 enum SP_indeces {
     UNKNOWN = -1,
     THIS = -2
@@ -69,8 +71,13 @@ class Peer_logic: public cSimpleModule
 				{
 					getCallMsg = NULL;
 					putCallMsg = NULL;
+					modCallMsg = NULL;
 					numSent = 0;
 
+					isBatchKey = false;
+					batchRpcid = 0;
+					batchIndex = 0;
+
 					numGroupPutFailed = 0;
 					numGroupPutSucceeded = 0;
 					numDHTPutSucceeded = 0;
@@ -80,13 +87,23 @@ class Peer_logic: public cSimpleModule
 					numGroupGetSucceeded = 0;
 					numDHTGetSucceeded = 0;
 					numDHTGetFailed = 0;
+
+					numGroupModSucceeded = 0;
+					numGroupModFailed = 0;
+					numDHTModSucceeded = 0;
+					numDHTModFailed = 0;
 				};
 
 				RootObjectGetCAPICall* getCallMsg;
 				RootObjectPutCAPICall* putCallMsg;
+				RootObjectModCAPICall* modCallMsg;
 
 				TransportAddress group_address;
 
+				bool isBatchKey;			//true if the request is one of the keys of a batch request
+				uint32_t batchRpcid;		//The RPC ID of the batch request the key belongs to
+				unsigned int batchIndex;	//The position of the key in the batch request
+
 				int numSent;
 
 				int numGroupPutFailed;
@@ -99,7 +116,15 @@ class Peer_logic: public cSimpleModule
 				int numDHTGetSucceeded;
 				int numDHTGetFailed;
 
+				int numGroupModSucceeded;
+				int numGroupModFailed;
+				int numDHTModSucceeded;
+				int numDHTModFailed;
+
 				std::vector<GameObject> objectsReceived;
+				std::vector<TransportAddress> objectSources;	//The group peer that returned each received object, or an unspecified address for the DHT
+
+				std::vector<RootObjectGetCAPICall*> coalescedCalls;	//GET requests for the same key that complete with this request's response
 		};
 
 		//friend std::ostream& operator<<(std::ostream& Stream, const PendingRpcsEntry& entry);
@@ -107,18 +132,62 @@ class Peer_logic: public cSimpleModule
 		typedef std::map<uint32_t, PendingRpcsEntry> PendingRpcs;
 		PendingRpcs pendingRpcs; /**< a map of all pending RPC operations */
 
+		/**
+		 * A batch GET or PUT request from the higher layer. Every key of the batch is tracked as a pending RPC of its own,
+		 * and its result is recorded in the batch's response, which is sent once all keys have completed. The result of
+		 * every key of a batch GET is also sent to the higher layer as soon as that key completes.
+		 */
+		class PendingBatchEntry
+		{
+			public:
+				PendingBatchEntry()
+				{
+					getCallMsg = NULL;
+					putCallMsg = NULL;
+					getRespMsg = NULL;
+					putRespMsg = NULL;
+					numRemaining = 0;
+				};
+
+				RootObjectBatchGetCAPICall* getCallMsg;
+				RootObjectBatchPutCAPICall* putCallMsg;
+
+				RootObjectBatchGetCAPIResponse* getRespMsg;
+				RootObjectBatchPutCAPIResponse* putRespMsg;
+
+				unsigned int numRemaining;	//The number of keys that have not yet completed
+		};
+
+		typedef std::map<uint32_t, PendingBatchEntry> PendingBatches;
+		PendingBatches pendingBatches; /**< a map of all pending batch requests */
+		uint32_t nextLocalRpcid;	//The last RPC ID handed out by createLocalRpcid()
+
+		typedef std::map<OverlayKey, uint32_t> InFlightGets;
+		InFlightGets inFlightGets; /**< the RPC ID of the pending GET request for every key that is being retrieved, if GETs are coalesced */
+
 		int replicas;	//The number of replicas group storage is set to.
 		int numGetRequests;	//How many get requests to send out for every request received from the higher layer
+		int numGroupGetResponses;	//How many responses group storage sends for every get request (one if get requests are hedged)
 		int numGetCompares;	//How many objects to compare for safe retrieval, before a decision is made
 		bool fastPut;
 		bool fastGet;
 
 		bool disableDHT;
 
+		bool hashVoting;	//true if group storage verifies a GET by a majority vote on content hashes, so that its object needs no further comparison
+		bool coalesceGets;	//true if GETs for a key that is already being retrieved wait for the pending request's response
+
+		GroupLedger *group_ledger;	//Records the reputation of the group peers that returned objects
+
 		GlobalStatistics* globalStatistics; /**< pointer to GlobalStatistics module in this node*/
 
 		int appBytesSent;
 		int appBytesReceived;
+		int numObjectsDisagreeing;
+		int numGetsReceived;
+		int numGetsCoalesced;
+		int numBatchesReceived;
+		int numBatchKeysReceived;
 
 	public:
 		Peer_logic();
@@ -138,16 +207,100 @@ class Peer_logic: public cSimpleModule
 		 */
 		void handleGetCAPIRequest(RootObjectGetCAPICall* capiGetMsg);
 
+		/**
+		 * Handle a request from the higher layer to update a stored object.
+		 * Group storage only sends the changed bytes to the peers storing the object. The DHT cannot apply a partial
+		 * update, so the whole object is stored in the overlay again.
+		 *
+		 * @param capiModMsg the request containing the updated GameObject
+		 */
+		void handleModCAPIRequest(RootObjectModCAPICall* capiModMsg);
+
+		/**
+		 * Handle a request from the higher layer to retrieve several keys.
+		 * The group requests of all keys are sent to group storage together, so that the requests to the same peer are
+		 * sent in one packet. The overlay requests are sent separately, since the overlay routes every key to a different node.
+		 *
+		 * @param capiBatchGetMsg the request containing the OverlayKeys
+		 */
+		void handleBatchGetCAPIRequest(RootObjectBatchGetCAPICall* capiBatchGetMsg);
+
+		/**
+		 * Handle a request from the higher layer to store several objects.
+		 * The group requests of all objects are sent to group storage together, as for a batch GET.
+		 *
+		 * @param capiBatchPutMsg the request containing the GameObjects
+		 */
+		void handleBatchPutCAPIRequest(RootObjectBatchPutCAPICall* capiBatchPutMsg);
+
 	protected:
 		virtual void initialize();
 		void finish();
 		virtual void handleMessage(cMessage *msg);
 
+		/**
+		 * @return a retrieve request for group storage and the overlay
+		 */
+		OverlayKeyPkt *createRetrievePkt(const char *name, const OverlayKey &key, uint32_t rpcid, simtime_t request_time);
+
+		/**
+		 * @return a store request for group storage and the overlay, to which the object is attached
+		 */
+		ValuePkt *createStorePkt(const char *name, GameObject *go, uint32_t rpcid, simtime_t request_time);
+
+		/**
+		 * @return the nonce of a request from the higher layer as its RPC ID, or a new RPC ID if a pending request
+		 * already uses it, since the keys of batch requests are given RPC IDs of their own
+		 */
+		uint32_t createRpcid(uint32_t nonce);
+
+		/**
+		 * @return an RPC ID for a key of a batch request, that is not used by any pending request
+		 */
+		uint32_t createLocalRpcid();
+
+		/**
+		 * Send the response of a key to the higher layer and record it in its batch's response, and send the batch's
+		 * response if it was the last key.
+		 *
+		 * @param entry The pending request of the key
+		 * @param capiGetRespMsg The response of the key, which is deleted
+		 */
+		void completeBatchGet(const PendingRpcsEntry &entry, RootObjectGetCAPIResponse* capiGetRespMsg);
+
+		/**
+		 * @see completeBatchGet()
+		 */
+		void completeBatchPut(const PendingRpcsEntry &entry, RootObjectPutCAPIResponse* capiPutRespMsg);
+
+		/**
+		 * Count a completed key of a batch, and send the batch's response once all of its keys have completed.
+		 */
+		void completeBatchKey(PendingBatches::iterator batch_it);
+
 		void processPut(PendingRpcsEntry entry, ResponsePkt *response);
+		void processMod(PendingRpcsEntry entry, ResponsePkt *response);
 
 		GameObject pickObject(std::vector<GameObject>objectsReceived);
+
+		/**
+		 * Record in the group ledger whether every group peer that returned an object agreed with the picked object.
+		 *
+		 * @param entry The pending GET request containing the received objects
+		 * @param picked The object chosen by pickObject
+		 */
+		void recordAgreements(PendingRpcsEntry *entry, const GameObject &picked);
 		void processGet(PendingRpcsEntry *entry, ResponsePkt *response);
 
+		/**
+		 * Send the response to a GET request to the higher layer, together with a copy for every request that was
+		 * coalesced with it, and remove the request from the pending RPCs.
+		 *
+		 * @param rpcid The RPC ID of the pending GET request
+		 * @param capiGetRespMsg The response to the request
+		 */
+		void sendGetResponse(uint32_t rpcid, RootObjectGetCAPIResponse* capiGetRespMsg);
+
 		void handleResponseMsg(cMessage *msg);
 };
 
@@ -0,0 +1,298 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#include <string.h>
+#include <algorithm>
+
+//The vector kernels are compiled for their own instruction sets and chosen at run time, so no build flags are needed
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || (__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define RS_RUNTIME_DISPATCH
+#include <immintrin.h>
+#endif
+
+#include "ReedSolomon.h"
+
+uint8_t ReedSolomon::gf_exp[512];
+uint8_t ReedSolomon::gf_log[256];
+bool ReedSolomon::tables_built = false;
+ReedSolomon::SimdLevel ReedSolomon::simd_level = ReedSolomon::SIMD_NONE;
+
+#ifdef RS_RUNTIME_DISPATCH
+/**
+ * dst[i] ^= lo[src[i] & 0x0f] ^ hi[src[i] >> 4] for the bytes that fill whole 32 byte vectors
+ *
+ * @return the number of bytes processed
+ */
+__attribute__((target("avx2")))
+static size_t mulAddRegionAVX2(uint8_t *dst, const uint8_t *src, const uint8_t *lo, const uint8_t *hi, size_t length)
+{
+	__m256i tlo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)lo));
+	__m256i thi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)hi));
+	__m256i mask = _mm256_set1_epi8(0x0f);
+	size_t i = 0;
+
+	for ( ; i + 32 <= length ; i += 32)
+	{
+		__m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+		__m256i l = _mm256_shuffle_epi8(tlo, _mm256_and_si256(s, mask));
+		__m256i h = _mm256_shuffle_epi8(thi, _mm256_and_si256(_mm256_srli_epi64(s, 4), mask));
+		__m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+
+		_mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(d, _mm256_xor_si256(l, h)));
+	}
+
+	return i;
+}
+
+/**
+ * The SSSE3 version of mulAddRegionAVX2(), for 16 byte vectors
+ */
+__attribute__((target("ssse3")))
+static size_t mulAddRegionSSSE3(uint8_t *dst, const uint8_t *src, const uint8_t *lo, const uint8_t *hi, size_t length)
+{
+	__m128i tlo = _mm_loadu_si128((const __m128i *)lo);
+	__m128i thi = _mm_loadu_si128((const __m128i *)hi);
+	__m128i mask = _mm_set1_epi8(0x0f);
+	size_t i = 0;
+
+	for ( ; i + 16 <= length ; i += 16)
+	{
+		__m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i l = _mm_shuffle_epi8(tlo, _mm_and_si128(s, mask));
+		__m128i h = _mm_shuffle_epi8(thi, _mm_and_si128(_mm_srli_epi64(s, 4), mask));
+		__m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(d, _mm_xor_si128(l, h)));
+	}
+
+	return i;
+}
+#endif
+
+ReedSolomon::ReedSolomon() {
+	k = 0;
+	m = 0;
+
+	if (!tables_built)
+		buildTables();
+}
+
+ReedSolomon::~ReedSolomon() {
+
+}
+
+void ReedSolomon::buildTables()
+{
+	unsigned int x = 1;
+
+	//The field is generated by the primitive polynomial x^8 + x^4 + x^3 + x^2 + 1
+	for (unsigned int i = 0 ; i < 255 ; i++)
+	{
+		gf_exp[i] = x;
+		gf_log[x] = i;
+
+		x <<= 1;
+		if (x & 0x100)
+			x ^= 0x11d;
+	}
+
+	//The exponent table is doubled, so that the sum of two logarithms does not have to be reduced
+	for (unsigned int i = 255 ; i < 512 ; i++)
+		gf_exp[i] = gf_exp[i - 255];
+
+	gf_log[0] = 0;
+
+#ifdef RS_RUNTIME_DISPATCH
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2"))
+		simd_level = SIMD_AVX2;
+	else if (__builtin_cpu_supports("ssse3"))
+		simd_level = SIMD_SSSE3;
+#endif
+
+	tables_built = true;
+}
+
+uint8_t ReedSolomon::mul(uint8_t a, uint8_t b)
+{
+	if (a == 0 || b == 0)
+		return 0;
+
+	return gf_exp[gf_log[a] + gf_log[b]];
+}
+
+uint8_t ReedSolomon::div(uint8_t a, uint8_t b)
+{
+	if (b == 0)
+		opp_error("[ReedSolomon]: Division by zero in GF(2^8).");
+
+	if (a == 0)
+		return 0;
+
+	return gf_exp[gf_log[a] + 255 - gf_log[b]];
+}
+
+void ReedSolomon::mulAddRegion(uint8_t *dst, const uint8_t *src, uint8_t c, size_t length)
+{
+	uint8_t lo[16];
+	uint8_t hi[16];
+	size_t i = 0;
+
+	if (c == 0)
+		return;
+
+	//A product is split into the products of the low and high nibbles, so that it can be looked up in two 16 byte tables
+	for (unsigned int x = 0 ; x < 16 ; x++)
+	{
+		lo[x] = mul(c, x);
+		hi[x] = mul(c, x << 4);
+	}
+
+#ifdef RS_RUNTIME_DISPATCH
+	if (simd_level == SIMD_AVX2)
+		i = mulAddRegionAVX2(dst, src, lo, hi, length);
+	else if (simd_level == SIMD_SSSE3)
+		i = mulAddRegionSSSE3(dst, src, lo, hi, length);
+#endif
+
+	//The scalar loop handles the bytes that do not fill a vector register, or all bytes without vector support
+	for ( ; i < length ; i++)
+		dst[i] ^= lo[src[i] & 0x0f] ^ hi[src[i] >> 4];
+}
+
+void ReedSolomon::init(unsigned int k, unsigned int m)
+{
+	if (k == 0)
+		opp_error("[ReedSolomon]: At least one data fragment is required.");
+	if (k + m > 256)
+		opp_error("[ReedSolomon]: At most 256 fragments are supported in GF(2^8).");
+
+	this->k = k;
+	this->m = m;
+
+	matrix.assign((k + m) * k, 0);
+
+	for (unsigned int i = 0 ; i < k ; i++)
+		matrix[i*k + i] = 1;
+
+	//Parity row i and column j hold 1/(x_i + y_j), with x_i = k+i and y_j = j, which are all distinct
+	for (unsigned int i = 0 ; i < m ; i++)
+		for (unsigned int j = 0 ; j < k ; j++)
+			matrix[(k + i)*k + j] = div(1, (k + i) ^ j);
+}
+
+void ReedSolomon::encode(const std::vector<const uint8_t *> &data, const std::vector<uint8_t *> &parity, size_t length)
+{
+	if (data.size() != k || parity.size() != m)
+		opp_error("[ReedSolomon]: The number of fragments does not match the code.");
+
+	for (unsigned int i = 0 ; i < m ; i++)
+	{
+		memset(parity[i], 0, length);
+
+		for (unsigned int j = 0 ; j < k ; j++)
+			mulAddRegion(parity[i], data[j], matrix[(k + i)*k + j], length);
+	}
+}
+
+bool ReedSolomon::invert(std::vector<uint8_t> &a)
+{
+	std::vector<uint8_t> inv(k * k, 0);
+
+	for (unsigned int i = 0 ; i < k ; i++)
+		inv[i*k + i] = 1;
+
+	for (unsigned int col = 0 ; col < k ; col++)
+	{
+		//Find a row with a non-zero pivot and swap it into place
+		unsigned int pivot = col;
+		while (pivot < k && a[pivot*k + col] == 0)
+			pivot++;
+
+		if (pivot == k)
+			return false;
+
+		if (pivot != col)
+		{
+			for (unsigned int j = 0 ; j < k ; j++)
+			{
+				std::swap(a[pivot*k + j], a[col*k + j]);
+				std::swap(inv[pivot*k + j], inv[col*k + j]);
+			}
+		}
+
+		//Scale the pivot row so that the pivot is one
+		uint8_t scale = div(1, a[col*k + col]);
+		for (unsigned int j = 0 ; j < k ; j++)
+		{
+			a[col*k + j] = mul(a[col*k + j], scale);
+			inv[col*k + j] = mul(inv[col*k + j], scale);
+		}
+
+		//Eliminate the column from all other rows. Subtraction is addition in GF(2^8).
+		for (unsigned int row = 0 ; row < k ; row++)
+		{
+			uint8_t factor = a[row*k + col];
+
+			if (row == col || factor == 0)
+				continue;
+
+			mulAddRegion(&a[row*k], &a[col*k], factor, k);
+			mulAddRegion(&inv[row*k], &inv[col*k], factor, k);
+		}
+	}
+
+	a.swap(inv);
+	return true;
+}
+
+bool ReedSolomon::decode(const std::vector<unsigned int> &indices, const std::vector<const uint8_t *> &fragments, const std::vector<uint8_t *> &data, size_t length)
+{
+	std::vector<uint8_t> sub;
+	std::vector<const uint8_t *> rows;
+	std::vector<bool> used(k + m, false);
+
+	if (data.size() != k || indices.size() != fragments.size())
+		opp_error("[ReedSolomon]: The number of fragments does not match the code.");
+
+	//Select the rows of the encoding matrix of the first k distinct fragments
+	for (unsigned int i = 0 ; i < indices.size() && rows.size() < k ; i++)
+	{
+		if (indices[i] >= k + m || used[indices[i]])
+			continue;
+
+		used[indices[i]] = true;
+		rows.push_back(fragments[i]);
+		sub.insert(sub.end(), matrix.begin() + indices[i]*k, matrix.begin() + (indices[i] + 1)*k);
+	}
+
+	if (rows.size() < k || !invert(sub))
+		return false;
+
+	//Every data fragment is a linear combination of the selected fragments
+	for (unsigned int i = 0 ; i < k ; i++)
+	{
+		memset(data[i], 0, length);
+
+		for (unsigned int j = 0 ; j < k ; j++)
+			mulAddRegion(data[i], rows[j], sub[i*k + j], length);
+	}
+
+	return true;
+}
@@ -0,0 +1,112 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#ifndef REEDSOLOMON_H_
+#define REEDSOLOMON_H_
+
+#include <omnetpp.h>
+#include <vector>
+
+/**
+ * A systematic Reed-Solomon erasure code over GF(2^8).
+ *
+ * An object is split into k data fragments, from which m parity fragments are computed. The object can be recovered
+ * from any k of the k+m fragments. The first k rows of the encoding matrix are the identity, so the data fragments are
+ * stored unchanged, and the parity rows form a Cauchy matrix, which makes every k by k submatrix invertible.
+ *
+ * The region multiply-add kernel is vectorised with AVX2 or SSSE3 when the processor supports them, which is detected
+ * when the tables are built, and falls back to a scalar loop otherwise.
+ *
+ * @author John Gilmore
+ */
+class ReedSolomon
+{
+	private:
+		unsigned int k;		/**< The number of data fragments */
+		unsigned int m;		/**< The number of parity fragments */
+
+		std::vector<uint8_t> matrix;	/**< The (k+m) by k encoding matrix, stored by row */
+
+		static uint8_t gf_exp[512];
+		static uint8_t gf_log[256];
+		static bool tables_built;
+
+		enum SimdLevel
+		{
+			SIMD_NONE,
+			SIMD_SSSE3,
+			SIMD_AVX2
+		};
+
+		static SimdLevel simd_level;	/**< The widest vector kernel supported by the processor */
+
+		static void buildTables();
+
+		/**
+		 * Invert a k by k matrix in place by Gauss-Jordan elimination.
+		 *
+		 * @return false if the matrix is singular
+		 */
+		bool invert(std::vector<uint8_t> &a);
+
+	public:
+		ReedSolomon();
+		virtual ~ReedSolomon();
+
+		/**
+		 * Set the code parameters. At most 256 fragments are supported.
+		 *
+		 * @param k The number of data fragments
+		 * @param m The number of parity fragments
+		 */
+		void init(unsigned int k, unsigned int m);
+
+		unsigned int getDataFragments() { return k; }
+		unsigned int getParityFragments() { return m; }
+
+		static uint8_t mul(uint8_t a, uint8_t b);
+		static uint8_t div(uint8_t a, uint8_t b);
+
+		/**
+		 * dst[i] ^= c * src[i] for every byte of the region
+		 */
+		static void mulAddRegion(uint8_t *dst, const uint8_t *src, uint8_t c, size_t length);
+
+		/**
+		 * Compute the parity fragments.
+		 *
+		 * @param data The k data fragments
+		 * @param parity The m parity fragments, which are overwritten
+		 * @param length The length in bytes of every fragment
+		 */
+		void encode(const std::vector<const uint8_t *> &data, const std::vector<uint8_t *> &parity, size_t length);
+
+		/**
+		 * Recover the data fragments from any k distinct fragments.
+		 *
+		 * @param indices The index of every fragment that is available, where data fragments are numbered from 0 and parity fragments from k
+		 * @param fragments The available fragments, in the same order as their indices
+		 * @param data The k data fragments, which are overwritten. They should not overlap the available fragments.
+		 * @param length The length in bytes of every fragment
+		 *
+		 * @return false if fewer than k distinct fragments were given
+		 */
+		bool decode(const std::vector<unsigned int> &indices, const std::vector<const uint8_t *> &fragments, const std::vector<uint8_t *> &data, size_t length);
+};
+
+#endif /* REEDSOLOMON_H_ */
@@ -0,0 +1,75 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#include <math.h>
+
+#include "RttEstimator.h"
+
+RttEstimator::RttEstimator() {
+	clear();
+}
+
+RttEstimator::~RttEstimator() {
+
+}
+
+void RttEstimator::addSample(double rtt)
+{
+	if (samples == 0)
+	{
+		//The first sample initialises the estimate
+		srtt = rtt;
+		rttvar = rtt / 2;
+	} else {
+		//The deviation is updated with the previous smoothed round trip time
+		rttvar = 0.75 * rttvar + 0.25 * fabs(srtt - rtt);
+		srtt = 0.875 * srtt + 0.125 * rtt;
+	}
+
+	samples++;
+	backoff = 0;
+}
+
+void RttEstimator::backOff()
+{
+	if (backoff < MAX_BACKOFF)
+		backoff++;
+}
+
+double RttEstimator::getRto(double min_rto, double max_rto)
+{
+	if (samples == 0)
+		return max_rto;
+
+	double rto = (srtt + 4 * rttvar) * (1 << backoff);
+
+	if (rto < min_rto)
+		return min_rto;
+	if (rto > max_rto)
+		return max_rto;
+
+	return rto;
+}
+
+void RttEstimator::clear()
+{
+	srtt = 0;
+	rttvar = 0;
+	samples = 0;
+	backoff = 0;
+}
@@ -0,0 +1,79 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#ifndef RTTESTIMATOR_H_
+#define RTTESTIMATOR_H_
+
+/**
+ * Estimates the round trip time to a single peer from measured samples.
+ * The smoothed round trip time and its mean deviation are exponentially weighted moving averages, with the gains
+ * used by TCP (RFC 6298).
+ *
+ * @author John Gilmore
+ */
+class RttEstimator
+{
+	private:
+		double srtt;		/**< The smoothed round trip time in seconds */
+		double rttvar;		/**< The smoothed mean deviation of the round trip time in seconds */
+		unsigned int samples;
+		unsigned int backoff;	/**< The number of times the timeout has been doubled since the last sample */
+
+		static const unsigned int MAX_BACKOFF = 6;
+
+	public:
+		RttEstimator();
+		virtual ~RttEstimator();
+
+		/**
+		 * Add a measured round trip time to the estimate.
+		 *
+		 * @param rtt The measured round trip time in seconds
+		 */
+		void addSample(double rtt);
+
+		/**
+		 * Double the retransmission timeout after a request timed out. The timeout stays backed off until the next
+		 * sample is added, so that a peer that stopped responding does not keep causing early timeouts (Karn's algorithm).
+		 */
+		void backOff();
+
+		/**
+		 * @param min_rto The shortest timeout that is returned
+		 * @param max_rto The longest timeout that is returned, which is also used while nothing has been measured
+		 * @return the timeout for a request to the peer: the smoothed round trip time plus four times its deviation, backed off and clamped.
+		 */
+		double getRto(double min_rto, double max_rto);
+
+		bool hasSamples() { return samples > 0; }
+		unsigned int getNumSamples() { return samples; }
+
+		/**
+		 * @return the smoothed round trip time, or 0 if nothing has been measured yet.
+		 */
+		double getSrtt() { return srtt; }
+
+		/**
+		 * @return the mean deviation of the round trip time, or 0 if nothing has been measured yet.
+		 */
+		double getRttVar() { return rttvar; }
+
+		void clear();
+};
+
+#endif /* RTTESTIMATOR_H_ */
@@ -16,8 +16,11 @@
 #include "SP_element.h"
 
 SP_element::SP_element() {
-	// TODO Auto-generated constructor stub
-
+	latitude = 0;
+	longitude = 0;
+	groupSize = 0;
+	storedBytes = 0;
+	objectAddRate = 0;
 }
 
 SP_element::~SP_element() {
@@ -57,3 +60,30 @@ double SP_element::getLongitude()
 {
 	return longitude;
 }
+
+void SP_element::setLoad(const unsigned int &group_size, const double &stored_bytes, const double &object_add_rate)
+{
+	groupSize = group_size;
+	storedBytes = stored_bytes;
+	objectAddRate = object_add_rate;
+}
+
+void SP_element::addAssignedPeer()
+{
+	groupSize++;
+}
+
+unsigned int SP_element::getGroupSize()
+{
+	return groupSize;
+}
+
+double SP_element::getStoredBytes()
+{
+	return storedBytes;
+}
+
+double SP_element::getObjectAddRate()
+{
+	return objectAddRate;
+}
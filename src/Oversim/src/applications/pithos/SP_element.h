@@ -38,6 +38,12 @@ class SP_element
 		double latitude; /**< The latitude of the super peer in the virtual world */
 
 		double longitude; /**< The longitude of the super peer in the virtual world */
+
+		unsigned int groupSize; /**< The number of peers in the super peer's group, as last reported or assigned */
+
+		double storedBytes; /**< The number of bytes stored in the group, as last reported */
+
+		double objectAddRate; /**< The number of object additions per second in the group, as last reported */
 	public:
 		SP_element();
 		virtual ~SP_element();
@@ -73,6 +79,24 @@ class SP_element
 		double getLatitude();
 		double getLongitude();
 
+		/**
+		 * Set the load of the super peer's group
+		 *
+		 * @param group_size The number of peers in the group
+		 * @param stored_bytes The number of bytes stored in the group
+		 * @param object_add_rate The number of object additions per second in the group
+		 */
+		void setLoad(const unsigned int &group_size, const double &stored_bytes, const double &object_add_rate);
+
+		/**
+		 * Record that a peer was sent to this super peer's group since its last load report
+		 */
+		void addAssignedPeer();
+
+		unsigned int getGroupSize();
+		double getStoredBytes();
+		double getObjectAddRate();
+
 };
 
 #endif /* SP_ELEMENT_H_ */
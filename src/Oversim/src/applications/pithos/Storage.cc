@@ -30,6 +30,8 @@ void Storage::initialize()
 	storage.setName("queue");
 	take(&storage);
 
+	totals.setBucketSize((int)par("ttlBucketSize").doubleValue());
+
 	//Initialise queue statistics collection
 	qlenSignal = registerSignal("qlen");
 	qsizeSignal = registerSignal("qsize");
@@ -37,31 +39,11 @@ void Storage::initialize()
 	storeTimeSignal = registerSignal("storeTime");
 
 	emit(qlenSignal, storage.length());
-	emit(qsizeSignal, getStorageBytes());
+	emit(qsizeSignal, (long)getStorageBytes());
 
 	objectsSignal = registerSignal("Object");
 }
 
-int Storage::getStorageBytes()
-{
-	int i;
-	int total_size = 0;
-
-	//This is inefficient, since a sequential search will be done for every element in the queue.
-	//TODO: The "forEachChild" method should rather be implemented with an appropriate visitor class.
-	for (i = 0 ; i < storage.getLength() ; i++)
-	{
-		total_size += ((GameObject *)storage.get(i))->getSize();
-	}
-
-	return total_size;
-}
-
-int Storage::getStorageFiles()
-{
-	return storage.getLength();
-}
-
 void Storage::handleMessage(cMessage *msg)
 {
 	simtime_t delay;
@@ -79,9 +61,10 @@ void Storage::handleMessage(cMessage *msg)
 	emit(storeTimeSignal, delay);
 
 	storage.insert(go);
+	totals.add(*go);
 
 	emit(qlenSignal, storage.length());
-	emit(qsizeSignal, getStorageBytes());
+	emit(qsizeSignal, (long)getStorageBytes());
 
 	emit(objectsSignal, 1);
 	emit(storeTimeSignal, delay);
@@ -21,6 +21,7 @@
 #include <omnetpp.h>
 
 #include "GameObject.h"
+#include "StorageTotals.h"
 
 /**
  * Any data that is stored in Pitos is stored in the storage class.
@@ -34,11 +35,14 @@ class Storage : public cSimpleModule
 	public:
 	Storage();
 		virtual ~Storage();
-		int getStorageBytes();
-		int getStorageFiles();
+		int64_t getStorageBytes() { return totals.getBytes(); }
+		int getStorageFiles() { return totals.getObjects(); }
+		int64_t getStorageBytes(int ttl) { return totals.getBucketBytes(ttl); }
 	private:
 
 		cQueue storage; /**< The queue holding all stored GameObjects */
+
+		StorageTotals totals; /**< Running totals of the bytes and objects in the queue */
 	protected:
 
 		simsignal_t qlenSignal; /**< Signal for recording the number of objects stored */
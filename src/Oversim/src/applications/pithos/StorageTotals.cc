@@ -0,0 +1,89 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#include "StorageTotals.h"
+
+StorageTotals::StorageTotals() {
+	bytes = 0;
+	objects = 0;
+	bucket_size = 60;
+}
+
+StorageTotals::~StorageTotals() {
+}
+
+void StorageTotals::setBucketSize(int bucket_size)
+{
+	if (bucket_size <= 0)
+		opp_error("[StorageTotals]: The TTL bucket size should be positive.");
+
+	if (objects > 0)
+		opp_error("[StorageTotals]: The TTL bucket size cannot be changed while objects are stored.");
+
+	this->bucket_size = bucket_size;
+}
+
+void StorageTotals::add(const GameObject &go)
+{
+	bytes += go.getSize();
+	objects++;
+
+	bucket_bytes[getBucket(go.getTTL())] += go.getSize();
+}
+
+void StorageTotals::remove(const GameObject &go)
+{
+	if (objects == 0)
+		opp_error("[StorageTotals]: Removing an object from empty storage.");
+
+	bytes -= go.getSize();
+	objects--;
+
+	BucketMap::iterator it = bucket_bytes.find(getBucket(go.getTTL()));
+
+	if (it == bucket_bytes.end())
+	{
+		//The bucket may already have been dropped if only empty objects are left in it
+		if (go.getSize() == 0)
+			return;
+
+		opp_error("[StorageTotals]: Removing an object from a TTL bucket that holds no bytes.");
+	}
+
+	it->second -= go.getSize();
+
+	//Drop empty buckets, so that the bucket map only holds the TTL ranges that are actually in storage
+	if (it->second == 0)
+		bucket_bytes.erase(it);
+}
+
+int64_t StorageTotals::getBucketBytes(int ttl)
+{
+	BucketMap::iterator it = bucket_bytes.find(getBucket(ttl));
+
+	if (it == bucket_bytes.end())
+		return 0;
+	else return it->second;
+}
+
+void StorageTotals::clear()
+{
+	bytes = 0;
+	objects = 0;
+	bucket_bytes.clear();
+}
@@ -0,0 +1,74 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#ifndef STORAGETOTALS_H_
+#define STORAGETOTALS_H_
+
+#include <omnetpp.h>
+#include <map>
+
+#include "GameObject.h"
+
+/**
+ * Running totals of the objects held by a storage module.
+ * The totals are updated whenever an object is added or removed, so that the number of stored bytes and objects can be
+ * read in O(1) instead of by walking the whole store. Bytes are also totalled per TTL bucket, where every bucket spans
+ * bucket_size seconds of object TTL.
+ *
+ * @author John Gilmore
+ */
+class StorageTotals
+{
+	public:
+		typedef std::map<int, int64_t> BucketMap;	//The first TTL in the bucket mapped to the bytes stored in the bucket
+
+	private:
+		int64_t bytes;
+		unsigned int objects;
+		int bucket_size;	/**< The range of TTLs (in seconds) covered by every bucket */
+
+		BucketMap bucket_bytes;
+
+		int getBucket(int ttl) { return (ttl / bucket_size) * bucket_size; }
+
+	public:
+		StorageTotals();
+		virtual ~StorageTotals();
+
+		/**
+		 * Sets the TTL range of a single bucket. This should be done before any objects are added.
+		 */
+		void setBucketSize(int bucket_size);
+
+		void add(const GameObject &go);
+		void remove(const GameObject &go);
+
+		int64_t getBytes() { return bytes; }
+		unsigned int getObjects() { return objects; }
+
+		/**
+		 * @return the number of bytes stored in objects that fall in the same TTL bucket as the given TTL.
+		 */
+		int64_t getBucketBytes(int ttl);
+
+		BucketMap &getBuckets() { return bucket_bytes; }
+
+		void clear();
+};
+
+#endif /* STORAGETOTALS_H_ */
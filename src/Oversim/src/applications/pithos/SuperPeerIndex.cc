@@ -0,0 +1,223 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#include <algorithm>
+
+#include "SuperPeerIndex.h"
+
+SuperPeerIndex::SuperPeerIndex() {
+	cell_size = 1;
+	columns = 1;
+	rows = 1;
+	last_examined = 0;
+	cells.resize(1);
+}
+
+SuperPeerIndex::~SuperPeerIndex() {
+	clear();
+}
+
+void SuperPeerIndex::setGrid(double world_size, double cell_size)
+{
+	if (world_size <= 0 || cell_size <= 0)
+		opp_error("[SuperPeerIndex]: The world size and cell size should be positive.");
+
+	if (!slots.empty())
+		opp_error("[SuperPeerIndex]: The grid cannot be changed while super peers are stored.");
+
+	this->cell_size = cell_size;
+	columns = (int)ceil(world_size / cell_size);
+	rows = columns;
+
+	cells.clear();
+	cells.resize(columns * rows);
+}
+
+int SuperPeerIndex::getColumn(double latitude)
+{
+	int column = (int)floor(latitude / cell_size);
+
+	if (column < 0)
+		return 0;
+	else if (column >= columns)
+		return columns - 1;
+	else return column;
+}
+
+int SuperPeerIndex::getRow(double longitude)
+{
+	int row = (int)floor(longitude / cell_size);
+
+	if (row < 0)
+		return 0;
+	else if (row >= rows)
+		return rows - 1;
+	else return row;
+}
+
+void SuperPeerIndex::insert(SP_element super_peer)
+{
+	remove(super_peer.getAddress());
+
+	Slot slot;
+	slot.cell = getRow(super_peer.getLongitude()) * columns + getColumn(super_peer.getLatitude());
+	slot.index = cells[slot.cell].size();
+
+	cells[slot.cell].push_back(super_peer);
+	slots.insert(std::make_pair(super_peer.getAddress(), slot));
+}
+
+bool SuperPeerIndex::remove(const TransportAddress &address)
+{
+	SlotMap::iterator slot_it = slots.find(address);
+
+	if (slot_it == slots.end())
+		return false;
+
+	Cell &cell = cells[slot_it->second.cell];
+	unsigned int index = slot_it->second.index;
+
+	//Move the last super peer of the cell into the removed super peer's position
+	cell[index] = cell.back();
+	cell.pop_back();
+
+	if (index < cell.size())
+		slots[cell[index].getAddress()].index = index;
+
+	slots.erase(slot_it);
+
+	return true;
+}
+
+SP_element *SuperPeerIndex::find(const TransportAddress &address)
+{
+	SlotMap::iterator slot_it = slots.find(address);
+
+	if (slot_it == slots.end())
+		return NULL;
+	else return &cells[slot_it->second.cell][slot_it->second.index];
+}
+
+void SuperPeerIndex::examineCell(int column, int row, double latitude, double longitude, unsigned int k, double max_dist2, std::vector<Candidate> &candidates)
+{
+	Cell &cell = cells[row * columns + column];
+
+	for (unsigned int i = 0 ; i < cell.size() ; i++)
+	{
+		Candidate candidate;
+		double d_lat = cell[i].getLatitude() - latitude;
+		double d_long = cell[i].getLongitude() - longitude;
+
+		candidate.dist2 = d_lat*d_lat + d_long*d_long;
+		candidate.element = &cell[i];
+		last_examined++;
+
+		if (candidate.dist2 > max_dist2)
+			continue;
+
+		//The candidates form a max-heap of the k nearest super peers found so far
+		if (candidates.size() < k)
+		{
+			candidates.push_back(candidate);
+			std::push_heap(candidates.begin(), candidates.end());
+		}
+		else if (candidate < candidates.front())
+		{
+			std::pop_heap(candidates.begin(), candidates.end());
+			candidates.back() = candidate;
+			std::push_heap(candidates.begin(), candidates.end());
+		}
+	}
+}
+
+void SuperPeerIndex::findNearest(double latitude, double longitude, unsigned int k, double max_distance, std::vector<SP_element*> &result)
+{
+	std::vector<Candidate> candidates;
+	double max_dist2 = max_distance * max_distance;
+	int column = getColumn(latitude);
+	int row = getRow(longitude);
+	int max_ring = std::max(columns, rows);
+
+	result.clear();
+	last_examined = 0;
+
+	if (k == 0)
+		return;
+
+	for (int ring = 0 ; ring <= max_ring ; ring++)
+	{
+		//Examine the cells whose column or row lies exactly ring cells away from the query cell
+		for (int c = column - ring ; c <= column + ring ; c++)
+		{
+			if (c < 0 || c >= columns)
+				continue;
+
+			for (int r = row - ring ; r <= row + ring ; r++)
+			{
+				if (r < 0 || r >= rows)
+					continue;
+
+				//Skip the cells inside the ring, which were examined by earlier rings
+				if (c != column - ring && c != column + ring && r != row - ring && r != row + ring)
+				{
+					r = row + ring - 1;
+					continue;
+				}
+
+				examineCell(c, r, latitude, longitude, k, max_dist2, candidates);
+			}
+		}
+
+		//Every cell in the following rings lies at least this far from the query position
+		double bound = std::min(std::min(latitude - (column - ring) * cell_size, (column + ring + 1) * cell_size - latitude),
+								std::min(longitude - (row - ring) * cell_size, (row + ring + 1) * cell_size - longitude));
+
+		if (bound > 0)
+		{
+			if (bound * bound > max_dist2)
+				break;
+
+			if (candidates.size() == k && candidates.front().dist2 <= bound * bound)
+				break;
+		}
+	}
+
+	std::sort_heap(candidates.begin(), candidates.end());
+
+	for (unsigned int i = 0 ; i < candidates.size() ; i++)
+		result.push_back(candidates[i].element);
+}
+
+SP_element *SuperPeerIndex::findNearest(double latitude, double longitude, double max_distance)
+{
+	std::vector<SP_element*> result;
+
+	findNearest(latitude, longitude, 1, max_distance, result);
+
+	if (result.empty())
+		return NULL;
+	else return result[0];
+}
+
+void SuperPeerIndex::clear()
+{
+	for (unsigned int i = 0 ; i < cells.size() ; i++)
+		cells[i].clear();
+
+	slots.clear();
+}
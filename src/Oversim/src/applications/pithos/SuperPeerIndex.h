@@ -0,0 +1,130 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#ifndef SUPERPEERINDEX_H_
+#define SUPERPEERINDEX_H_
+
+#include <omnetpp.h>
+#include <vector>
+#include <tr1/unordered_map>
+
+#include <TransportAddress.h>
+
+#include "SP_element.h"
+
+/**
+ * A uniform grid over the super peer positions in the virtual world, used by the directory server to find the super
+ * peers nearest to a joining peer. The world is divided into square cells, and a query only examines the cells in
+ * growing rings around the query position, until no unexamined cell can hold a nearer super peer.
+ *
+ * Super peers may lie outside the world, in which case they are stored in the nearest border cell.
+ *
+ * @author John Gilmore
+ */
+class SuperPeerIndex
+{
+	private:
+		struct Slot
+		{
+			unsigned int cell;		//The cell the super peer is stored in
+			unsigned int index;		//The position of the super peer in the cell's list
+		};
+
+		typedef std::vector<SP_element> Cell;
+		typedef std::tr1::unordered_map<TransportAddress, Slot, TransportAddress::hashFcn> SlotMap;
+
+		/**
+		 * A super peer found by a query, with its squared distance to the query position
+		 */
+		struct Candidate
+		{
+			double dist2;
+			SP_element *element;
+
+			bool operator<(const Candidate& other) const { return dist2 < other.dist2; }
+		};
+
+		std::vector<Cell> cells;
+		SlotMap slots;
+
+		double cell_size;
+		int columns;		/**< The number of cells along the latitude axis */
+		int rows;			/**< The number of cells along the longitude axis */
+
+		unsigned int last_examined;	/**< The number of super peers examined by the last query */
+
+		int getColumn(double latitude);
+		int getRow(double longitude);
+
+		/**
+		 * Examine all super peers in a cell and keep the k nearest ones in the candidates heap.
+		 */
+		void examineCell(int column, int row, double latitude, double longitude, unsigned int k, double max_dist2, std::vector<Candidate> &candidates);
+
+	public:
+		SuperPeerIndex();
+		virtual ~SuperPeerIndex();
+
+		/**
+		 * Divide the world into cells. This should be done before any super peers are inserted.
+		 *
+		 * @param world_size The range of latitudes and longitudes in the world, starting from 0
+		 * @param cell_size The length of the side of a cell
+		 */
+		void setGrid(double world_size, double cell_size);
+
+		/**
+		 * Add a super peer to the index. If a super peer with the same address is already present, it is moved to the new position.
+		 */
+		void insert(SP_element super_peer);
+
+		/**
+		 * @return false if no super peer with the given address is present
+		 */
+		bool remove(const TransportAddress &address);
+
+		bool contains(const TransportAddress &address) { return slots.find(address) != slots.end(); }
+
+		/**
+		 * @return the super peer with the given address, or NULL if it is not present
+		 */
+		SP_element *find(const TransportAddress &address);
+
+		/**
+		 * @return the super peer nearest to the given position, or NULL if no super peer lies within max_distance.
+		 */
+		SP_element *findNearest(double latitude, double longitude, double max_distance);
+
+		/**
+		 * Find the k super peers nearest to the given position, that lie within max_distance.
+		 *
+		 * @param result The super peers found, nearest first
+		 */
+		void findNearest(double latitude, double longitude, unsigned int k, double max_distance, std::vector<SP_element*> &result);
+
+		unsigned int size() { return slots.size(); }
+
+		/**
+		 * @return the number of super peers whose distance was calculated by the last query
+		 */
+		unsigned int getLastExamined() { return last_examined; }
+
+		void clear();
+};
+
+#endif /* SUPERPEERINDEX_H_ */
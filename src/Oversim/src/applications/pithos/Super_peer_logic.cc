@@ -13,16 +13,23 @@
 // along with this program.  If not, see http://www.gnu.org/licenses/.
 // 
 
+#include <algorithm>
+
 #include "Super_peer_logic.h"
 
 Super_peer_logic::Super_peer_logic()
 {
+	loadReportTimer = NULL;
+	membershipTimer = NULL;
 }
 
 Super_peer_logic::~Super_peer_logic()
 {
 	if (objectRepair && periodicRepair)
 		cancelAndDelete(repairTimer);
+
+	cancelAndDelete(loadReportTimer);
+	cancelAndDelete(membershipTimer);
 }
 
 void Super_peer_logic::initialize()
@@ -66,11 +73,34 @@ void Super_peer_logic::initialize()
 			repairTime = par("repairTime");
 	}
 
+	loadReportInterval = par("loadReportInterval");
+	loadReportTimer = new cMessage("loadReportTimer");
+	numObjectAdds = 0;
+
+	membershipDeltaInterval = par("membershipDeltaInterval");
+	membershipTimer = new cMessage("membershipTimer");
+	membership_log.setCapacity(par("membershipLogSize"));
+	numMembershipDeltas = 0;
+
+	if (strcmp(par("groupMode"), "partial") == 0)
+	{
+		partialGroup = true;
+	}
+	else if (strcmp(par("groupMode"), "full") == 0)
+	{
+		partialGroup = false;
+	}else error("Invalid group mode specified. It should be \"full\", or \"partial\"");
+
+	viewSize = par("viewSize");
+	gossipFanout = par("gossipFanout");
+	seededEpoch = 0;
+
 	event = new cMessage("event");
 	scheduleAt(simTime()+par("wait_time"), event);
 
 	WATCH(numPeerArrivals);
 	WATCH(numPeerDepartures);
+	WATCH(numMembershipDeltas);
 }
 
 void Super_peer_logic::finish()
@@ -125,13 +155,15 @@ void Super_peer_logic::addObject(PeerListPkt *plist_p)
 {
 	PeerData peer_data_recv;
 
+	numObjectAdds++;
+
 	//Iterate through all PeerData objects received in the PeerListPkt
 	for (unsigned int i = 0 ; i < plist_p->getPeer_listArraySize() ; i++)
 	{
 		peer_data_recv = ((PeerData)plist_p->getPeer_list(i));
 
 		//Check whether this peer didn't just leave the group and this message is in fact a delayed out dated message
-		if ((lastPeerLeft.getAddress().isUnspecified()) || (peer_data_recv != lastPeerLeft))
+		if (!membership_log.hasLeft(peer_data_recv))
 		{
 			//Both the object and peer data have to be sent, because the two are linked in the ledger
 			group_ledger->addObject(plist_p->getObjectData(), peer_data_recv);
@@ -139,28 +171,16 @@ void Super_peer_logic::addObject(PeerListPkt *plist_p)
 	}
 }
 
-void Super_peer_logic::informGroupPeers(bootstrapPkt *boot_req, TransportAddress sourceAdr)
+void Super_peer_logic::addObjectBatch(ObjectListPkt *list_p)
 {
-	PeerData peer_data(boot_req->getSourceAddress());
-	PeerListPkt *list_p = new PeerListPkt();
-
-	list_p->setName("peer_join");
-	list_p->setPayloadType(PEER_JOIN);
-	list_p->setSourceAddress(sourceAdr);
-	list_p->setGroupAddress(sourceAdr);
-	list_p->setObjectData(ObjectData::UNSPECIFIED_OBJECT);
-	list_p->addToPeerList(peer_data);
-	list_p->setByteLength(PEERLIST_PKT_SIZE(PEERDATA_SIZE));
+	numObjectAdds += list_p->getObjectDataArraySize();
 
-	for (unsigned int i = 0 ; i < group_ledger->getGroupSize() ; i++)
-	{
-		//group_peers.at(i) returns a PeerDataPtr, which has to be dereferenced to return a PeerData object
-		list_p->setDestinationAddress((*(group_ledger->getPeerPtr(i))).getAddress());
-
-		send(list_p->dup(), "comms_gate$o");
-	}
+	//Check whether this peer didn't just leave the group and this message is in fact a delayed out dated message
+	if (membership_log.hasLeft(list_p->getPeerData()))
+		return;
 
-	delete(list_p);
+	for (unsigned int i = 0 ; i < list_p->getObjectDataArraySize() ; i++)
+		group_ledger->addObject(list_p->getObjectData(i), list_p->getPeerData());
 }
 
 void Super_peer_logic::informJoiningPeer(bootstrapPkt *boot_req, TransportAddress sourceAdr)
@@ -177,12 +197,29 @@ void Super_peer_logic::informJoiningPeer(bootstrapPkt *boot_req, TransportAddres
 	//Inform the joining peer of all peers in the group, in case there are peers that do not store any objects.
 	//TODO: This should be changed to only inform the joining peer of the peers with no objects.
 	list_p->setObjectData(ObjectData::UNSPECIFIED_OBJECT);
-	list_p->setByteLength(PEERLIST_PKT_SIZE (PEERDATA_SIZE*(group_ledger->getGroupSize())));	//Peerlist packet size + peerdata inserted
+	list_p->setMembershipEpoch(membership_log.getEpoch());
 
-	for (unsigned int i = 0 ; i < group_ledger->getGroupSize() ; i++)
+	if (partialGroup)
 	{
-		list_p->addToPeerList(*(group_ledger->getPeerPtr(i)));	//Send a copy of the object, pointed to by the smart pointer
+		//In a partially connected group, the joining peer is only informed of itself and a random sample of the group, which forms its initial view
+		std::vector<PeerData> sample;
+		PeerData joining_peer(boot_req->getSourceAddress());
+
+		getRandomPeers(viewSize + 1, sample);
+
+		list_p->addToPeerList(joining_peer);
+		for (unsigned int i = 0 ; i < sample.size() && list_p->getPeer_listArraySize() <= viewSize ; i++)
+		{
+			if (sample[i] != joining_peer)
+				list_p->addToPeerList(sample[i]);
+		}
+	} else {
+		for (unsigned int i = 0 ; i < group_ledger->getGroupSize() ; i++)
+		{
+			list_p->addToPeerList(*(group_ledger->getPeerPtr(i)));	//Send a copy of the object, pointed to by the smart pointer
+		}
 	}
+	list_p->setByteLength(PEERLIST_PKT_SIZE (PEERDATA_SIZE*(list_p->getPeer_listArraySize()) + 4));	//Peerlist packet size + peerdata inserted + membership epoch
 	send(list_p->dup(), "comms_gate$o");	//Send a copy of the peer list, so the original packet may be reused to inform the other nodes
 	list_p->clearPeerList();
 
@@ -220,9 +257,6 @@ void Super_peer_logic::handleJoinReq(cMessage *msg)
 
 	//std::cout << "Super peer received bootstrap request from " << boot_req->getSourceAddress() << endl;
 
-	//Inform all other nodes in the group of the joining node
-	informGroupPeers(boot_req, sourceAdr);
-
 	/**
 	 * Add the data of the requesting peer into the list.
 	 *
@@ -231,11 +265,15 @@ void Super_peer_logic::handleJoinReq(cMessage *msg)
 	 * informs the higher layer that it has successfully joined a group.
 	**/
 	group_ledger->addPeer(joining_peer);
-	lastPeerJoined = joining_peer;
+	membership_log.record(joining_peer, true);
 	RECORD_STATS(numPeerArrivals++);
 
 	informJoiningPeer(boot_req, sourceAdr);
 
+	//The joining peer is informed of the current membership, and the other group peers are sent the change
+	peer_epochs[joining_peer.getAddress()] = membership_log.getEpoch();
+	membershipChanged();
+
 	//The original message is deleted in the calling function.
 }
 
@@ -257,7 +295,8 @@ void Super_peer_logic::addSuperPeer()
 	boot_p->setName("super_peer_add");
 	boot_p->setLatitude(latitude);
 	boot_p->setLongitude(longitude);
-	boot_p->setByteLength(BOOTSTRAP_PKT_SIZE);
+	boot_p->setLoadReportInterval(loadReportInterval);
+	boot_p->setByteLength(BOOTSTRAP_PKT_SIZE + 8);	//Bootstrap packet + load report interval
 
 	send(boot_p, "comms_gate$o");
 
@@ -266,23 +305,204 @@ void Super_peer_logic::addSuperPeer()
 	//TODO: Add resend or timer that checks whether the join request has been handled by the Directory.
 }
 
-void Super_peer_logic::informLastJoinedOfLastLeft()
+void Super_peer_logic::reportLoad()
+{
+	IPAddress dest_ip(directory_ip);
+	TransportAddress dest_adr(dest_ip, directory_port);
+
+	const NodeHandle *thisNode = &(((BaseApp *)getParentModule()->getSubmodule("communicator"))->getThisNode());
+	TransportAddress sourceAdr(thisNode->getIp(), thisNode->getPort());
+
+	SuperPeerLoadPkt *load_p = new SuperPeerLoadPkt("super_peer_load");
+	load_p->setSourceAddress(sourceAdr);
+	load_p->setDestinationAddress(dest_adr);
+	load_p->setPayloadType(SUPER_PEER_LOAD);
+	load_p->setGroupSize(group_ledger->getGroupSize());
+	load_p->setStoredBytes(group_ledger->getDataSize());
+	load_p->setObjectAddRate(numObjectAdds / loadReportInterval);
+	load_p->setByteLength(SP_LOAD_PKT_SIZE);
+
+	numObjectAdds = 0;
+
+	send(load_p, "comms_gate$o");
+}
+
+void Super_peer_logic::membershipChanged()
+{
+	if (membershipDeltaInterval == 0)
+		sendMembershipDeltas();
+	else if (!membershipTimer->isScheduled())
+		scheduleAt(simTime()+membershipDeltaInterval, membershipTimer);
+}
+
+MembershipDeltaPkt *Super_peer_logic::createMembershipDelta(unsigned int since)
+{
+	std::vector<PeerData> joined, left;
+	MembershipDeltaPkt *delta_p = new MembershipDeltaPkt("membership_delta");
+
+	const NodeHandle *thisNode = &(((BaseApp *)getParentModule()->getSubmodule("communicator"))->getThisNode());
+	TransportAddress sourceAdr(thisNode->getIp(), thisNode->getPort());
+
+	delta_p->setSourceAddress(sourceAdr);
+	delta_p->setGroupAddress(sourceAdr);
+	delta_p->setPayloadType(MEMBERSHIP_DELTA);
+	delta_p->setToEpoch(membership_log.getEpoch());
+
+	if (membership_log.getDelta(since, joined, left))
+	{
+		delta_p->setFromEpoch(since);
+		delta_p->setSnapshot(false);
+	} else {
+		//The changes since the peer's epoch have been forgotten, so the peer is sent the whole group instead
+		for (unsigned int i = 0 ; i < group_ledger->getGroupSize() ; i++)
+			joined.push_back(*(group_ledger->getPeerPtr(i)));
+
+		delta_p->setFromEpoch(0);
+		delta_p->setSnapshot(true);
+	}
+
+	delta_p->setJoinedArraySize(joined.size());
+	for (unsigned int i = 0 ; i < joined.size() ; i++)
+		delta_p->setJoined(i, joined[i]);
+
+	delta_p->setLeftArraySize(left.size());
+	for (unsigned int i = 0 ; i < left.size() ; i++)
+		delta_p->setLeft(i, left[i]);
+
+	delta_p->setByteLength(MEMBERSHIP_DELTA_PKT_SIZE(joined.size() + left.size()));
+
+	RECORD_STATS(numMembershipDeltas++);
+	RECORD_STATS(globalStatistics->recordOutVector("Super_peer_logic: membership delta size", joined.size() + left.size()));
+
+	return delta_p;
+}
+
+void Super_peer_logic::sendMembershipDeltas()
 {
-	PeerDataPkt *pkt = new PeerDataPkt("peerLeft");
+	//Most peers have been informed up to the same epoch, so a delta is only created once for every distinct epoch
+	std::map<unsigned int, MembershipDeltaPkt *> deltas;
+	std::map<unsigned int, MembershipDeltaPkt *>::iterator delta_it;
+
+	if (membershipTimer->isScheduled())
+		cancelEvent(membershipTimer);
+
+	if (partialGroup)
+	{
+		seedMembershipRumors();
+		return;
+	}
+
+	for (unsigned int i = 0 ; i < group_ledger->getGroupSize() ; i++)
+	{
+		TransportAddress peer_adr = group_ledger->getPeerPtr(i)->getAddress();
+		unsigned int &peer_epoch = peer_epochs[peer_adr];
+
+		if (peer_epoch >= membership_log.getEpoch())
+			continue;
+
+		delta_it = deltas.find(peer_epoch);
+		if (delta_it == deltas.end())
+			delta_it = deltas.insert(std::make_pair(peer_epoch, createMembershipDelta(peer_epoch))).first;
+
+		MembershipDeltaPkt *delta_p = delta_it->second->dup();
+		delta_p->setDestinationAddress(peer_adr);
+		send(delta_p, "comms_gate$o");
+
+		peer_epoch = membership_log.getEpoch();
+	}
+
+	for (delta_it = deltas.begin() ; delta_it != deltas.end() ; delta_it++)
+		delete(delta_it->second);
+}
+
+void Super_peer_logic::getRandomPeers(unsigned int n, std::vector<PeerData> &sample)
+{
+	std::vector<unsigned int> indices(group_ledger->getGroupSize());
+
+	for (unsigned int i = 0 ; i < indices.size() ; i++)
+		indices[i] = i;
+
+	if (n > indices.size())
+		n = indices.size();
+
+	//A partial Fisher-Yates shuffle of the first n positions
+	for (unsigned int i = 0 ; i < n ; i++)
+	{
+		unsigned int j = intuniform(i, indices.size()-1);
+		std::swap(indices[i], indices[j]);
+		sample.push_back(*(group_ledger->getPeerPtr(indices[i])));
+	}
+}
+
+void Super_peer_logic::seedMembershipRumors()
+{
+	std::vector<PeerData> joined, left, targets;
+	unsigned int epoch = membership_log.getEpoch();
+
+	if (seededEpoch >= epoch)
+		return;
+
+	//If too many changes happened since the last seed, the current members and all retained departures are spread instead
+	if (!membership_log.getDelta(seededEpoch, joined, left))
+	{
+		for (unsigned int i = 0 ; i < group_ledger->getGroupSize() ; i++)
+			joined.push_back(*(group_ledger->getPeerPtr(i)));
+
+		membership_log.getLeft(left);
+	}
+
+	seededEpoch = epoch;
 
 	const NodeHandle *thisNode = &(((BaseApp *)getParentModule()->getSubmodule("communicator"))->getThisNode());
 	TransportAddress sourceAdr(thisNode->getIp(), thisNode->getPort());
 
-	pkt->setSourceAddress(sourceAdr);
-	pkt->setGroupAddress(sourceAdr);
-	pkt->setPayloadType(PEER_LEFT);
-	pkt->setPeerData(lastPeerLeft);
-	pkt->setByteLength(PEERDATA_PKT_SIZE);	//Source IP + Dest IP + type + left peer IP
+	//Every change is stamped with the current epoch, which is never earlier than the epoch in which it happened
+	GossipPkt *gossip_p = new GossipPkt("gossip");
+	gossip_p->setSourceAddress(sourceAdr);
+	gossip_p->setGroupAddress(sourceAdr);
+	gossip_p->setPayloadType(GOSSIP);
+	gossip_p->setIsReply(true);	//The super peer does not take part in the exchange itself
+
+	gossip_p->setMembersArraySize(joined.size() + left.size());
+	gossip_p->setMemberEpochsArraySize(joined.size() + left.size());
+	gossip_p->setMemberJoinedArraySize(joined.size() + left.size());
+
+	for (unsigned int i = 0 ; i < joined.size() + left.size() ; i++)
+	{
+		gossip_p->setMembers(i, (i < joined.size()) ? joined[i] : left[i - joined.size()]);
+		gossip_p->setMemberEpochs(i, epoch);
+		gossip_p->setMemberJoined(i, i < joined.size());
+	}
+
+	gossip_p->setByteLength(GOSSIP_PKT_SIZE(0, 0, joined.size() + left.size()));
+
+	getRandomPeers(gossipFanout, targets);
+
+	for (unsigned int i = 0 ; i < targets.size() ; i++)
+	{
+		gossip_p->setDestinationAddress(targets[i].getAddress());
+		send(gossip_p->dup(), "comms_gate$o");
+	}
+
+	RECORD_STATS(numMembershipDeltas += targets.size());
+	RECORD_STATS(globalStatistics->recordOutVector("Super_peer_logic: membership delta size", joined.size() + left.size()));
+
+	delete(gossip_p);
+}
+
+void Super_peer_logic::handleMembershipSync(MembershipSyncPkt *sync_p)
+{
+	TransportAddress peer_adr = sync_p->getSourceAddress();
+
+	//Peers that are no longer in the group are not informed of its changes
+	if (!group_ledger->isPeerInGroup(PeerData(peer_adr)))
+		return;
 
-	//Dereference it to get PeerDataPtr and use -> operator to get PeerData
-	pkt->setDestinationAddress(lastPeerJoined.getAddress());
+	peer_epochs[peer_adr] = membership_log.getEpoch();
 
-	send(pkt, "comms_gate$o");
+	MembershipDeltaPkt *delta_p = createMembershipDelta(sync_p->getEpoch());
+	delta_p->setDestinationAddress(peer_adr);
+	send(delta_p, "comms_gate$o");
 }
 
 void Super_peer_logic::repairMissingReplicas()
@@ -393,13 +613,20 @@ void Super_peer_logic::replicateObjectsOfPeer(PeerDataPkt *peer_data_pkt)
 
 void Super_peer_logic::handlePeerLeaving(PeerData peer_data)
 {
+	//A peer can be reported more than once, e.g. when several group peers detect its failure
+	bool wasInGroup = group_ledger->isPeerInGroup(peer_data);
+
 	group_ledger->removePeer(peer_data);
 	RECORD_STATS(numPeerDepartures++);
 
-	lastPeerLeft = peer_data;	//Record the data of the last peer that left, in case we get an outdated object add message from that peer
+	if (!wasInGroup)
+		return;
+
+	//The log also records that the peer left, in case we get an outdated object add message from that peer
+	membership_log.record(peer_data, false);
+	peer_epochs.erase(peer_data.getAddress());
 
-	//Inform the last peer that joined of the last peer that left, in case the peer that left did not know about the peer that joined.
-	informLastJoinedOfLastLeft();
+	membershipChanged();
 }
 
 void Super_peer_logic::handleMessage(cMessage *msg)
@@ -414,8 +641,22 @@ void Super_peer_logic::handleMessage(cMessage *msg)
 			//Initialise the repair timer
 			scheduleAt(simTime(), repairTimer);
 		}
+
+		if (loadReportInterval > 0)
+			scheduleAt(simTime()+loadReportInterval, loadReportTimer);
+
 		delete(msg);
 	}
+	else if (msg == membershipTimer)
+	{
+		sendMembershipDeltas();
+	}
+	else if (msg == loadReportTimer)
+	{
+		scheduleAt(simTime()+loadReportInterval, loadReportTimer);
+
+		reportLoad();
+	}
 	else if (msg == repairTimer)
 	{
 		scheduleAt(simTime()+repairTime, repairTimer);
@@ -434,6 +675,12 @@ void Super_peer_logic::handleMessage(cMessage *msg)
 			PeerListPkt *plist_p = check_and_cast<PeerListPkt *>(msg);
 
 			addObject(plist_p);
+		} else if (packet->getPayloadType() == SP_OBJECT_ADD_BATCH)
+		{
+			addObjectBatch(check_and_cast<ObjectListPkt *>(msg));
+		} else if (packet->getPayloadType() == SP_MEMBERSHIP_SYNC)
+		{
+			handleMembershipSync(check_and_cast<MembershipSyncPkt *>(msg));
 		} else if (packet->getPayloadType() == SP_PEER_LEFT)
 		{
 			PeerDataPkt *peer_data_pkt = check_and_cast<PeerDataPkt *>(packet);
@@ -25,6 +25,7 @@
 #include "Peer_logic.h"
 #include "OverlayKey.h"
 #include "GroupLedger.h"
+#include "MembershipLog.h"
 
 #include "PeerListPkt.h"
 #include "PeerData.h"
@@ -52,14 +53,29 @@ class Super_peer_logic : public cSimpleModule
 
 		int directory_port; /**< The port of the directory server */
 
-		PeerData lastPeerLeft;		/**< The peer data of the last peer that left the group */
-		PeerData lastPeerJoined;	/**< The peer data of the last peer that joined the group */
+		typedef std::tr1::unordered_map<TransportAddress, unsigned int, TransportAddress::hashFcn> PeerEpochMap;
+
+		MembershipLog membership_log;	/**< The epoch-numbered log of the peers that joined and left the group */
+		PeerEpochMap peer_epochs;		/**< The last membership epoch every group peer has been informed of */
+
+		double membershipDeltaInterval;	/**< The time membership changes are collected before the group peers are informed, or 0 to inform them immediately */
+		cMessage *membershipTimer;		/**< timer self-message for sending the collected membership changes to the group */
+		long numMembershipDeltas;		/**< The number of membership delta packets sent */
+
+		bool partialGroup;				/**< true if the group peers only keep a bounded view and learn of membership changes by gossip */
+		unsigned int viewSize;			/**< The number of group peers a joining peer is informed of in a partially connected group */
+		unsigned int gossipFanout;		/**< The number of group peers that are sent a membership change to start spreading it */
+		unsigned int seededEpoch;		/**< The last membership epoch that has been handed to the group peers for gossiping */
 
 		bool objectRepair;
 		bool periodicRepair;
 		double repairTime;
 		cMessage *repairTimer; 	/**< timer self-message for repairing failed object replicas in periodic repair mode */
 
+		double loadReportInterval;	/**< The time between load reports to the directory server, or 0 if no reports are sent */
+		cMessage *loadReportTimer;	/**< timer self-message for reporting the group load to the directory server */
+		int numObjectAdds;			/**< The number of object additions received since the last load report */
+
 		GroupLedger *group_ledger;
 
 		int numPeerArrivals;
@@ -97,8 +113,6 @@ class Super_peer_logic : public cSimpleModule
 		 */
 		void handleP2PMsg(cMessage *msg);
 
-		void informGroupPeers(bootstrapPkt *boot_req, TransportAddress sourceAdr);
-
 		void informJoiningPeer(bootstrapPkt *boot_req, TransportAddress sourceAdr);
 
 		/**
@@ -111,10 +125,47 @@ class Super_peer_logic : public cSimpleModule
 		/** Send a message to add this super peer to the directory server */
 		void addSuperPeer();
 
+		/** Report the size, stored bytes and request rate of this super peer's group to the directory server */
+		void reportLoad();
+
 		/** Add a new group object to the super peer's object list. */
 		void addObject(PeerListPkt *plist_p);
 
-		void informLastJoinedOfLastLeft();
+		/** Add a batch of group objects, all stored on the same peer, to the super peer's object list. */
+		void addObjectBatch(ObjectListPkt *list_p);
+
+		/** Inform the group peers of a membership change, either immediately or when the membership timer expires. */
+		void membershipChanged();
+
+		/** Send every group peer the membership changes since the last epoch it has been informed of. */
+		void sendMembershipDeltas();
+
+		/**
+		 * Create a delta packet of the membership changes since the given epoch.
+		 * If the changes are no longer in the membership log, a snapshot of the full group is created instead.
+		 *
+		 * @param since The last epoch the receiving peer has been informed of
+		 * @return a delta packet without a destination address
+		 */
+		MembershipDeltaPkt *createMembershipDelta(unsigned int since);
+
+		/**
+		 * In a partially connected group, send the membership changes since the last seeded epoch to a few random
+		 * group peers, which spread them through the group by gossip. If the changes have already been forgotten,
+		 * the current members and the departed peers still in the membership log are sent instead.
+		 */
+		void seedMembershipRumors();
+
+		/**
+		 * Append a random sample of the group peers to a list.
+		 *
+		 * @param n The maximum number of peers in the sample
+		 * @param sample The list the sample is appended to
+		 */
+		void getRandomPeers(unsigned int n, std::vector<PeerData> &sample);
+
+		/** Handle a group peer that missed membership changes and asks to be sent the changes since its epoch. */
+		void handleMembershipSync(MembershipSyncPkt *sync_p);
 
 		void replicateObjectsOfPeer(PeerDataPkt *peer_data_pkt);
 
@@ -21,6 +21,8 @@
  * @author Ingmar Baumgart
  */
 
+#include <cmath>
+
 #include <omnetpp.h>
 
 #include <GlobalStatisticsAccess.h>
@@ -28,6 +30,7 @@
 #include <DHTTestAppMessages_m.h>
 
 #include "GlobalPithosTestMap.h"
+#include "PithosTestApp.h"
 
 using namespace std;
 
@@ -36,13 +39,25 @@ Define_Module(GlobalPithosTestMap);
 GlobalPithosTestMap::GlobalPithosTestMap()
 {
     periodicTimer = NULL;
+    expiryTimer = NULL;
+    traceTimer = NULL;
+    keyDistribution = UNIFORM_KEYS;
+    hotspotOffset = 0;
+    recencyBase = 0;
+    recencyDead = 0;
 }
 
 GlobalPithosTestMap::~GlobalPithosTestMap()
 {
     cancelAndDelete(periodicTimer);
+    cancelAndDelete(expiryTimer);
+    cancelAndDelete(traceTimer);
+    traceReader.close();
     dataMap.clear();
+    keyList.clear();
+    keyPositions.clear();
     groupMap.clear();
+    recencyList.clear();
 }
 
 void GlobalPithosTestMap::initialize()
@@ -50,30 +65,160 @@ void GlobalPithosTestMap::initialize()
     globalStatistics = GlobalStatisticsAccess().get();
     WATCH_MAP(dataMap);
 
+    lastHashComputations = GameObject::hashComputations;
+    lastHashCacheHits = GameObject::hashCacheHits;
+
     periodicTimer = new cMessage("PithosTestMapTimer");
 
     scheduleAt(simTime(), periodicTimer);
+
+    expiryTimer = new cMessage("PithosTestMapExpiryTimer");
+    expiry_wheel.setResolution(par("expiryResolution").doubleValue());
+
+    if (strcmp(par("keyDistribution"), "uniform") == 0)
+        keyDistribution = UNIFORM_KEYS;
+    else if (strcmp(par("keyDistribution"), "zipf") == 0)
+        keyDistribution = ZIPF_KEYS;
+    else if (strcmp(par("keyDistribution"), "hotspot") == 0)
+        keyDistribution = HOTSPOT_KEYS;
+    else if (strcmp(par("keyDistribution"), "recency") == 0)
+        keyDistribution = RECENCY_KEYS;
+    else error("Invalid key distribution specified. It should be \"uniform\", \"zipf\", \"hotspot\" or \"recency\"");
+
+    zipfExponent = par("zipfExponent");
+    hotspotFraction = par("hotspotFraction");
+    hotspotProbability = par("hotspotProbability");
+    hotspotMoveInterval = par("hotspotMoveInterval");
+    recencyMean = par("recencyMean");
+
+    if (zipfExponent <= 0)
+        error("The Zipf exponent should be positive.");
+    if (hotspotFraction <= 0 || hotspotFraction > 1)
+        error("The hotspot fraction should be in (0, 1].");
+    if (hotspotProbability < 0 || hotspotProbability > 1)
+        error("The hotspot probability should be in [0, 1].");
+    if (recencyMean < 0)
+        error("The recency mean should not be negative.");
+
+    nextHotspotMove = simTime() + hotspotMoveInterval;
+
+    numTraceReplayed = 0;
+    numTraceSkipped = 0;
+    numOverwrites = 0;
+    traceIndex = 0;
+    traceTimer = new cMessage("PithosTestMapTraceTimer");
+
+    WATCH(numTraceReplayed);
+    WATCH(numTraceSkipped);
+    WATCH(numOverwrites);
+
+    //Replay the workload from a trace file instead of generating it
+    if (strcmp(par("traceFile"), "") != 0)
+    {
+        traceOffset = par("traceOffset");
+        traceReader.open(par("traceFile").stdstringValue(), (size_t)par("traceWindowSize").longValue());
+
+        if (traceReader.read(traceIndex, traceRecord))
+            scheduleAt(traceOffset + traceRecord.timestamp, traceTimer);
+    }
+}
+
+void GlobalPithosTestMap::registerTraceApp(unsigned int node, PithosTestApp* app)
+{
+    Enter_Method_Silent();
+
+    if (!traceApps.insert(std::make_pair(node, app)).second)
+        error("[GlobalPithosTestMap] Two applications replay the trace records of node %u.", node);
+}
+
+void GlobalPithosTestMap::unregisterTraceApp(unsigned int node)
+{
+    Enter_Method_Silent();
+
+    traceApps.erase(node);
+}
+
+void GlobalPithosTestMap::replayTrace()
+{
+    std::map<unsigned int, PithosTestApp*>::iterator app_it;
+
+    //Pass every record that is due to its node. Records with equal timestamps are replayed in file order.
+    do {
+        app_it = traceApps.find(traceRecord.node);
+
+        if (app_it != traceApps.end() && app_it->second->handleTraceRecord(traceRecord))
+            numTraceReplayed++;
+        else numTraceSkipped++;
+
+        traceIndex++;
+
+        if (!traceReader.read(traceIndex, traceRecord))
+            return;
+
+    } while (traceOffset + traceRecord.timestamp <= simTime());
+
+    scheduleAt(traceOffset + traceRecord.timestamp, traceTimer);
+}
+
+void GlobalPithosTestMap::scheduleExpiryTimer()
+{
+    simtime_t wakeup = expiry_wheel.getTimerWakeup(expiryTimer);
+
+    if (wakeup < 0)
+        return;
+
+    cancelEvent(expiryTimer);
+    scheduleAt(wakeup, expiryTimer);
 }
 
 void GlobalPithosTestMap::finish()
 {
+    if (traceReader.isOpen())
+    {
+        globalStatistics->addStdDev("GlobalPithosTestMap: Trace records replayed", numTraceReplayed);
+        globalStatistics->addStdDev("GlobalPithosTestMap: Trace records skipped", numTraceSkipped);
+        globalStatistics->addStdDev("GlobalPithosTestMap: Records overwritten", numOverwrites);
+    }
+
+    //Records that were still stored at the end of the simulation also contribute their access counts
+    for (KeyPositionMap::iterator it = keyPositions.begin() ; it != keyPositions.end() ; it++)
+        RECORD_STATS(globalStatistics->addStdDev("GlobalPithosTestMap: Accesses per object", it->second.accesses));
+
+    globalStatistics->addStdDev("GlobalPithosTestMap: Total GameObject SHA-1 computations", GameObject::hashComputations);
+    globalStatistics->addStdDev("GlobalPithosTestMap: Total GameObject hash cache hits", GameObject::hashCacheHits);
 }
 
 void GlobalPithosTestMap::handleMessage(cMessage* msg)
 {
     //cleanupDataMap();
-    DhtTestEntryTimer *entryTimer = NULL;
-
     if (msg == periodicTimer)
     {
         RECORD_STATS(globalStatistics->recordOutVector(
            "GlobalPithosTestMap: Number of stored Pithos entries", dataMap.size()));
+
+        //Measures how many SHA-1 hashes of game objects are computed and how many are served from the objects' hash caches
+        RECORD_STATS(globalStatistics->recordOutVector(
+           "GlobalPithosTestMap: GameObject SHA-1 computations per second", double(GameObject::hashComputations - lastHashComputations)/TEST_MAP_INTERVAL));
+        RECORD_STATS(globalStatistics->recordOutVector(
+           "GlobalPithosTestMap: GameObject hash cache hits per second", double(GameObject::hashCacheHits - lastHashCacheHits)/TEST_MAP_INTERVAL));
+        lastHashComputations = GameObject::hashComputations;
+        lastHashCacheHits = GameObject::hashCacheHits;
         scheduleAt(simTime() + TEST_MAP_INTERVAL, msg);
 
-    } else if ((entryTimer = dynamic_cast<DhtTestEntryTimer*>(msg)) != NULL)
+    } else if (msg == expiryTimer)
     {
-    	eraseEntry(entryTimer->getKey());
-        delete msg;
+        std::vector<OverlayKey> expired;
+
+        expiry_wheel.advance(simTime(), expired);
+
+        for (unsigned int i = 0 ; i < expired.size() ; i++)
+            eraseEntry(expired[i]);
+
+        scheduleExpiryTimer();
+
+    } else if (msg == traceTimer)
+    {
+        replayTrace();
 
     } else {
         throw cRuntimeError("GlobalPithosTestMap::handleMessage(): "
@@ -85,43 +230,76 @@ void GlobalPithosTestMap::insertEntry(const OverlayKey& key, const GameObject& e
 {
     Enter_Method_Silent();
 
-    //Insert the entry into the groupMap
-    std::map<TransportAddress, std::vector<GameObject> >::iterator it;
+    //A record that is PUT again replaces the stored one
+    std::map<OverlayKey, GameObject>::iterator it = dataMap.find(key);
+    if (it != dataMap.end())
+    {
+    	numOverwrites++;
+
+    	//In the same group the record keeps its position in the key lists, and only its value and expiry change
+    	if (keyPositions[key].groupAddress == entry.getGroupAddress())
+    	{
+    		it->second = entry;
+    		expiry_wheel.schedule(key, entry.getCreationTime()+entry.getTTL());
+    		scheduleExpiryTimer();
+    		return;
+    	}
+
+    	//The record moved to another group, so it is removed from the old group's key list first
+    	eraseEntry(key);
+    }
+
+    //Insert the entry into the key map
+    dataMap.insert(make_pair(key, entry));
+
+    //Append the key to the dense key list and to its group's key list in O(1)
+    KeyList &group_keys = groupMap[entry.getGroupAddress()];
 
-    //std::cout << "Inserted new object with group address: " << entry.getGroupAddress() << endl;
+    KeyPosition position;
+    position.groupAddress = entry.getGroupAddress();
+    position.keyIndex = keyList.size();
+    position.groupIndex = group_keys.size();
+    position.accesses = 0;
+    position.recencyIndex = 0;
 
-    //Find group in group map in O(log m), where m is the number of groups
-    it = groupMap.find(entry.getGroupAddress());
-    if (it == groupMap.end())
+    if (keyDistribution == RECENCY_KEYS)
     {
-    	std::vector<GameObject> object_list;
-    	object_list.push_back(entry);
-    	groupMap.insert(std::make_pair(entry.getGroupAddress(), object_list));
+        RecencyEntry recency_entry;
+        recency_entry.key = key;
+        recency_entry.live = true;
 
-    } else {
-    	it->second.push_back(entry);
+        position.recencyIndex = recencyBase + recencyList.size();
+        recencyList.push_back(recency_entry);
     }
 
-    //Check whether the key has already been inserted (this might be unnecessary and require extra O(log n), but it's for safety's sake)
-    if (dataMap.find(key) != dataMap.end())
-    	error("Trying to insert overlay key that already exists.");
+    keyList.push_back(key);
+    group_keys.push_back(key);
+    keyPositions.insert(std::make_pair(key, position));
 
-    //Insert the entry into the key map
-    dataMap.insert(make_pair(key, entry));
+    expiry_wheel.schedule(key, entry.getCreationTime()+entry.getTTL());
+    scheduleExpiryTimer();
+}
 
-    DhtTestEntryTimer* msg = new DhtTestEntryTimer("dhtEntryTimer");
-    msg->setKey(key);
+OverlayKey GlobalPithosTestMap::removeKeyAt(KeyList& key_list, unsigned int index)
+{
+	key_list[index] = key_list.back();
+	key_list.pop_back();
 
-    scheduleAt(entry.getCreationTime()+entry.getTTL(), msg);
+	if (index < key_list.size())
+		return key_list[index];
+	else return OverlayKey::UNSPECIFIED_KEY;
 }
 
 void GlobalPithosTestMap::eraseEntry(const OverlayKey& key)
 {
 	std::map<OverlayKey, GameObject>::iterator key_it;
-	std::map<TransportAddress, std::vector<GameObject> >::iterator group_it;
-	std::vector<GameObject>::iterator object_it;
+	KeyPositionMap::iterator position_it;
+	GroupMap::iterator group_it;
 	TransportAddress group_address;
-	bool found = false;
+	OverlayKey moved_key;
+
+	//The entry may be erased before it expires, in which case it should not be erased again when it does
+	expiry_wheel.cancel(key);
 
 	//Find key in O(log n)
 	key_it = dataMap.find(key);
@@ -132,43 +310,57 @@ void GlobalPithosTestMap::eraseEntry(const OverlayKey& key)
 	if (group_address.isUnspecified())
 		error("[GlobalPithosTestMap] Group address is unspecified when erasing.");
 
-	//Find group corresponding to the key in O(log m), where m is the number of groups
-	group_it = groupMap.find(key_it->second.getGroupAddress());
+	position_it = keyPositions.find(key);
+	if (position_it == keyPositions.end())
+		error("[GlobalPithosTestMap] Key not found in key position map.");
+
+	//Find group corresponding to the key in O(1)
+	group_it = groupMap.find(group_address);
 	if (group_it == groupMap.end())
 		error("[GlobalPithosTestMap] Could not resolve super peer address for given overlay key.");
 
-	//Find object in group in O(l/2), where l is the number of objects stored in the group
-	for (object_it = (group_it->second).begin() ; object_it != (group_it->second).end() ; object_it++)
+	//Remove the key from both key lists in O(1). The keys moved into its place take over its positions.
+	moved_key = removeKeyAt(keyList, position_it->second.keyIndex);
+	if (!moved_key.isUnspecified())
+		keyPositions[moved_key].keyIndex = position_it->second.keyIndex;
+
+	moved_key = removeKeyAt(group_it->second, position_it->second.groupIndex);
+	if (!moved_key.isUnspecified())
+		keyPositions[moved_key].groupIndex = position_it->second.groupIndex;
+
+	if (group_it->second.empty())
+		groupMap.erase(group_it);
+
+	if (keyDistribution == RECENCY_KEYS)
 	{
-		if (*object_it == key_it->second)
+		recencyList[position_it->second.recencyIndex - recencyBase].live = false;
+		recencyDead++;
+
+		//Dead entries at the front can be dropped without renumbering the other entries
+		while (!recencyList.empty() && !recencyList.front().live)
 		{
-			group_it->second.erase(object_it);
-			found = true;
-			break;
+			recencyList.pop_front();
+			recencyBase++;
+			recencyDead--;
 		}
-	}
 
-	if (!found)
-	{
-		//We can't check for it == end, because when the item is deleted and the vector is left empty, the iterator also points to the end
-		std::ostringstream err_str;
-		err_str << "Object not found in group vector for (size: "<< group_it->second.size() << ") removal. Object details: " << key_it->second << endl;
-		error(err_str.str().c_str());
+		//Keep at least half of the entries alive, so that a random age hits a live key with probability of at least a half
+		if (recencyDead > recencyList.size() / 2)
+			compactRecencyList();
 	}
 
-	if (group_it->second.size() == 0)
-			groupMap.erase(group_address);
+	RECORD_STATS(globalStatistics->addStdDev("GlobalPithosTestMap: Accesses per object", position_it->second.accesses));
+
+	keyPositions.erase(position_it);
 
 	//erase's order complexity depends on the container
-    dataMap.erase(key);
+    dataMap.erase(key_it);
 }
 
 const GameObject* GlobalPithosTestMap::findEntry(const OverlayKey& key)
 {
     std::map<OverlayKey, GameObject>::iterator it = dataMap.find(key);
 
-    //Find uniform random entry in O(log n)
-
     if (it == dataMap.end()) {
         return NULL;
     } else {
@@ -176,51 +368,230 @@ const GameObject* GlobalPithosTestMap::findEntry(const OverlayKey& key)
     }
 }
 
-OverlayKey GlobalPithosTestMap::getRandomGroupKey(TransportAddress group_address)
+bool GlobalPithosTestMap::updateEntry(const OverlayKey& key, const GameObject& entry)
+{
+    Enter_Method_Silent();
+
+    std::map<OverlayKey, GameObject>::iterator it = dataMap.find(key);
+
+    if (it == dataMap.end() || entry.getVersion() < it->second.getVersion())
+        return false;
+
+    //Concurrent updates to the same version are resolved as in GroupStorage::applyUpdate(): the higher payload hash wins
+    if (entry.getVersion() == it->second.getVersion() && !(it->second.getPayloadHash() < entry.getPayloadHash()))
+        return false;
+
+    //The record keeps its position in the key lists, since its key and group do not change
+    it->second = entry;
+
+    return true;
+}
+
+size_t GlobalPithosTestMap::groupSize(const TransportAddress& group_address)
 {
-	std::map<TransportAddress, std::vector<GameObject> >::iterator it;
-	GameObject object;
+	GroupMap::iterator it = groupMap.find(group_address);
 
-	//Find group key in O(log m), where m is number of groups
-	it = groupMap.find(group_address);
+	if (it == groupMap.end())
+		return 0;
+	else return it->second.size();
+}
+
+OverlayKey GlobalPithosTestMap::getRandomGroupKey(const TransportAddress& group_address)
+{
+	//Find group key in O(1)
+	GroupMap::iterator it = groupMap.find(group_address);
 	if (it == groupMap.end())
 	{
 		return OverlayKey::UNSPECIFIED_KEY;
 	}
 
 	//Select object within group in O(1)
-	object = (it->second).at(intuniform(0, it->second.size()-1));
-
-	return object.getNameHash();
+	return countAccess((it->second).at(intuniform(0, it->second.size()-1)));
 }
 
-OverlayKey GlobalPithosTestMap::getRandomNonGroupKey(TransportAddress group_address, int level)
+OverlayKey GlobalPithosTestMap::getRandomNonGroupKey(const TransportAddress& group_address)
 {
-	if (dataMap.size() == 0) {
+	size_t group_size = groupSize(group_address);
+
+	//There are no objects in other groups
+	if (keyList.size() == group_size)
 		return OverlayKey::UNSPECIFIED_KEY;
+
+	//Draw uniform random keys in O(1) until one from another group is found. Every draw succeeds with probability (n-g)/n.
+	for (int i = 0 ; i < NON_GROUP_TRIES ; i++)
+	{
+		const OverlayKey &key = keyList[intuniform(0, keyList.size()-1)];
+
+		if (keyPositions[key].groupAddress != group_address)
+			return countAccess(key);
 	}
 
-	//This recursive function is getting too deep. There might not be any objects in other groups.
-	if (level == 10) return OverlayKey::UNSPECIFIED_KEY;
+	//The group holds most of the objects, so select the r-th key of another group directly in O(n)
+	unsigned int r = intuniform(0, keyList.size() - group_size - 1);
 
-	//return uniform random OverlayKey in O(n/2)
-	std::map<OverlayKey, GameObject>::iterator it = dataMap.begin();
-	std::advance(it, intuniform(0, dataMap.size()-1));
+	for (unsigned int i = 0 ; i < keyList.size() ; i++)
+	{
+		if (keyPositions[keyList[i]].groupAddress == group_address)
+			continue;
 
-	if (it->second.getGroupAddress() == group_address)
-		return getRandomNonGroupKey(group_address, level+1);
-	else return it->first;
+		if (r == 0)
+			return countAccess(keyList[i]);
+		r--;
+	}
+
+	error("[GlobalPithosTestMap] The key list and group map are out of sync.");
+	return OverlayKey::UNSPECIFIED_KEY;
 }
 
 const OverlayKey& GlobalPithosTestMap::getRandomKey()
 {
-    if (dataMap.size() == 0) {
+    if (keyList.size() == 0) {
         return OverlayKey::UNSPECIFIED_KEY;
     }
 
-    //return uniform random OverlayKey in O(n/2)
-    std::map<OverlayKey, GameObject>::iterator it = dataMap.begin();
-    std::advance(it, intuniform(0, dataMap.size()-1));
+    //return uniform random OverlayKey in O(1)
+    return countAccess(keyList[intuniform(0, keyList.size()-1)]);
+}
+
+const OverlayKey& GlobalPithosTestMap::countAccess(const OverlayKey& key)
+{
+	keyPositions[key].accesses++;
+
+	return key;
+}
+
+OverlayKey GlobalPithosTestMap::getPopularKey()
+{
+	if (keyList.size() == 0)
+		return OverlayKey::UNSPECIFIED_KEY;
+
+	switch (keyDistribution)
+	{
+		case ZIPF_KEYS:
+			return countAccess(keyList[zipfRank(keyList.size(), zipfExponent) - 1]);
+		case HOTSPOT_KEYS:
+			return countAccess(getHotspotKey());
+		case RECENCY_KEYS:
+			return countAccess(getRecentKey());
+		default:
+			return getRandomKey();
+	}
+}
+
+//Helper functions for the rejection-inversion Zipf sampler. They evaluate log1p(x)/x and expm1(x)/x accurately for x close to 0.
+static double log1pOverX(double x)
+{
+	if (fabs(x) > 1e-8)
+		return log1p(x) / x;
+	else return 1 - x * (0.5 - x * (1.0/3.0 - 0.25 * x));
+}
+
+static double expm1OverX(double x)
+{
+	if (fabs(x) > 1e-8)
+		return expm1(x) / x;
+	else return 1 + x * 0.5 * (1 + x * (1.0/3.0) * (1 + 0.25 * x));
+}
+
+//H(x) is the integral of h(x) = 1/x^exponent, shifted so that it is well defined for an exponent of 1
+static double zipfH(double x, double exponent)
+{
+	double log_x = log(x);
+	return expm1OverX((1 - exponent) * log_x) * log_x;
+}
+
+static double zipfHInverse(double x, double exponent)
+{
+	double t = x * (1 - exponent);
+	if (t < -1)
+		t = -1;
+	return exp(log1pOverX(t) * x);
+}
+
+unsigned int GlobalPithosTestMap::zipfRank(unsigned int n, double exponent)
+{
+	if (n == 1)
+		return 1;
+
+	double h_integral_x1 = zipfH(1.5, exponent) - 1;
+	double h_integral_n = zipfH(n + 0.5, exponent);
+	double s = 2 - zipfHInverse(zipfH(2.5, exponent) - exp(-exponent * log(2.0)), exponent);
+
+	while (true)
+	{
+		double u = h_integral_n + uniform(0, 1) * (h_integral_x1 - h_integral_n);
+		double x = zipfHInverse(u, exponent);
+
+		double k = floor(x + 0.5);
+		if (k < 1)
+			k = 1;
+		else if (k > n)
+			k = n;
+
+		//Accept k if x falls in the part of its bar that lies under the hat function
+		if ((k - x <= s) || (u >= zipfH(k + 0.5, exponent) - exp(-exponent * log(k))))
+			return (unsigned int)k;
+	}
+}
+
+const OverlayKey& GlobalPithosTestMap::getHotspotKey()
+{
+	//Move the hotspot to a new random slot
+	if (simTime() >= nextHotspotMove)
+	{
+		hotspotOffset = intuniform(0, keyList.size()-1);
+		nextHotspotMove = simTime() + hotspotMoveInterval;
+	}
+
+	if (uniform(0, 1) >= hotspotProbability)
+		return keyList[intuniform(0, keyList.size()-1)];
+
+	unsigned int hotspot_size = (unsigned int)ceil(hotspotFraction * keyList.size());
+
+	//The hotspot window wraps around the end of the key list
+	return keyList[(hotspotOffset + intuniform(0, hotspot_size-1)) % keyList.size()];
+}
+
+const OverlayKey& GlobalPithosTestMap::getRecentKey()
+{
+	for (int i = 0 ; i < RECENCY_TRIES ; i++)
+	{
+		//The age rank counts back from the newest key, so a rank of 0 is the newest key
+		unsigned int age = geometric(1.0 / (recencyMean + 1));
+
+		if (age >= recencyList.size())
+			continue;
+
+		RecencyEntry &entry = recencyList[recencyList.size() - 1 - age];
+
+		if (entry.live)
+			return entry.key;
+	}
+
+	//Return the newest live key. The front of the list is always live, so this terminates.
+	for (unsigned int i = recencyList.size() ; i > 0 ; i--)
+	{
+		if (recencyList[i-1].live)
+			return recencyList[i-1].key;
+	}
+
+	error("[GlobalPithosTestMap] The recency list holds no live keys.");
+	return OverlayKey::UNSPECIFIED_KEY;
+}
+
+void GlobalPithosTestMap::compactRecencyList()
+{
+	std::deque<RecencyEntry> live_list;
+
+	for (unsigned int i = 0 ; i < recencyList.size() ; i++)
+	{
+		if (!recencyList[i].live)
+			continue;
+
+		keyPositions[recencyList[i].key].recencyIndex = recencyBase + live_list.size();
+		live_list.push_back(recencyList[i]);
+	}
 
-    return it->first;
+	recencyList.swap(live_list);
+	recencyDead = 0;
 }
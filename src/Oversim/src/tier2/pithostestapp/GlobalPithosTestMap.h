@@ -25,15 +25,22 @@
 #define __GLOBAL_PITHOS_TEST_MAP_H__
 
 #include <map>
+#include <vector>
+#include <deque>
+#include <tr1/unordered_map>
 
 #include <omnetpp.h>
 
 #include <OverlayKey.h>
 #include <BinaryValue.h>
+#include <TransportAddress.h>
 
 #include "GameObject.h"
+#include "ExpiryWheel.h"
+#include "TraceReader.h"
 
 class GlobalStatistics;
+class PithosTestApp;
 
 
 /**
@@ -50,7 +57,8 @@ public:
 
     /*
      * Insert a new key/value pair into global list of all currently
-     * stored Pithos records.
+     * stored Pithos records. A record that is already stored is
+     * overwritten, as happens when a trace PUTs the same object again.
      *
      * @param key The key of the record
      * @param entry The value and TTL of the record
@@ -66,6 +74,18 @@ public:
      */
     const GameObject* findEntry(const OverlayKey& key);
 
+    /*
+     * Replace the value of a record with an updated version. As in group
+     * storage, an update with a lower version than that of the record is
+     * ignored, and of two updates with the same version the one with the
+     * higher payload hash is kept.
+     *
+     * @param key The key of the record
+     * @param entry The updated record
+     * @return true if the record was updated
+     */
+    bool updateEntry(const OverlayKey& key, const GameObject& entry);
+
     /*
      * Erase the key/value pair with the given key from the global list of
      * all currently stored Pithos records.
@@ -74,9 +94,26 @@ public:
      */
     void eraseEntry(const OverlayKey& key);
 
-    OverlayKey getRandomGroupKey(TransportAddress group_address);
+    /*
+     * Returns the key of a random record stored in the given group in O(1).
+     *
+     * @param group_address The address of the group's super peer
+     * @return The key of the record, OverlayKey::UNSPECIFIED_KEY if the
+     * group stores no records
+     */
+    OverlayKey getRandomGroupKey(const TransportAddress& group_address);
 
-    OverlayKey getRandomNonGroupKey(TransportAddress group_address, int level = 0);
+    /*
+     * Returns the key of a random record that is not stored in the given group.
+     * Keys are drawn from the global key list until one from another group is
+     * found, which takes O(1) expected time as long as the group does not hold
+     * most of the records.
+     *
+     * @param group_address The address of the group's super peer
+     * @return The key of the record, OverlayKey::UNSPECIFIED_KEY if no other
+     * group stores records
+     */
+    OverlayKey getRandomNonGroupKey(const TransportAddress& group_address);
 
     /*
      * Returns the key of a random currently stored Pithos record from the global
@@ -87,22 +124,170 @@ public:
      */
     const OverlayKey& getRandomKey();
 
+    /*
+     * Returns the key of a currently stored Pithos record, drawn from the
+     * key popularity distribution set by the keyDistribution parameter.
+     *
+     * @return The key of the record, OverlayKey::UNSPECIFIED_KEY if the
+     * global list is empty
+     */
+    OverlayKey getPopularKey();
+
+    /*
+     * Returns true if keys are drawn uniformly, in which case PithosTestApp
+     * selects in-group and out-of-group keys itself.
+     */
+    bool isUniform() { return keyDistribution == UNIFORM_KEYS; };
+
+    /*
+     * Returns true if the workload is replayed from a trace file, in which
+     * case PithosTestApp does not generate requests itself.
+     */
+    bool isReplayingTrace() { return traceReader.isOpen(); };
+
+    /*
+     * Register the PithosTestApp of a node, so that the trace records of the
+     * node are passed to it.
+     *
+     * @param node The index of the node in the trace
+     * @param app The application that replays the node's records
+     */
+    void registerTraceApp(unsigned int node, PithosTestApp* app);
+
+    void unregisterTraceApp(unsigned int node);
+
     size_t size() { return dataMap.size(); };
 
+    /*
+     * Returns the number of records stored in the given group.
+     */
+    size_t groupSize(const TransportAddress& group_address);
+
 private:
     void initialize();
     void handleMessage(cMessage* msg);
     void finish();
 
+    /**
+     * (Re)schedule the expiry timer for the next time the expiry wheel has to be advanced.
+     */
+    void scheduleExpiryTimer();
+
     static const int TEST_MAP_INTERVAL = 10; /**< interval in seconds for writing periodic statistical information */
+    static const int NON_GROUP_TRIES = 10; /**< number of random keys drawn for an out-of-group key, before the key list is searched */
+    static const int RECENCY_TRIES = 10; /**< number of ages drawn for a recent key, before the newest key is returned */
+
+    /**
+     * The key popularity distributions supported by getPopularKey()
+     */
+    enum KeyDistribution
+    {
+        UNIFORM_KEYS,   /**< Every stored key is equally popular */
+        ZIPF_KEYS,      /**< The key in slot i of keyList is drawn with probability proportional to 1/(i+1)^zipfExponent */
+        HOTSPOT_KEYS,   /**< A window of hotspotFraction of the keys receives hotspotProbability of the requests, and moves every hotspotMoveInterval */
+        RECENCY_KEYS    /**< The age rank of the drawn key is geometrically distributed with mean recencyMean, so recent keys are popular */
+    };
+
+    /**
+     * The position of a key in the dense key list and in its group's key list
+     */
+    struct KeyPosition
+    {
+        TransportAddress groupAddress;
+        unsigned int keyIndex;
+        unsigned int groupIndex;
+        uint64_t recencyIndex;  /**< The insertion sequence number of the key in recencyList */
+        unsigned int accesses;  /**< The number of times the key was drawn */
+    };
+
+    /**
+     * A key in the insertion ordered recency list. Erased keys are left in the list as dead entries, until they are removed
+     * from the front of the list or the list is compacted.
+     */
+    struct RecencyEntry
+    {
+        OverlayKey key;
+        bool live;
+    };
+
+    typedef std::vector<OverlayKey> KeyList;
+    typedef std::tr1::unordered_map<OverlayKey, KeyPosition, OverlayKey::hashFcn> KeyPositionMap;
+    typedef std::tr1::unordered_map<TransportAddress, KeyList, TransportAddress::hashFcn> GroupMap;
+
+    /**
+     * Remove the key at the given index from a key list by moving the last key into its place.
+     *
+     * @return the key that was moved into the index, or OverlayKey::UNSPECIFIED_KEY if the removed key was the last one
+     */
+    OverlayKey removeKeyAt(KeyList& key_list, unsigned int index);
+
+    /**
+     * Record that a key was drawn, and return it.
+     */
+    const OverlayKey& countAccess(const OverlayKey& key);
+
+    /**
+     * Draw a rank in [1, n] from a Zipf distribution with the given exponent, using rejection-inversion sampling
+     * (W. Hormann and G. Derflinger, "Rejection-inversion to generate variates from monotone discrete distributions", 1996).
+     * Every draw takes O(1) expected time, independently of n.
+     */
+    unsigned int zipfRank(unsigned int n, double exponent);
+
+    const OverlayKey& getHotspotKey();
+    const OverlayKey& getRecentKey();
+
+    /**
+     * Remove the dead entries from the recency list and renumber the live ones.
+     */
+    void compactRecencyList();
+
+    /**
+     * Pass all trace records that are due to the applications of their nodes, and schedule the trace timer for the next record.
+     */
+    void replayTrace();
 
     GlobalStatistics* globalStatistics; /**< pointer to GlobalStatistics module in this node */
 
     std::map<OverlayKey, GameObject> dataMap; /**< The map contains all currently stored Pithos records */
 
-    std::map<TransportAddress, std::vector<GameObject> > groupMap; /**< The map contains all currently stored Pithos records, stored as vectors in a map sorted by group ID */
+    KeyList keyList; /**< The keys of all currently stored Pithos records, in no particular order, for O(1) random selection */
+
+    KeyPositionMap keyPositions; /**< The position of every key in keyList and in its group's list in groupMap */
+
+    GroupMap groupMap; /**< The keys of all currently stored Pithos records, grouped by the address of the group's super peer */
+
+    KeyDistribution keyDistribution; /**< The popularity distribution from which getPopularKey() draws keys */
+    double zipfExponent;
+    double hotspotFraction;
+    double hotspotProbability;
+    simtime_t hotspotMoveInterval;
+    double recencyMean;
+
+    unsigned int hotspotOffset; /**< The slot in keyList where the hotspot window starts */
+    simtime_t nextHotspotMove; /**< The time at which the hotspot window moves to a new random slot */
+
+    std::deque<RecencyEntry> recencyList; /**< All keys in order of insertion (only kept for RECENCY_KEYS) */
+    uint64_t recencyBase; /**< The insertion sequence number of the front of recencyList */
+    unsigned int recencyDead; /**< The number of dead entries in recencyList */
+
+    TraceReader traceReader; /**< Reads the workload trace, if one is replayed */
+    uint64_t traceIndex; /**< The index of the next trace record to be replayed */
+    TraceRecord traceRecord; /**< The next trace record to be replayed */
+    simtime_t traceOffset; /**< The simulation time at which the trace starts */
+    cMessage *traceTimer; /**< timer self-message that triggers the replay of the next trace record */
+    std::map<unsigned int, PithosTestApp*> traceApps; /**< The applications that replay the trace, by node index */
+
+    unsigned long numTraceReplayed; /**< The number of trace records passed to an application */
+    unsigned long numTraceSkipped; /**< The number of trace records of nodes that were not present or not yet in a group */
+    unsigned long numOverwrites; /**< The number of PUTs of records that were already stored */
 
     cMessage *periodicTimer; /**< timer self-message for writing periodic statistical information */
+
+    unsigned long lastHashComputations; /**< GameObject::hashComputations at the previous periodic statistics interval */
+    unsigned long lastHashCacheHits; /**< GameObject::hashCacheHits at the previous periodic statistics interval */
+
+    ExpiryWheel expiry_wheel; /**< Keeps track of when the stored Pithos records expire */
+    cMessage *expiryTimer; /**< timer self-message that triggers the removal of expired records */
 };
 
 #endif
@@ -22,6 +22,8 @@
  * @author Ingmar Baumgart
  */
 
+#include <algorithm>
+
 #include <IPAddressResolver.h>
 #include <GlobalNodeListAccess.h>
 #include <GlobalStatisticsAccess.h>
@@ -52,6 +54,7 @@ PithosTestApp::PithosTestApp()
     pithostestmod_timer = NULL;
     join_timer = NULL;
     position_update_timer = NULL;
+    replayTrace = false;
 }
 
 void PithosTestApp::initializeApp(int stage)
@@ -63,6 +66,9 @@ void PithosTestApp::initializeApp(int stage)
     debugOutput = par("debugOutput");
     activeNetwInitPhase = par("activeNetwInitPhase");
     groupMigration = par("groupMigration");
+    objectUpdates = par("objectUpdates");
+    deltaSize_av = par("avDeltaSize");
+    getBatchSize = par("getBatchSize");
 
     idealGroupProbability = par("groupProbability");
 
@@ -95,6 +101,9 @@ void PithosTestApp::initializeApp(int stage)
     numPutSent = 0;
     numPutError = 0;
     numPutSuccess = 0;
+    numModSent = 0;
+    numModError = 0;
+    numModSuccess = 0;
 
     numGroupGet = 0;
     numOverlayGet = 0;
@@ -107,6 +116,8 @@ void PithosTestApp::initializeApp(int stage)
     WATCH(numPutSent);
     WATCH(numPutError);
     WATCH(numPutSuccess);
+    WATCH(numModSent);
+    WATCH(numModSuccess);
     WATCH(numGroupGet);
     WATCH(numOverlayGet);
 
@@ -118,7 +129,56 @@ void PithosTestApp::initializeApp(int stage)
     pithostestmod_timer = new cMessage("pithostest_mod_timer");
 
     position_update_timer = new cMessage("position_update_timer");
-    scheduleAt(simTime()+wait_time, position_update_timer);
+
+    //When a trace is replayed, the trace also moves the node and triggers its first group join
+    replayTrace = globalPithosTestMap->isReplayingTrace();
+    if (replayTrace)
+    {
+        traceNode = getParentModule()->getParentModule()->getIndex();
+        globalPithosTestMap->registerTraceApp(traceNode, this);
+    }
+    else scheduleAt(simTime()+wait_time, position_update_timer);
+}
+
+bool PithosTestApp::handleTraceRecord(const TraceRecord& record)
+{
+    Enter_Method_Silent();
+
+    char name[41];
+
+    switch (record.op)
+    {
+        case TRACE_POSITION_UPDATE:
+        {
+            join_time = simTime();
+
+            PositionUpdatePkt *update_pkt = new PositionUpdatePkt();
+            update_pkt->setLatitude(record.latitude);
+            update_pkt->setLongitude(record.longitude);
+
+            send(update_pkt, "to_lowerTier");
+            return true;
+        }
+        case TRACE_PUT:
+        case TRACE_GET:
+        {
+            //Requests can only be sent once the node has joined a group
+            if (super_peer_address.isUnspecified() || nodeIsLeavingSoon || underlayConfigurator->isSimulationEndingSoon())
+                return false;
+
+            //The object name only depends on the object identifier, so that every node derives the same key from it
+            sprintf(name, "Trace,Object:%llu", (unsigned long long)record.object);
+
+            if (record.op == TRACE_PUT)
+                sendPutRequest(name, record.size, (record.ttl > 0) ? (int)record.ttl : ttl);
+            else sendGetRequest(OverlayKey::sha1(BinaryValue(name)));
+
+            return true;
+        }
+        default:
+            error("Unknown trace operation %u", record.op);
+            return false;
+    }
 }
 
 void PithosTestApp::handleRpcResponse(BaseResponseMessage* msg, const RpcState& state, simtime_t rtt)
@@ -141,6 +201,24 @@ void PithosTestApp::handleRpcResponse(BaseResponseMessage* msg, const RpcState&
            << endl;
         break;
     }
+    RPC_ON_RESPONSE(RootObjectBatchGetCAPI)
+    {
+        handleBatchGetResponse(_RootObjectBatchGetCAPIResponse, check_and_cast<PithosStatsContext*>(state.getContext()));
+        EV << "[PithosTestApp::handleRpcResponse()]\n"
+           << "    Pithos Batch Get RPC Response received: id=" << state.getId()
+           << " msg=" << *_RootObjectBatchGetCAPIResponse << " rtt=" << rtt
+           << endl;
+        break;
+    }
+    RPC_ON_RESPONSE(RootObjectModCAPI)
+    {
+        handleModResponse(_RootObjectModCAPIResponse, check_and_cast<PithosStatsContext*>(state.getContext()));
+        EV << "[PithosTestApp::handleRpcResponse()]\n"
+           << "    Pithos Mod RPC Response received: id=" << state.getId()
+           << " msg=" << *_RootObjectModCAPIResponse << " rtt=" << rtt
+           << endl;
+        break;
+    }
     RPC_SWITCH_END()
 }
 
@@ -175,6 +253,29 @@ void PithosTestApp::handlePutResponse(RootObjectPutCAPIResponse* msg, PithosStat
     delete context;
 }
 
+void PithosTestApp::handleModResponse(RootObjectModCAPIResponse* msg, PithosStatsContext* context)
+{
+    if (context->measurementPhase == false) {
+        // don't count response, if the request was not sent
+        // in the measurement phase
+        delete context;
+        return;
+    }
+
+    RECORD_STATS(globalStatistics->recordOutVector("PithosTestApp: MOD Latency (s)", SIMTIME_DBL(simTime() - context->requestTime)));
+
+    //Later GET requests should return the updated object
+    if (msg->getIsSuccess())
+    {
+        globalPithosTestMap->updateEntry(context->go.getNameHash(), context->go);
+        RECORD_STATS(numModSuccess++);
+    } else {
+        RECORD_STATS(numModError++);
+    }
+
+    delete context;
+}
+
 void PithosTestApp::handleGetResponse(RootObjectGetCAPIResponse* msg, PithosStatsContext* context)
 {
     if (context->measurementPhase == false) {
@@ -186,21 +287,76 @@ void PithosTestApp::handleGetResponse(RootObjectGetCAPIResponse* msg, PithosStat
 
     RECORD_STATS(globalStatistics->recordOutVector("PithosTestApp: GET Latency (s)", SIMTIME_DBL(simTime() - context->requestTime)));
 
-    if (!(msg->getIsSuccess())) {
+    checkGetResult(context->key, msg->getIsSuccess(), msg->getResult());
+
+    delete context;
+}
+
+void PithosTestApp::handleBatchGetResponse(RootObjectBatchGetCAPIResponse* msg, PithosStatsContext* context)
+{
+    pendingBatchGets.erase(msg->getNonce());
+
+    if (context->measurementPhase == false) {
+        // don't count response, if the request was not sent
+        // in the measurement phase
+        delete context;
+        return;
+    }
+
+    //Keys whose own result was overtaken by the batch's response are checked here
+    for (unsigned int i = 0 ; i < context->keys.size() ; i++)
+        checkBatchGetResult(context, i, msg->getIsSuccess(i), msg->getResults(i));
+
+    delete context;
+}
+
+void PithosTestApp::handleBatchGetResult(RootObjectBatchGetResult* msg)
+{
+    PendingBatchGets::iterator batch_it = pendingBatchGets.find(msg->getBatchNonce());
+
+    //The batch's response has already been received
+    if (batch_it == pendingBatchGets.end())
+        return;
+
+    PithosStatsContext* context = batch_it->second;
+
+    if (context->measurementPhase == false)
+        return;
+
+    if (msg->getIndex() >= context->keys.size())
+        error("A batch get result was received for an unknown key.");
+
+    checkBatchGetResult(context, msg->getIndex(), msg->getIsSuccess(), msg->getResult());
+}
+
+void PithosTestApp::checkBatchGetResult(PithosStatsContext* context, unsigned int index, bool isSuccess, const GameObject& result)
+{
+    if (context->keysChecked[index])
+        return;
+
+    context->keysChecked[index] = true;
+
+    //Every key of a batch is measured from the time the batch was sent
+    RECORD_STATS(globalStatistics->recordOutVector("PithosTestApp: GET Latency (s)", SIMTIME_DBL(simTime() - context->requestTime)));
+
+    checkGetResult(context->keys[index], isSuccess, result);
+}
+
+void PithosTestApp::checkGetResult(const OverlayKey& key, bool isSuccess, const GameObject& result)
+{
+    if (!isSuccess) {
         //cout << "PithosTestApp: success == false" << endl;
         RECORD_STATS(numGetError++);
-        delete context;
         return;
     }
 
-    const GameObject *entry = globalPithosTestMap->findEntry(context->key);
+    const GameObject *entry = globalPithosTestMap->findEntry(key);
 
     if (entry == NULL) {
         //unexpected key
     	//This error will occur towards the end of an object's lifetime, when the object is removed from the PithosTestMap, after a get request for it was already sent to the lower levels.
         RECORD_STATS(numGetError++);
         //cout << "PithosTestApp: unexpected key" << endl;
-        delete context;
         return;
     }
 
@@ -208,10 +364,9 @@ void PithosTestApp::handleGetResponse(RootObjectGetCAPIResponse* msg, PithosStat
     {
         //this key doesn't exist anymore in Pithos, delete it in our hashtable
 
-    	globalPithosTestMap->eraseEntry(context->key);
-        delete context;
+    	globalPithosTestMap->eraseEntry(key);
 
-        if (msg->getResult() == GameObject::UNSPECIFIED_OBJECT) {
+        if (result == GameObject::UNSPECIFIED_OBJECT) {
             RECORD_STATS(numGetSuccess++);
             //cout << "PithosTestApp: deleted key still available" << endl;
             return;
@@ -221,11 +376,9 @@ void PithosTestApp::handleGetResponse(RootObjectGetCAPIResponse* msg, PithosStat
             return;
         }
     } else {
-        delete context;
+        EV << "Received result object: " << result << endl;
 
-        EV << "Received result object: " << msg->getResult() << endl;
-
-        if (msg->getResult() == *entry)
+        if (result == *entry)
         {
             RECORD_STATS(numGetSuccess++);
             //cout << "PithosTestApp: success (2)" << endl;
@@ -244,15 +397,21 @@ void PithosTestApp::sendPutRequest()
 {
 	char name[41];
 
+	//It is important that this name not contain spaces, otherwise a GameObject cannot be correctly reconstructed from a BinaryValue
+	sprintf(name, "Node:%d,Object:%d", getParentModule()->getParentModule()->getIndex(), numPutSent);	//The name is later combined with the remaining object values
+
+	sendPutRequest(name, exponential(objectSize_av), ttl);
+}
+
+void PithosTestApp::sendPutRequest(const char *name, int64_t size, int object_ttl)
+{
 	GameObject *go = new GameObject();
 	go->setName("GameObject");
-	go->setSize(exponential(objectSize_av));
+	go->setSize(size);
 	go->setCreationTime(simTime());
 
-	//It is important that this name not contain spaces, otherwise a GameObject cannot be correctly reconstructed from a BinaryValue
-	sprintf(name, "Node:%d,Object:%d", getParentModule()->getParentModule()->getIndex(), numPutSent);	//The name is later combined with the remaining object values
 	go->setObjectName(name);
-	go->setTTL(ttl);
+	go->setTTL(object_ttl);
 	go->setValue(-1);	//A value that a player will always want to change
 
 	RootObjectPutCAPICall* capiPutMsg = new RootObjectPutCAPICall();
@@ -260,7 +419,7 @@ void PithosTestApp::sendPutRequest()
 	//std::cout << "[PithosTestApp] Storing object with key " << go->getHash() << endl;
 
 	capiPutMsg->addObject(go);
-	capiPutMsg->setTtl(ttl);		//The TTL is set in the RPC call as well as the GameObject, for interoperability with the DHT application
+	capiPutMsg->setTtl(object_ttl);		//The TTL is set in the RPC call as well as the GameObject, for interoperability with the DHT application
 	capiPutMsg->setIsModifiable(true);
 
 	RECORD_STATS(numSent++; numPutSent++);
@@ -275,18 +434,25 @@ void PithosTestApp::handleLowerMessage (cMessage *msg)
 		super_peer_address = request_start->getAddress();
 
 		//If this is the first time we've received the message from the lower tier, schedule the timers.
-		if ((!pithostestput_timer->isScheduled()) && (!pithostestget_timer->isScheduled()) && (!pithostestmod_timer->isScheduled()))
+		//When a trace is replayed, the trace schedules the requests instead.
+		if ((!replayTrace) && (!pithostestput_timer->isScheduled()) && (!pithostestget_timer->isScheduled()) && (!pithostestmod_timer->isScheduled()))
 		{
 			if (mean > 0) {
 				scheduleAt(simTime() + truncnormal(mean, deviation), pithostestput_timer);
 				scheduleAt(simTime() + truncnormal(mean + mean / 3, deviation), pithostestget_timer);
-				//scheduleAt(simTime() + truncnormal(mean + 2 * mean / 3, deviation), pithostestmod_timer);
+				if (objectUpdates)
+					scheduleAt(simTime() + truncnormal(mean + 2 * mean / 3, deviation), pithostestmod_timer);
 			}
 			else error("The mean message creation time must be greater than zero.");
 		}
 
 		delete(msg);
 	}
+	else if (dynamic_cast<RootObjectBatchGetResult *>(msg))
+	{
+		handleBatchGetResult(static_cast<RootObjectBatchGetResult *>(msg));
+		delete(msg);
+	}
 	else error("Game received unknown message\n");
 }
 
@@ -308,6 +474,22 @@ OverlayKey PithosTestApp::getKey()
 {
 	OverlayKey key;
 
+	//For skewed key popularity, the key is drawn from the whole system and the request type follows from where it is stored
+	if (!globalPithosTestMap->isUniform())
+	{
+		key = globalPithosTestMap->getPopularKey();
+		if (key.isUnspecified())
+			return key;
+
+		if (globalPithosTestMap->findEntry(key)->getGroupAddress() == super_peer_address)
+		{
+			RECORD_STATS(numGroupGet++);
+		} else {
+			RECORD_STATS(numOverlayGet++);
+		}
+		return key;
+	}
+
 	//Randomly select in or out of group request
 	if (uniform(0,100) <= getGroupProbability())
 	{
@@ -402,6 +584,12 @@ void PithosTestApp::handleTimerEvent(cMessage* msg)
             return;
         }
 
+        if (getBatchSize > 1)
+        {
+            sendBatchGetRequest();
+            return;
+        }
+
         const OverlayKey& key = getKey();
 
         //std::cout << "[PithosTestApp] Retrieving object with key: " << key << endl;
@@ -416,13 +604,14 @@ void PithosTestApp::handleTimerEvent(cMessage* msg)
             return;
         }
 
-       	RootObjectGetCAPICall* capiGetMsg = new RootObjectGetCAPICall();
-       	capiGetMsg->setKey(key);
-        RECORD_STATS(numSent++; numGetSent++);
-
-        sendInternalRpcCall(ROOTOBJECTSTORE_COMP, capiGetMsg, new PithosStatsContext(globalStatistics->isMeasuring(), capiGetMsg->getCreationTime(), key));
-    }/* else if (msg->isName("pithostest_mod_timer"))
+        sendGetRequest(key);
+    } else if (msg->isName("pithostest_mod_timer"))
     {
+    	if (simTime() > absRequestStopTime)	//This has a module not generate requests after some absolute time
+		{
+			return;
+		}
+
         scheduleAt(simTime() + truncnormal(mean, deviation), msg);
 
         // do nothing if the network is still in the initialization phase
@@ -432,20 +621,74 @@ void PithosTestApp::handleTimerEvent(cMessage* msg)
             return;
         }
 
-        const OverlayKey& key = globalDhtTestMap->getRandomKey();
+        sendModRequest();
+    } else error("Unknown timer event received");
+}
 
-        if (key.isUnspecified())
-            return;
+void PithosTestApp::sendGetRequest(const OverlayKey& key)
+{
+	RootObjectGetCAPICall* capiGetMsg = new RootObjectGetCAPICall();
+	capiGetMsg->setKey(key);
+	RECORD_STATS(numSent++; numGetSent++);
 
-        DHTputCAPICall* dhtPutMsg = new DHTputCAPICall();
-        dhtPutMsg->setKey(key);
-        dhtPutMsg->setValue(generateRandomValue());
-        dhtPutMsg->setTtl(ttl);
-        dhtPutMsg->setIsModifiable(true);
+	sendInternalRpcCall(ROOTOBJECTSTORE_COMP, capiGetMsg, new PithosStatsContext(globalStatistics->isMeasuring(), capiGetMsg->getCreationTime(), key));
+}
 
-        RECORD_STATS(numSent++; numPutSent++);
-        sendInternalRpcCall(OVERLAYSTORAGE_COMP, dhtPutMsg, new DHTStatsContext(globalStatistics->isMeasuring(), simTime(), key, dhtPutMsg->getValue()));
-    }*/else error("Unknown timer event received");
+void PithosTestApp::sendBatchGetRequest()
+{
+	PithosStatsContext *context = new PithosStatsContext(globalStatistics->isMeasuring(), simTime());
+
+	for (int i = 0 ; i < getBatchSize ; i++)
+	{
+		const OverlayKey& key = getKey();
+
+		if (!key.isUnspecified())
+			context->keys.push_back(key);
+	}
+
+	if (context->keys.empty())
+	{
+		EV << "[PithosTestApp::sendBatchGetRequest() @ " << thisNode.getIp()
+		   << " (" << thisNode.getKey().toString(16) << ")]\n"
+		   << "    Error: No key available in global DHT test map!"
+		   << endl;
+		delete context;
+		return;
+	}
+
+	RootObjectBatchGetCAPICall* capiBatchGetMsg = new RootObjectBatchGetCAPICall();
+	capiBatchGetMsg->setKeysArraySize(context->keys.size());
+	for (unsigned int i = 0 ; i < context->keys.size() ; i++)
+		capiBatchGetMsg->setKeys(i, context->keys[i]);
+
+	context->requestTime = capiBatchGetMsg->getCreationTime();
+	context->keysChecked.assign(context->keys.size(), false);
+
+	RECORD_STATS(numSent++; numGetSent += context->keys.size());
+	pendingBatchGets[sendInternalRpcCall(ROOTOBJECTSTORE_COMP, capiBatchGetMsg, context)] = context;
+}
+
+void PithosTestApp::sendModRequest()
+{
+	//Updates are only sent within the group, since only group storage applies them in place
+	const OverlayKey& key = globalPithosTestMap->getRandomGroupKey(super_peer_address);
+
+	if (key.isUnspecified())
+		return;
+
+	GameObject *go = globalPithosTestMap->findEntry(key)->dup();
+	go->setValue(intuniform(0, 100000));
+	go->setVersion(go->getVersion() + 1);
+
+	//An update changes at least one byte and at most the whole object
+	int delta = (int)std::min((double)go->getSize(), std::max(1.0, exponential(deltaSize_av)));
+
+	RootObjectModCAPICall* capiModMsg = new RootObjectModCAPICall();
+	capiModMsg->addObject(go);
+	capiModMsg->setDeltaSize(delta);
+
+	RECORD_STATS(numSent++; numModSent++);
+	sendInternalRpcCall(ROOTOBJECTSTORE_COMP, capiModMsg, new PithosStatsContext(globalStatistics->isMeasuring(), capiModMsg->getCreationTime(), *go));
 }
 
 void PithosTestApp::handleNodeLeaveNotification()
@@ -455,6 +698,9 @@ void PithosTestApp::handleNodeLeaveNotification()
 
 void PithosTestApp::finishApp()
 {
+    if (replayTrace)
+        globalPithosTestMap->unregisterTraceApp(traceNode);
+
     simtime_t time = globalStatistics->calcMeasuredLifetime(creationTime);
 
     if (time >= GlobalStatistics::MIN_MEASURED) {
@@ -467,6 +713,13 @@ void PithosTestApp::finishApp()
 		globalStatistics->addStdDev("PithosTestApp: Failed PUT Requests/s", numPutError / time);
 		globalStatistics->addStdDev("PithosTestApp: Successful PUT Requests/s", numPutSuccess / time);
 
+		if (objectUpdates)
+		{
+			globalStatistics->addStdDev("PithosTestApp: Sent MOD Messages/s", numModSent / time);
+			globalStatistics->addStdDev("PithosTestApp: Failed MOD Requests/s", numModError / time);
+			globalStatistics->addStdDev("PithosTestApp: Successful MOD Requests/s", numModSuccess / time);
+		}
+
 		if ((numGroupGet + numOverlayGet) > 0)
 		{
 			globalStatistics->addStdDev("PithosTestApp: Group probability", (double)numGroupGet/(double)(numGroupGet + numOverlayGet));
@@ -35,11 +35,14 @@
 #include <BinaryValue.h>
 #include <BaseApp.h>
 #include <set>
+#include <map>
+#include <vector>
 #include <sstream>
 
 #include "PithosTestMessages_m.h"
 #include "PithosMessages_m.h"
 #include "GlobalPithosTestMap.h"
+#include "TraceReader.h"
 #include "GameObject.h"
 
 class GlobalPithosTestMap;
@@ -62,6 +65,8 @@ private:
 			bool measurementPhase;
 			simtime_t requestTime;
 			OverlayKey key;
+			std::vector<OverlayKey> keys;	//The keys of a batch GET
+			std::vector<bool> keysChecked;	//true for every key of a batch GET whose result was already checked
 			GameObject go;
 
 			PithosStatsContext(bool measurementPhase, simtime_t requestTime, const GameObject& go = GameObject::UNSPECIFIED_OBJECT) :
@@ -74,6 +79,7 @@ private:
 
     /**
      * Get a random group or system wide key of of one of the stored objects, depending on the group probability variable.
+     * If GlobalPithosTestMap draws keys from a skewed popularity distribution, the key is drawn from the whole system instead.
      */
     OverlayKey getKey();
 
@@ -83,6 +89,27 @@ private:
 
     void sendPutRequest();
 
+    /**
+     * Store a new object with the given properties.
+     *
+     * @param name The name of the object, from which its key is derived
+     * @param size The size of the object in bytes
+     * @param object_ttl The TTL of the object in seconds
+     */
+    void sendPutRequest(const char *name, int64_t size, int object_ttl);
+
+    void sendGetRequest(const OverlayKey& key);
+
+    /**
+     * Retrieve getBatchSize random keys with a single batch GET.
+     */
+    void sendBatchGetRequest();
+
+    /**
+     * Update a random object stored in this node's group to a new version with a new value.
+     */
+    void sendModRequest();
+
     /**
      * processes get responses
      *
@@ -93,6 +120,35 @@ private:
      */
     void handleGetResponse(RootObjectGetCAPIResponse* msg, PithosStatsContext* context);
 
+    /**
+     * processes the result of a single key of a batch get, as for a single get response
+     *
+     * @param msg the result of the key
+     */
+    void handleBatchGetResult(RootObjectBatchGetResult* msg);
+
+    /**
+     * processes batch get responses, by checking the result of every key that was not already received on its own
+     *
+     * @param msg batch get response message
+     * @param context context object used for collecting statistics, containing the requested keys
+     */
+    void handleBatchGetResponse(RootObjectBatchGetCAPIResponse* msg, PithosStatsContext* context);
+
+    /**
+     * Check the result of a key of a batch get, unless it was already checked.
+     */
+    void checkBatchGetResult(PithosStatsContext* context, unsigned int index, bool isSuccess, const GameObject& result);
+
+    /**
+     * Check a retrieved object against the object recorded in the global test map, and count the GET as a success or error.
+     *
+     * @param key The key that was retrieved
+     * @param isSuccess true if Pithos returned an object
+     * @param result The returned object
+     */
+    void checkGetResult(const OverlayKey& key, bool isSuccess, const GameObject& result);
+
     /**
      * processes put responses
      *
@@ -103,6 +159,14 @@ private:
      */
     void handlePutResponse(RootObjectPutCAPIResponse* msg, PithosStatsContext* context);
 
+    /**
+     * processes update responses
+     *
+     * @param msg update response message
+     * @param context context object used for collecting statistics
+     */
+    void handleModResponse(RootObjectModCAPIResponse* msg, PithosStatsContext* context);
+
     /**
      * processes self-messages
      *
@@ -127,6 +191,9 @@ private:
     GlobalStatistics* globalStatistics; /**< pointer to GlobalStatistics module in this node*/
     GlobalPithosTestMap* globalPithosTestMap; /**< pointer to the GlobalPithosTestMap module */
 
+    typedef std::map<uint32_t, PithosStatsContext*> PendingBatchGets;
+    PendingBatchGets pendingBatchGets; /**< the context of every pending batch get, by the nonce of its call */
+
     // parameters
     bool debugOutput; /**< debug output yes/no?*/
     double mean; //!< mean time interval between sending test messages
@@ -148,6 +215,11 @@ private:
 
 	bool groupMigration;
 
+	bool objectUpdates;		//!< true if stored objects are updated in place
+	double deltaSize_av;	//!< mean number of bytes of an object changed by an update
+
+	int getBatchSize;		//!< number of keys read by every GET
+
     // statistics
     int numSent; /**< number of sent packets*/
     int numGetSent; /**< number of get sent*/
@@ -156,6 +228,9 @@ private:
     int numPutSent; /**< number of put sent*/
     int numPutError; /**< number of error in put responses*/
     int numPutSuccess; /**< number of success in put responses*/
+    int numModSent; /**< number of updates sent*/
+    int numModError; /**< number of error in update responses*/
+    int numModSuccess; /**< number of success in update responses*/
 
     int numGroupGet; /**< number of group gets*/
     int numOverlayGet; /**< number of overlay gets*/
@@ -163,6 +238,9 @@ private:
     cMessage *pithostestput_timer, *pithostestget_timer, *pithostestmod_timer;
     bool nodeIsLeavingSoon; //!< true if the node is going to be killed shortly
 
+    bool replayTrace; //!< true if requests are replayed from a trace instead of generated
+    unsigned int traceNode; //!< the index of this node in the trace
+
     cMessage *join_timer;
     cMessage *position_update_timer;
 
@@ -173,6 +251,15 @@ private:
 public:
     PithosTestApp();
 
+    /**
+     * Replay a single record of the workload trace on this node.
+     * Called by GlobalPithosTestMap at the record's timestamp.
+     *
+     * @param record The trace record of this node
+     * @return false if the record could not be replayed, because the node is leaving or has not yet joined a group
+     */
+    bool handleTraceRecord(const TraceRecord& record);
+
     /**
      * virtual destructor
      */
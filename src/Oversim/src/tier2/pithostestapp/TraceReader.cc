@@ -0,0 +1,189 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+/**
+ * @file TraceReader.cc
+ * @author John Gilmore
+ */
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "TraceReader.h"
+
+const char TraceReader::MAGIC[8] = { 'P', 'I', 'T', 'H', 'O', 'S', 'T', 'R' };
+
+/**
+ * Decode an unsigned little-endian integer of the given number of bytes, independent of the host byte order.
+ */
+static uint64_t decodeLittleEndian(const char *data, unsigned int bytes)
+{
+    uint64_t value = 0;
+
+    for (unsigned int i = 0 ; i < bytes ; i++)
+        value |= ((uint64_t)(unsigned char)data[i]) << (8*i);
+
+    return value;
+}
+
+/**
+ * Decode a little-endian IEEE 754 double.
+ */
+static double decodeDouble(const char *data)
+{
+    uint64_t bits = decodeLittleEndian(data, 8);
+    double value;
+
+    memcpy(&value, &bits, sizeof(value));
+
+    return value;
+}
+
+TraceReader::TraceReader()
+{
+    fd = -1;
+    file_size = 0;
+    num_records = 0;
+    window_size = 0;
+    page_size = sysconf(_SC_PAGESIZE);
+    window = NULL;
+    window_start = 0;
+    window_length = 0;
+}
+
+TraceReader::~TraceReader()
+{
+    close();
+}
+
+void TraceReader::open(const std::string& file_name, size_t window_size)
+{
+    struct stat file_stat;
+    char header[HEADER_SIZE];
+    uint32_t version, record_size;
+
+    close();
+
+    fd = ::open(file_name.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw cRuntimeError("TraceReader::open(): Could not open trace file %s", file_name.c_str());
+
+    if (fstat(fd, &file_stat) != 0)
+        throw cRuntimeError("TraceReader::open(): Could not determine the size of trace file %s", file_name.c_str());
+
+    file_size = file_stat.st_size;
+
+    if (file_size < HEADER_SIZE || pread(fd, header, HEADER_SIZE, 0) != (ssize_t)HEADER_SIZE)
+        throw cRuntimeError("TraceReader::open(): Trace file %s is too short to hold a header", file_name.c_str());
+
+    if (memcmp(header, MAGIC, sizeof(MAGIC)) != 0)
+        throw cRuntimeError("TraceReader::open(): %s is not a Pithos trace file", file_name.c_str());
+
+    version = decodeLittleEndian(header + 8, 4);
+    record_size = decodeLittleEndian(header + 12, 4);
+
+    if (version != VERSION || record_size != RECORD_SIZE)
+        throw cRuntimeError("TraceReader::open(): Trace file %s has version %u with %u byte records, but version %u with %u byte records is expected",
+                file_name.c_str(), version, record_size, VERSION, RECORD_SIZE);
+
+    num_records = (file_size - HEADER_SIZE) / RECORD_SIZE;
+
+    //The window is a whole number of pages that holds at least one record
+    this->window_size = ((window_size + page_size - 1) / page_size) * page_size;
+    if (this->window_size < page_size + RECORD_SIZE)
+        this->window_size = 2 * page_size;
+}
+
+void TraceReader::close()
+{
+    unmapWindow();
+
+    if (fd >= 0)
+        ::close(fd);
+
+    fd = -1;
+    file_size = 0;
+    num_records = 0;
+}
+
+void TraceReader::mapWindow(uint64_t offset, size_t length)
+{
+    unmapWindow();
+
+    //mmap requires the start of the mapping to be aligned to a page
+    window_start = (offset / page_size) * page_size;
+    window_length = window_size;
+
+    if (window_start + window_length > file_size)
+        window_length = file_size - window_start;
+
+    if (offset + length > window_start + window_length)
+        throw cRuntimeError("TraceReader::mapWindow(): The window cannot hold the requested bytes");
+
+    void *mapping = mmap(NULL, window_length, PROT_READ, MAP_PRIVATE, fd, window_start);
+    if (mapping == MAP_FAILED)
+        throw cRuntimeError("TraceReader::mapWindow(): Could not map the trace file");
+
+    //Records are read in order, so the kernel may read ahead aggressively
+    madvise(mapping, window_length, MADV_SEQUENTIAL);
+
+    window = (char *)mapping;
+}
+
+void TraceReader::unmapWindow()
+{
+    if (window != NULL)
+        munmap(window, window_length);
+
+    window = NULL;
+    window_start = 0;
+    window_length = 0;
+}
+
+bool TraceReader::read(uint64_t index, TraceRecord& record)
+{
+    if (!isOpen())
+        throw cRuntimeError("TraceReader::read(): No trace file is open");
+
+    if (index >= num_records)
+        return false;
+
+    uint64_t offset = HEADER_SIZE + index * RECORD_SIZE;
+
+    if (window == NULL || offset < window_start || offset + RECORD_SIZE > window_start + window_length)
+        mapWindow(offset, RECORD_SIZE);
+
+    //The record is decoded field by field, since the mapped bytes are not necessarily aligned and the trace is little-endian
+    const char *data = window + (offset - window_start);
+
+    record.timestamp = decodeDouble(data);
+    record.node = decodeLittleEndian(data + 8, 4);
+    record.op = decodeLittleEndian(data + 12, 2);
+    record.reserved = decodeLittleEndian(data + 14, 2);
+    record.object = decodeLittleEndian(data + 16, 8);
+    record.size = decodeLittleEndian(data + 24, 4);
+    record.ttl = decodeLittleEndian(data + 28, 4);
+    record.latitude = decodeDouble(data + 32);
+    record.longitude = decodeDouble(data + 40);
+
+    return true;
+}
@@ -0,0 +1,122 @@
+//
+// Copyright (C) 2011 MIH Media lab, University of Stellenbosch
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+/**
+ * @file TraceReader.h
+ * @author John Gilmore
+ */
+
+#ifndef __TRACE_READER_H__
+#define __TRACE_READER_H__
+
+#include <string>
+
+#include <omnetpp.h>
+
+/**
+ * The operations that can be recorded in a Pithos workload trace
+ */
+enum TraceOperation
+{
+    TRACE_PUT = 0,              /**< Store a new object */
+    TRACE_GET = 1,              /**< Retrieve an object */
+    TRACE_POSITION_UPDATE = 2   /**< Move the node to a new position in the virtual world */
+};
+
+/**
+ * A single record of a binary Pithos workload trace.
+ *
+ * A trace file starts with a 16 byte header: the magic string "PITHOSTR", followed by the format version and the record
+ * size as 32-bit integers. The header is followed by 48 byte records in order of non-decreasing timestamp. All fields
+ * are stored little-endian, without padding between them.
+ */
+struct TraceRecord
+{
+    double timestamp;       /**< The time of the operation in seconds, relative to the start of the trace */
+    uint32_t node;          /**< The index of the node that performs the operation */
+    uint16_t op;            /**< The TraceOperation */
+    uint16_t reserved;
+    uint64_t object;        /**< The object identifier, from which the object name and key are derived */
+    uint32_t size;          /**< The size of the object in bytes (PUT only) */
+    uint32_t ttl;           /**< The TTL of the object in seconds, or 0 for the default TTL (PUT only) */
+    double latitude;        /**< The new position of the node (POSITION_UPDATE only) */
+    double longitude;
+};
+
+/**
+ * Reads a binary Pithos workload trace through a memory mapped window.
+ * Only the window around the records currently being read is mapped, so traces that are much larger than the available
+ * memory are streamed from disk as they are replayed. The window is moved when a record outside of it is requested.
+ *
+ * @author John Gilmore
+ */
+class TraceReader
+{
+    public:
+        static const char MAGIC[8];
+        static const uint32_t VERSION = 1;
+        static const uint32_t HEADER_SIZE = 16;
+        static const uint32_t RECORD_SIZE = 48;
+
+        TraceReader();
+        virtual ~TraceReader();
+
+        /**
+         * Open a trace file and validate its header.
+         *
+         * @param file_name The name of the trace file
+         * @param window_size The number of bytes of the file to map at a time
+         */
+        void open(const std::string& file_name, size_t window_size);
+
+        void close();
+
+        bool isOpen() { return fd >= 0; }
+
+        uint64_t getNumRecords() { return num_records; }
+
+        /**
+         * Read the record at the given index into record.
+         *
+         * @return false if the index lies beyond the end of the trace
+         */
+        bool read(uint64_t index, TraceRecord& record);
+
+    private:
+        int fd;                 /**< The file descriptor of the open trace file, or -1 */
+        uint64_t file_size;
+        uint64_t num_records;
+        size_t window_size;
+        size_t page_size;
+
+        char *window;           /**< The currently mapped part of the file, or NULL */
+        uint64_t window_start;  /**< The file offset of the first byte of the window */
+        size_t window_length;
+
+        /**
+         * Map the window so that it contains the bytes [offset, offset+length) of the file.
+         */
+        void mapWindow(uint64_t offset, size_t length);
+        void unmapWindow();
+
+        //The reader owns a file descriptor and mapping, so copying it is not allowed
+        TraceReader(const TraceReader& other);
+        TraceReader& operator=(const TraceReader& other);
+};
+
+#endif